@@ -0,0 +1,251 @@
+#include "alg_mlp_fixed.h"
+#include <math.h>
+#include <stddef.h>
+
+#define NET_NORMAL      0
+#define NET_ERR_GENERIC -1
+
+/* v * 2^-shift rounded to nearest, shift may be negative (saturating) */
+static int64_t shift_round(int64_t v, int shift)
+{
+    if (shift > 0) {
+        if (shift > 62) {
+            return 0;
+        }
+        return (v + ((int64_t)1 << (shift - 1))) >> shift;
+    }
+    if (shift < 0) {
+        shift = -shift;
+        if (v == 0) {
+            return 0;
+        }
+        if (shift > 62 || v > (INT64_MAX >> shift) ||
+            v < -(INT64_MAX >> shift)) {
+            return v > 0 ? INT64_MAX : -INT64_MAX;
+        }
+        return v * ((int64_t)1 << shift);
+    }
+    return v;
+}
+
+static int32_t saturate32(int64_t v)
+{
+    if (v > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (v < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)v;
+}
+
+static uint64_t magnitude(int64_t v)
+{
+    return v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+}
+
+/* right shift that brings peak below 2^bits */
+static int headroom_shift(uint64_t peak, int bits)
+{
+    int shift = 0;
+    while ((peak >> shift) >= ((uint64_t)1 << bits)) {
+        shift++;
+    }
+    return shift;
+}
+
+/* value = mult * 2^-shift, |mult| in [2^30, 2^31) */
+static int quantize_multiplier(double value, int32_t *mult, int *shift)
+{
+    int exp     = 0;
+    double frac = frexp(value, &exp);
+    int64_t m   = (int64_t)llround(frac * 2147483648.0);
+
+    if (value == 0.0) {
+        *mult  = 0;
+        *shift = 0;
+        return NET_NORMAL;
+    }
+    if (m == ((int64_t)1 << 31) || m == -((int64_t)1 << 31)) {
+        m /= 2;
+        exp++;
+    }
+    *mult  = (int32_t)m;
+    *shift = 31 - exp;
+    return NET_NORMAL;
+}
+
+int linear_q_build(LinearLayerQ *layer, const float *weight, const float *bias,
+                   const double *in_scale, const double *in_offset,
+                   const uint8_t *in_frac)
+{
+    uint16_t i = 0, j = 0;
+    double column_max = 0.0, scale = 0.0, q = 0.0;
+    int32_t mult = 0;
+    int shift    = 0;
+
+    if (!layer || !weight || !bias || !layer->weight || !layer->bias ||
+        !layer->in_mult || !layer->in_shift || !layer->in_offset ||
+        layer->row_num > FIXED_MAX_LAYER_SIZE) {
+        return NET_ERR_GENERIC;
+    }
+
+    for (j = 0; j < layer->row_num; j++) {
+        column_max = 0.0;
+        for (i = 0; i < layer->column_num; i++) {
+            q          = fabs(weight[i * layer->row_num + j]);
+            column_max = q > column_max ? q : column_max;
+        }
+        if (column_max == 0.0) {
+            column_max = 1.0;
+        }
+
+        for (i = 0; i < layer->column_num; i++) {
+            q = round(weight[i * layer->row_num + j] / column_max *
+                      (1 << FIXED_WEIGHT_FRAC));
+            q = q > INT16_MAX ? INT16_MAX : q;
+            layer->weight[i * layer->row_num + j] = (int16_t)q;
+        }
+
+        /* u = (x * scale + offset) * column_max in Q16 */
+        scale = (in_scale ? in_scale[j] : 1.0) * column_max *
+                (1 << FIXED_WORK_FRAC);
+        quantize_multiplier(scale, &mult, &shift);
+        shift += in_frac ? in_frac[j] : 0;
+        if (shift > INT8_MAX) {
+            mult  = 0;
+            shift = 0;
+        }
+        if (shift < INT8_MIN) {
+            return NET_ERR_GENERIC;
+        }
+        layer->in_mult[j]   = mult;
+        layer->in_shift[j]  = (int8_t)shift;
+        layer->in_offset[j] = llround((in_offset ? in_offset[j] : 0.0) *
+                                      column_max * (1 << FIXED_WORK_FRAC));
+    }
+
+    for (i = 0; i < layer->column_num; i++) {
+        layer->bias[i] = llround((double)bias[i] * (1 << FIXED_WORK_FRAC));
+    }
+
+    return NET_NORMAL;
+}
+
+static int64_t requantize(const LinearLayerQ *layer, uint16_t j, int32_t x,
+                          int8_t frac)
+{
+    return shift_round((int64_t)x * layer->in_mult[j],
+                       layer->in_shift[j] + frac) +
+           layer->in_offset[j];
+}
+
+int linear_q_calculation(const LinearLayerQ *layer,
+                         const LayerDataQ *input_data, LayerDataQ *output_data)
+{
+    int32_t input_q[FIXED_MAX_LAYER_SIZE];
+    const int16_t *weight = NULL;
+    uint64_t peak = 0, bound = 0;
+    int64_t tmp_sum = 0;
+    int in_shift = 0, out_shift = 0, acc_frac = 0;
+    uint16_t i = 0, j = 0;
+
+    if (!layer || !input_data || !output_data) {
+        return NET_ERR_GENERIC;
+    }
+
+    if (input_data->size != layer->row_num ||
+        output_data->size != layer->column_num ||
+        layer->row_num > FIXED_MAX_LAYER_SIZE) {
+        return NET_ERR_GENERIC;
+    }
+
+    /* one shared exponent for the requantized inputs */
+    for (j = 0; j < layer->row_num; j++) {
+        tmp_sum = magnitude(
+            requantize(layer, j, input_data->data[j], input_data->frac));
+        peak = (uint64_t)tmp_sum > peak ? (uint64_t)tmp_sum : peak;
+    }
+    in_shift = headroom_shift(peak, FIXED_MANT_BITS);
+
+    for (j = 0; j < layer->row_num; j++) {
+        input_q[j] = (int32_t)shift_round(
+            requantize(layer, j, input_data->data[j], input_data->frac),
+            in_shift);
+        bound += magnitude(input_q[j]);
+    }
+
+    /* |sum(w * u)| <= sum(|u|) * 2^15, pick the output exponent from that
+     * bound instead of buffering 64 bit sums */
+    acc_frac = FIXED_WEIGHT_FRAC + FIXED_WORK_FRAC - in_shift;
+    peak     = 0;
+    for (i = 0; i < layer->column_num; i++) {
+        tmp_sum = magnitude(shift_round(layer->bias[i],
+                                        FIXED_WORK_FRAC - acc_frac));
+        peak    = (uint64_t)tmp_sum > peak ? (uint64_t)tmp_sum : peak;
+    }
+    bound     = (bound << FIXED_WEIGHT_FRAC) + peak;
+    out_shift = headroom_shift(bound, FIXED_MANT_BITS);
+
+    for (i = 0; i < layer->column_num; i++) {
+        weight  = &layer->weight[i * layer->row_num];
+        tmp_sum = shift_round(layer->bias[i], FIXED_WORK_FRAC - acc_frac);
+        for (j = 0; j < layer->row_num; j++) {
+            tmp_sum += (int64_t)weight[j] * input_q[j];
+        }
+        output_data->data[i] = (int32_t)shift_round(tmp_sum, out_shift);
+    }
+    output_data->frac = (int8_t)(acc_frac - out_shift);
+
+    return NET_NORMAL;
+}
+
+int relu_q(LayerDataQ *input_data)
+{
+    uint16_t i = 0;
+    if (!input_data) {
+        return NET_ERR_GENERIC;
+    }
+    for (i = 0; i < input_data->size; i++) {
+        if (input_data->data[i] < 0) {
+            input_data->data[i] = 0;
+        }
+    }
+    return NET_NORMAL;
+}
+
+int max_pool_q(const LayerDataQ *input_data, uint16_t pool_size,
+               int32_t reset, LayerDataQ *output_data)
+{
+    uint16_t i  = 0;
+    int32_t max = 0, reset_q = 0;
+
+    if (!input_data || !output_data || pool_size == 0 ||
+        output_data->size < input_data->size / pool_size) {
+        return NET_ERR_GENERIC;
+    }
+
+    /* a reset beyond the mantissa range is below every input anyway */
+    reset_q = saturate32(shift_round(reset, -input_data->frac));
+    max     = input_data->data[0];
+    for (i = 1; i < input_data->size; ++i) {
+        max = max > input_data->data[i] ? max : input_data->data[i];
+        if ((i + 1) % pool_size == 0) {
+            output_data->data[i / pool_size] = max;
+            max                              = reset_q;
+        }
+    }
+    output_data->frac = input_data->frac;
+    return NET_NORMAL;
+}
+
+uint16_t argmax_q(const LayerDataQ *input_data)
+{
+    uint16_t i = 0, j = 0;
+    for (i = 0; i < input_data->size; i++) {
+        if (input_data->data[i] > input_data->data[j]) {
+            j = i;
+        }
+    }
+    return j;
+}
@@ -0,0 +1,69 @@
+#ifndef __MLP_FIXED_H_
+#define __MLP_FIXED_H_
+
+#include <stdint.h>
+
+/* 1: the step counter extracts integer features and classifies them with
+ * the Q-format networks below, no float/double arithmetic per window */
+#ifndef ALG_FIXED_POINT
+#define ALG_FIXED_POINT 0
+#endif
+
+#define FIXED_WEIGHT_FRAC     (15) /* weight = Q15 of its input column max */
+#define FIXED_WORK_FRAC       (16) /* layer inputs are requantized to Q16 */
+#define FIXED_MANT_BITS       (30) /* |data| < 2^30 after every layer */
+#define FIXED_MAX_LAYER_SIZE  (64) /* widest layer input */
+
+/* block floating point: int32 mantissas sharing one exponent,
+ * value = data[i] * 2^-frac */
+typedef struct LayerDataQ {
+    uint16_t size;
+    int8_t frac;
+    int32_t *data;
+} LayerDataQ;
+
+/* weight has the float layout ([column_num][row_num]), each input column is
+ * scaled by its own max so small and large features keep the same relative
+ * precision; the per input requantization also folds in an optional affine
+ * (batch norm) applied to the input */
+typedef struct LinearLayerQ {
+    uint16_t row_num;
+    uint16_t column_num;
+    int16_t *weight;
+    int64_t *bias;      /* Q16 */
+    int32_t *in_mult;   /* Q31 mantissa of the input scale */
+    int8_t *in_shift;   /* input scale = in_mult * 2^-in_shift */
+    int64_t *in_offset; /* Q16 */
+} LinearLayerQ;
+
+/**
+ * @brief quantize a float layer, done once at init
+ * @param layer: row_num, column_num and the storage pointers must be set
+ * @param weight: float weight, [column_num][row_num]
+ * @param bias: float bias, column_num
+ * @param in_scale: per input scale applied before the layer, NULL for 1
+ * @param in_offset: per input offset applied after in_scale, NULL for 0
+ * @param in_frac: per input fraction bits added to LayerDataQ.frac, NULL
+ * for 0
+ * @return 0 on success, -1 when the layer cannot be represented
+ */
+int linear_q_build(LinearLayerQ *layer, const float *weight, const float *bias,
+                   const double *in_scale, const double *in_offset,
+                   const uint8_t *in_frac);
+
+int linear_q_calculation(const LinearLayerQ *layer,
+                         const LayerDataQ *input_data,
+                         LayerDataQ *output_data);
+
+int relu_q(LayerDataQ *input_data);
+
+/**
+ * @brief max over consecutive groups of pool_size, every group after the
+ * first starts from reset (in value units) like the float max_pool
+ */
+int max_pool_q(const LayerDataQ *input_data, uint16_t pool_size,
+               int32_t reset, LayerDataQ *output_data);
+
+uint16_t argmax_q(const LayerDataQ *input_data);
+
+#endif
@@ -0,0 +1,305 @@
+#include "alg_mlp_int8.h"
+#include <math.h>
+#include <stddef.h>
+
+#define NET_NORMAL      0
+#define NET_ERR_GENERIC -1
+
+/* value = mult * 2^-shift, mult in [2^30, 2^31), shift in [1, 62] */
+static int quantize_multiplier(double value, int32_t *mult, int8_t *shift)
+{
+    int exp     = 0;
+    double frac = frexp(value, &exp);
+    int64_t m   = (int64_t)llround(frac * 2147483648.0);
+
+    if (!(value > 0.0)) {
+        return NET_ERR_GENERIC;
+    }
+    if (m == ((int64_t)1 << 31)) {
+        m /= 2;
+        exp++;
+    }
+    if (31 - exp < 1 || 31 - exp > 62) {
+        return NET_ERR_GENERIC;
+    }
+    *mult  = (int32_t)m;
+    *shift = (int8_t)(31 - exp);
+    return NET_NORMAL;
+}
+
+static int8_t saturate8(int32_t v, int32_t min)
+{
+    if (v > INT8_MAX) {
+        return INT8_MAX;
+    }
+    if (v < min) {
+        return (int8_t)min;
+    }
+    return (int8_t)v;
+}
+
+/* per output channel: w_q = round(w * in_scale / w_scale) with
+ * w_scale = max |w * in_scale| / 127, out = acc * w_scale / out_scale */
+static int linear_i8_build(uint16_t row_num, uint16_t column_num,
+                           const double *weight, const double *bias,
+                           const double *in_scale, double out_scale,
+                           int8_t *weight_q, int32_t *bias_q, int32_t *mult,
+                           int8_t *shift)
+{
+    uint16_t i = 0, j = 0;
+    double w_max = 0.0, w_scale = 0.0, q = 0.0;
+
+    for (i = 0; i < column_num; i++) {
+        w_max = 0.0;
+        for (j = 0; j < row_num; j++) {
+            q     = fabs(weight[i * row_num + j] * in_scale[j]);
+            w_max = q > w_max ? q : w_max;
+        }
+        // a dead channel still gets a valid scale
+        w_scale = w_max > 0.0 ? w_max / INT8_MAX : 1.0;
+
+        for (j = 0; j < row_num; j++) {
+            weight_q[i * row_num + j] = (int8_t)lround(
+                weight[i * row_num + j] * in_scale[j] / w_scale);
+        }
+        q = round(bias[i] / w_scale);
+        if (fabs(q) > (double)(INT32_MAX >> 1)) {
+            return NET_ERR_GENERIC;
+        }
+        bias_q[i] = (int32_t)q;
+        if (quantize_multiplier(w_scale / out_scale, &mult[i], &shift[i]) !=
+            NET_NORMAL) {
+            return NET_ERR_GENERIC;
+        }
+    }
+    return NET_NORMAL;
+}
+
+int mlp_i8_build(const MlpFloat *net, const double *in_max, double hidden_max,
+                 MlpI8Storage *storage, MlpI8 *out)
+{
+    double in_scale[INT8_MAX_LAYER_SIZE];
+    double hidden_scale[INT8_MAX_LAYER_SIZE];
+    uint16_t j = 0;
+    int ret;
+
+    if (!net || !in_max || !storage || !out || net->pool_size == 0 ||
+        net->input_size > INT8_MAX_LAYER_SIZE ||
+        net->hidden_size > INT8_MAX_LAYER_SIZE ||
+        net->output_size > INT8_MAX_LAYER_SIZE ||
+        net->output_size % net->pool_size != 0) {
+        return NET_ERR_GENERIC;
+    }
+
+    for (j = 0; j < net->input_size; j++) {
+        in_scale[j] = in_max[j] > 0.0 ? in_max[j] / INT8_MAX : 1.0;
+        storage->in_inv_scale[j] = (float)(1.0 / in_scale[j]);
+    }
+    for (j = 0; j < net->hidden_size; j++) {
+        hidden_scale[j] = hidden_max > 0.0 ? hidden_max / INT8_MAX : 1.0;
+    }
+
+    ret = linear_i8_build(net->input_size, net->hidden_size, net->weight1,
+                          net->bias1, in_scale, hidden_scale[0],
+                          storage->weight1, storage->bias1, storage->mult1,
+                          storage->shift1);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+    ret = linear_i8_build(net->hidden_size, net->output_size, net->weight2,
+                          net->bias2, hidden_scale,
+                          1.0 / (1 << INT8_LOGIT_FRAC), storage->weight2,
+                          storage->bias2, storage->mult2, storage->shift2);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+
+    out->pool_size    = net->pool_size;
+    out->in_inv_scale = storage->in_inv_scale;
+    out->layer1 = (LinearLayerI8){ net->input_size, net->hidden_size,
+                                   storage->weight1, storage->bias1,
+                                   storage->mult1, storage->shift1 };
+    out->layer2 = (LinearLayerI8){ net->hidden_size, net->output_size,
+                                   storage->weight2, storage->bias2,
+                                   storage->mult2, storage->shift2 };
+    return NET_NORMAL;
+}
+
+/* int32 accumulate of one layer, requantized per output channel */
+static void linear_i8_calculation(const LinearLayerI8 *layer,
+                                  const int8_t *input, int32_t *output)
+{
+    const int8_t *weight = NULL;
+    int32_t acc = 0;
+    uint16_t i = 0, j = 0;
+
+    for (i = 0; i < layer->column_num; i++) {
+        weight = &layer->weight[i * layer->row_num];
+        acc    = layer->bias[i];
+        for (j = 0; j < layer->row_num; j++) {
+            acc += (int32_t)weight[j] * input[j];
+        }
+        output[i] = (int32_t)(((int64_t)acc * layer->mult[i] +
+                               ((int64_t)1 << (layer->shift[i] - 1))) >>
+                              layer->shift[i]);
+    }
+}
+
+/* max over consecutive groups of pool_size, then the first largest group */
+static int pool_argmax(const int32_t *data, uint16_t size, uint16_t pool_size)
+{
+    int32_t max = 0, best = 0;
+    uint16_t i = 0, j = 0;
+    int class = 0;
+
+    for (i = 0; i < size / pool_size; i++) {
+        max = data[i * pool_size];
+        for (j = 1; j < pool_size; j++) {
+            max = data[i * pool_size + j] > max ? data[i * pool_size + j] : max;
+        }
+        if (i == 0 || max > best) {
+            best  = max;
+            class = i;
+        }
+    }
+    return class;
+}
+
+int mlp_i8_forward(const MlpI8 *net, const float *input, int *class)
+{
+    int8_t input_q[INT8_MAX_LAYER_SIZE];
+    int8_t hidden_q[INT8_MAX_LAYER_SIZE];
+    int32_t output[INT8_MAX_LAYER_SIZE];
+    uint16_t j = 0;
+
+    if (!net || !input || !class ||
+        net->layer1.row_num > INT8_MAX_LAYER_SIZE ||
+        net->layer1.column_num != net->layer2.row_num ||
+        net->layer2.row_num > INT8_MAX_LAYER_SIZE ||
+        net->layer2.column_num > INT8_MAX_LAYER_SIZE || net->pool_size == 0) {
+        return NET_ERR_GENERIC;
+    }
+
+    for (j = 0; j < net->layer1.row_num; j++) {
+        float v = input[j] * net->in_inv_scale[j];
+        v       = v > INT8_MAX ? INT8_MAX : (v < -INT8_MAX ? -INT8_MAX : v);
+        input_q[j] = (int8_t)lroundf(v);
+    }
+
+    linear_i8_calculation(&net->layer1, input_q, output);
+    // ReLU is the lower clamp of the hidden requantization
+    for (j = 0; j < net->layer1.column_num; j++) {
+        hidden_q[j] = saturate8(output[j], 0);
+    }
+
+    linear_i8_calculation(&net->layer2, hidden_q, output);
+    *class = pool_argmax(output, net->layer2.column_num, net->pool_size);
+    return NET_NORMAL;
+}
+
+int mlp_float_forward(const MlpFloat *net, const float *input, double *hidden)
+{
+    double h[INT8_MAX_LAYER_SIZE];
+    double output[INT8_MAX_LAYER_SIZE];
+    double max = 0.0, best = 0.0;
+    uint16_t i = 0, j = 0;
+    int class = 0;
+
+    for (i = 0; i < net->hidden_size; i++) {
+        h[i] = net->bias1[i];
+        for (j = 0; j < net->input_size; j++) {
+            h[i] += net->weight1[i * net->input_size + j] * input[j];
+        }
+        h[i] = h[i] < 0.0 ? 0.0 : h[i];
+        if (hidden) {
+            hidden[i] = h[i];
+        }
+    }
+    for (i = 0; i < net->output_size; i++) {
+        output[i] = net->bias2[i];
+        for (j = 0; j < net->hidden_size; j++) {
+            output[i] += net->weight2[i * net->hidden_size + j] * h[j];
+        }
+    }
+    for (i = 0; i < net->output_size / net->pool_size; i++) {
+        max = output[i * net->pool_size];
+        for (j = 1; j < net->pool_size; j++) {
+            max = output[i * net->pool_size + j] > max
+                      ? output[i * net->pool_size + j]
+                      : max;
+        }
+        if (i == 0 || max > best) {
+            best  = max;
+            class = i;
+        }
+    }
+    return class;
+}
+
+static void export_array(FILE *fp, const char *type, const char *name,
+                         const char *field, const void *data, uint16_t len)
+{
+    uint16_t per_line = type[0] == 'f' ? 4 : (type[3] == '8' ? 12 : 6);
+    uint16_t i = 0;
+
+    fprintf(fp, "static const %s %s_%s[%u] = {", type, name, field, len);
+    for (i = 0; i < len; i++) {
+        fprintf(fp, "%s", i % per_line == 0 ? "\n   " : "");
+        if (type[0] == 'f') {
+            fprintf(fp, " %.9gf,", ((const float *)data)[i]);
+        } else if (type[3] == '8') {
+            fprintf(fp, " %d,", ((const int8_t *)data)[i]);
+        } else {
+            fprintf(fp, " %ld,", (long)((const int32_t *)data)[i]);
+        }
+    }
+    fprintf(fp, "\n};\n");
+}
+
+static void export_layer(FILE *fp, const char *name, const char *layer_name,
+                         const LinearLayerI8 *layer)
+{
+    char field[32];
+
+    snprintf(field, sizeof(field), "%s_weight", layer_name);
+    export_array(fp, "int8_t", name, field, layer->weight,
+                 layer->row_num * layer->column_num);
+    snprintf(field, sizeof(field), "%s_bias", layer_name);
+    export_array(fp, "int32_t", name, field, layer->bias, layer->column_num);
+    snprintf(field, sizeof(field), "%s_mult", layer_name);
+    export_array(fp, "int32_t", name, field, layer->mult, layer->column_num);
+    snprintf(field, sizeof(field), "%s_shift", layer_name);
+    export_array(fp, "int8_t", name, field, layer->shift, layer->column_num);
+}
+
+int mlp_i8_export(const MlpI8 *net, const char *name, FILE *fp)
+{
+    const LinearLayerI8 *layer[2];
+    const char *layer_name[2] = { "layer1", "layer2" };
+    uint16_t i = 0;
+
+    if (!net || !name || !fp) {
+        return NET_ERR_GENERIC;
+    }
+    layer[0] = &net->layer1;
+    layer[1] = &net->layer2;
+
+    fprintf(fp, "/* generated by int8_calibrate, do not edit */\n");
+    fprintf(fp, "#include \"alg_mlp_int8.h\"\n\n");
+    export_array(fp, "float", name, "in_inv_scale", net->in_inv_scale,
+                 net->layer1.row_num);
+    for (i = 0; i < 2; i++) {
+        export_layer(fp, name, layer_name[i], layer[i]);
+    }
+    fprintf(fp, "\nconst MlpI8 %s = {\n    %u,\n    %s_in_inv_scale,\n", name,
+            net->pool_size, name);
+    for (i = 0; i < 2; i++) {
+        fprintf(fp,
+                "    { %u, %u,\n      %s_%s_weight,\n      %s_%s_bias,\n"
+                "      %s_%s_mult,\n      %s_%s_shift },\n",
+                layer[i]->row_num, layer[i]->column_num, name, layer_name[i],
+                name, layer_name[i], name, layer_name[i], name, layer_name[i]);
+    }
+    fprintf(fp, "};\n");
+    return ferror(fp) ? NET_ERR_GENERIC : NET_NORMAL;
+}
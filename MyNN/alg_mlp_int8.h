@@ -0,0 +1,86 @@
+#ifndef __MLP_INT8_H_
+#define __MLP_INT8_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define INT8_MAX_LAYER_SIZE (64) /* widest layer input or output */
+#define INT8_LOGIT_FRAC     (16) /* the last layer outputs Q16 logits */
+
+/* weight has the float layout ([column_num][row_num]) with one scale per
+ * output channel; acc = bias + sum(w * x) is int32 and the output is
+ * acc * mult * 2^-shift rounded to nearest */
+typedef struct LinearLayerI8 {
+    uint16_t row_num;
+    uint16_t column_num;
+    const int8_t *weight;
+    const int32_t *bias;  /* in accumulator units */
+    const int32_t *mult;  /* Q31 mantissa of the output scale */
+    const int8_t *shift;
+} LinearLayerI8;
+
+/* Linear -> ReLU -> Linear -> max_pool -> argmax on int8 weights and
+ * activations. Inputs are quantized per feature, the hidden layer shares
+ * one scale and the logits are Q(INT8_LOGIT_FRAC). */
+typedef struct MlpI8 {
+    uint16_t pool_size;
+    const float *in_inv_scale; /* input j is round(x * in_inv_scale[j]) */
+    LinearLayerI8 layer1;      /* requantized to the hidden scale */
+    LinearLayerI8 layer2;      /* requantized to Q(INT8_LOGIT_FRAC) */
+} MlpI8;
+
+/* the float network to quantize, with any batch norm already folded into
+ * the two layers; weights are [column_num][row_num] */
+typedef struct MlpFloat {
+    uint16_t input_size;
+    uint16_t hidden_size;
+    uint16_t output_size;
+    uint16_t pool_size;
+    const double *weight1;
+    const double *bias1;
+    const double *weight2;
+    const double *bias2;
+} MlpFloat;
+
+/* writable tables behind an MlpI8 built on the host */
+typedef struct MlpI8Storage {
+    float in_inv_scale[INT8_MAX_LAYER_SIZE];
+    int8_t weight1[INT8_MAX_LAYER_SIZE * INT8_MAX_LAYER_SIZE];
+    int32_t bias1[INT8_MAX_LAYER_SIZE];
+    int32_t mult1[INT8_MAX_LAYER_SIZE];
+    int8_t shift1[INT8_MAX_LAYER_SIZE];
+    int8_t weight2[INT8_MAX_LAYER_SIZE * INT8_MAX_LAYER_SIZE];
+    int32_t bias2[INT8_MAX_LAYER_SIZE];
+    int32_t mult2[INT8_MAX_LAYER_SIZE];
+    int8_t shift2[INT8_MAX_LAYER_SIZE];
+} MlpI8Storage;
+
+/**
+ * @brief float reference of an MlpFloat, same pooling and argmax as
+ * mlp_i8_forward()
+ * @param hidden: receives the ReLU outputs for calibration, may be NULL
+ * @return the class
+ */
+int mlp_float_forward(const MlpFloat *net, const float *input, double *hidden);
+
+/**
+ * @brief quantize a float network, done once on the host
+ * @param in_max: per input clipping range from calibration
+ * @param hidden_max: clipping range of the ReLU outputs from calibration
+ * @return 0 on success, -1 when a scale cannot be represented
+ */
+int mlp_i8_build(const MlpFloat *net, const double *in_max, double hidden_max,
+                 MlpI8Storage *storage, MlpI8 *out);
+
+/**
+ * @brief integer inference, only the input quantization touches floats
+ */
+int mlp_i8_forward(const MlpI8 *net, const float *input, int *class);
+
+/**
+ * @brief write net as a C source of const tables that defines
+ * "const MlpI8 name"
+ */
+int mlp_i8_export(const MlpI8 *net, const char *name, FILE *fp);
+
+#endif
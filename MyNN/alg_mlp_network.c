@@ -1,4 +1,6 @@
 #include "alg_mlp_network.h"
+#include "alg_trace.h"
+#include "alg_profile.h"
 
 /* define the BP networks*/
 #define NETWORKS_INPUT_SIZE (20) /* input data feature dimension */
@@ -16,21 +18,6 @@
 
 /* weight: reshape the original [row_num, column_num] matrix into
  * [row_num*column_num, 1] along columns */
-typedef struct NetwoksLayer {
-    uint16_t row_num;
-    uint16_t column_num;
-    const float *weight;
-    const float *bias;
-} NetwoksLayer;
-
-typedef struct BpNetworks {
-    NetwoksLayer linner_layer1;
-    NetwoksLayer linner_layer2;
-
-} BpNetworks;
-
-static BpNetworks bp_networks;
-
 //* changed weight
 const float linner_layer1_weight[NETWORKS_INPUT_SIZE * NETWORKS_LINNER1_SIZE] = {
     -0.4701206516861406,     -0.1597129991336361,   -0.9465172353339458,
@@ -939,209 +926,243 @@ const char *action_list[11] = {
     "squat",         "trot",         "walk",          "wave",
     "lunge",         "good_morning", "tuck_jumping"
 };
-static int linear_calculation(NetwoksLayer *layer, LayerData *input_data,
-                              LayerData *output_data)
-{
-    uint16_t i = 0, j = 0;
-    float tmp_sum = 0.0f;
+/* execution plan built once by networks_init() and read only afterwards.
+ * The batch norm after the ReLU is an affine map per hidden unit, so it is
+ * folded into linner_layer2: w2' = w2 * scale, b2' = b2 + w2 . offset.
+ * Weights are stored transposed ([row_num][column_num]) so one input
+ * updates every output at once, each output is still summed in input order. */
+typedef struct NetworksPlan {
+    uint8_t ready;
+    float linner_layer1_weight[NETWORKS_INPUT_SIZE * NETWORKS_LINNER1_SIZE];
+    float linner_layer2_weight[NETWORKS_LINNER1_SIZE * NETWORKS_LINNER2_SIZE];
+    float linner_layer2_bias[NETWORKS_LINNER2_SIZE];
+} NetworksPlan;
 
-    if (!layer || !input_data || !output_data) {
-        return NET_ERR_GENERIC;
-    }
+static NetworksPlan networks_plan;
 
-    if (input_data->size != layer->row_num ||
-        output_data->size != layer->column_num) {
-        return NET_ERR_GENERIC;
-    }
+#if ALG_FIXED_POINT
+/* Q-format copy of the layers, derived from the float tables once in
+ * networks_init() and read only afterwards; the batch norm after layer 1 is
+ * folded into the input requantization of layer 2 */
+static int16_t linner_layer1_weight_q[NETWORKS_INPUT_SIZE *
+                                      NETWORKS_LINNER1_SIZE];
+static int64_t linner_layer1_bias_q[NETWORKS_LINNER1_SIZE];
+static int32_t linner_layer1_mult_q[NETWORKS_INPUT_SIZE];
+static int8_t linner_layer1_shift_q[NETWORKS_INPUT_SIZE];
+static int64_t linner_layer1_offset_q[NETWORKS_INPUT_SIZE];
 
-    for (i = 0; i < output_data->size; i++) {
-        tmp_sum = 0.0f;
-        for (j = 0; j < layer->row_num - 5; j += 5) {
-            tmp_sum +=
-                input_data->data[j] * layer->weight[i * layer->row_num + j];
+static int16_t linner_layer2_weight_q[NETWORKS_LINNER1_SIZE *
+                                      NETWORKS_LINNER2_SIZE];
+static int64_t linner_layer2_bias_q[NETWORKS_LINNER2_SIZE];
+static int32_t linner_layer2_mult_q[NETWORKS_LINNER1_SIZE];
+static int8_t linner_layer2_shift_q[NETWORKS_LINNER1_SIZE];
+static int64_t linner_layer2_offset_q[NETWORKS_LINNER1_SIZE];
 
-            tmp_sum += input_data->data[j + 1] *
-                       layer->weight[i * layer->row_num + j + 1];
+static LinearLayerQ linner_layer1_q = {
+    NETWORKS_INPUT_SIZE,   NETWORKS_LINNER1_SIZE, linner_layer1_weight_q,
+    linner_layer1_bias_q,  linner_layer1_mult_q,  linner_layer1_shift_q,
+    linner_layer1_offset_q
+};
+static LinearLayerQ linner_layer2_q = {
+    NETWORKS_LINNER1_SIZE, NETWORKS_LINNER2_SIZE, linner_layer2_weight_q,
+    linner_layer2_bias_q,  linner_layer2_mult_q,  linner_layer2_shift_q,
+    linner_layer2_offset_q
+};
 
-            tmp_sum += input_data->data[j + 2] *
-                       layer->weight[i * layer->row_num + j + 2];
+/* feature layout of the step counter, peak interval features are Q8 */
+static const uint8_t input_frac[NETWORKS_INPUT_SIZE] = {
+    0, 0, 0, 0, 0, 0, 0, NETWORKS_LAMBDA_FRAC, NETWORKS_LAMBDA_FRAC,
+    NETWORKS_LAMBDA_FRAC, 0, 0, 0, 0, 0, 0, 0, NETWORKS_LAMBDA_FRAC,
+    NETWORKS_LAMBDA_FRAC, NETWORKS_LAMBDA_FRAC
+};
+#endif
 
-            tmp_sum += input_data->data[j + 3] *
-                       layer->weight[i * layer->row_num + j + 3];
+int networks_init(void)
+{
+    // the plan is read only afterwards, so any number of step counter
+    // contexts can share it
+    double scale[NETWORKS_BATCHNORMAL1D_SIZE];
+    double offset[NETWORKS_BATCHNORMAL1D_SIZE];
+    double bias = 0;
+    const float *weight = NULL;
+    uint16_t i = 0, k = 0;
+#if ALG_FIXED_POINT
+    int ret;
+#endif
 
-            tmp_sum += input_data->data[j + 4] *
-                       layer->weight[i * layer->row_num + j + 4];
-        }
+    for (i = 0; i < NETWORKS_BATCHNORMAL1D_SIZE; i++) {
+        scale[i]  = batch_normal_weight[i] /
+                   sqrt(batch_normal_running_var[i] + EPS);
+        offset[i] = batch_normal_bias[i] -
+                    batch_normal_running_mean[i] * scale[i];
+    }
 
-        for (; j < layer->row_num; ++j) {
-            tmp_sum +=
-                input_data->data[j] * layer->weight[i * layer->row_num + j];
+    for (k = 0; k < NETWORKS_LINNER1_SIZE; k++) {
+        weight = linner_layer1_weight + k * NETWORKS_INPUT_SIZE;
+        for (i = 0; i < NETWORKS_INPUT_SIZE; i++) {
+            networks_plan.linner_layer1_weight[i * NETWORKS_LINNER1_SIZE + k] =
+                weight[i];
         }
-
-        tmp_sum += layer->bias[i];
-        output_data->data[i] = tmp_sum;
     }
+    for (k = 0; k < NETWORKS_LINNER2_SIZE; k++) {
+        weight = linner_layer2_weight + k * NETWORKS_LINNER1_SIZE;
+        bias   = linner_layer2_bias[k];
+        for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+            networks_plan.linner_layer2_weight[i * NETWORKS_LINNER2_SIZE + k] =
+                (float)(weight[i] * scale[i]);
+            bias += weight[i] * offset[i];
+        }
+        networks_plan.linner_layer2_bias[k] = (float)bias;
+    }
+    networks_plan.ready = 1;
 
+#if ALG_FIXED_POINT
+    ret = linear_q_build(&linner_layer1_q, linner_layer1_weight,
+                         linner_layer1_bias, NULL, NULL, input_frac);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+    return linear_q_build(&linner_layer2_q, linner_layer2_weight,
+                          linner_layer2_bias, scale, offset, NULL);
+#else
     return NET_NORMAL;
+#endif
 }
 
-static int relu(LayerData *input_data)
+/**
+ * @brief linner_layer1 -> relu -> linner_layer2 (batch norm folded) ->
+ * max_pool -> argmax in one pass. Sums run in the same order as the former
+ * layer by layer code, hidden units zeroed by the ReLU are skipped and
+ * max_pool still restarts every group after the first from -100000.
+ */
+int foward_process(LayerData *input_data, int *class)
 {
-    uint16_t i = 0;
-    if (!input_data) {
+    const float *weight = NULL;
+    float hidden[NETWORKS_LINNER1_SIZE] = { 0.0f };
+    float output[NETWORKS_LINNER2_SIZE] = { 0.0f };
+    float x = 0.0f, pool = 0.0f, best = 0.0f;
+    uint16_t i = 0, j = 0;
+    int best_class = 0;
+
+    if (!input_data || !class || !networks_plan.ready ||
+        input_data->size != NETWORKS_INPUT_SIZE) {
         return NET_ERR_GENERIC;
     }
-    for (i = 0; i < input_data->size; i++) {
-        if (input_data->data[i] < 0.0f) {
-            input_data->data[i] = 0.0f;
-        }
-    }
-    return NET_NORMAL;
-}
+    ALG_TRACE_BEGIN(TRACE_NET_FORWARD);
+    ALG_TRACE_FLOATS(TRACE_NET_INPUT, input_data->data, NETWORKS_INPUT_SIZE);
 
-static int batch_normal1d(LayerData *input_data)
-{
-    uint16_t i = 0;
-    for (i = 0; i < input_data->size - 5; i += 4) {
-        input_data->data[i] =
-            ((input_data->data[i] - batch_normal_running_mean[i]) /
-             sqrt(batch_normal_running_var[i] + EPS)) *
-                batch_normal_weight[i] +
-            batch_normal_bias[i];
-        input_data->data[i + 1] =
-            ((input_data->data[i + 1] - batch_normal_running_mean[i + 1]) /
-             sqrt(batch_normal_running_var[i + 1] + EPS)) *
-                batch_normal_weight[i + 1] +
-            batch_normal_bias[i + 1];
-        input_data->data[i + 2] =
-            ((input_data->data[i + 2] - batch_normal_running_mean[i + 2]) /
-             sqrt(batch_normal_running_var[i + 2] + EPS)) *
-                batch_normal_weight[i + 2] +
-            batch_normal_bias[i + 2];
-        input_data->data[i + 3] =
-            ((input_data->data[i + 3] - batch_normal_running_mean[i + 3]) /
-             sqrt(batch_normal_running_var[i + 3] + EPS)) *
-                batch_normal_weight[i + 3] +
-            batch_normal_bias[i + 3];
-    }
-    for (; i < input_data->size; ++i) {
-        input_data->data[i] =
-            ((input_data->data[i] - batch_normal_running_mean[i]) /
-             sqrt(batch_normal_running_var[i] + EPS)) *
-                batch_normal_weight[i] +
-            batch_normal_bias[i];
+    ALG_PROFILE_BEGIN(layer1_mark);
+    for (j = 0; j < NETWORKS_INPUT_SIZE; j++) {
+        x      = input_data->data[j];
+        weight = networks_plan.linner_layer1_weight +
+                 j * NETWORKS_LINNER1_SIZE;
+        for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+            hidden[i] += x * weight[i];
+        }
     }
-    return NET_NORMAL;
-}
-static int max_pool(LayerData *input_data, LayerData *output_data)
-{
-    uint16_t i = 0;
-    float max  = input_data->data[0];
-    for (i = 1; i < input_data->size; ++i) {
-        max = max > input_data->data[i] ? max : input_data->data[i];
-        if ((i + 1) % NETWORKS_POOL_SIZE == 0) {
-            output_data->data[i / NETWORKS_POOL_SIZE] = max;
-            max                                       = -100000;
+    for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+        hidden[i] += linner_layer1_bias[i];
+        if (hidden[i] < 0.0f) {
+            hidden[i] = 0.0f;
         }
     }
-    return NET_NORMAL;
-}
-
-int networks_init(void)
-{
-    memset(&bp_networks, 0, sizeof(BpNetworks));
-
-    bp_networks.linner_layer1.row_num    = NETWORKS_INPUT_SIZE;
-    bp_networks.linner_layer1.column_num = NETWORKS_LINNER1_SIZE;
-    bp_networks.linner_layer1.weight     = linner_layer1_weight;
-    bp_networks.linner_layer1.bias       = linner_layer1_bias;
-
-    bp_networks.linner_layer2.row_num    = NETWORKS_LINNER1_SIZE;
-    bp_networks.linner_layer2.column_num = NETWORKS_LINNER2_SIZE;
-    bp_networks.linner_layer2.weight     = linner_layer2_weight;
-    bp_networks.linner_layer2.bias       = linner_layer2_bias;
 
-    return NET_NORMAL;
-}
+    ALG_PROFILE_END(PROFILE_NET_LAYER1, layer1_mark);
+    ALG_TRACE_FLOATS(TRACE_NET_HIDDEN, hidden, NETWORKS_LINNER1_SIZE);
 
-static ClassResult result_classification(LayerData *hidden_layer_output)
-{
-    uint16_t i = 0, j = 0;
-    for (i = 0; i < hidden_layer_output->size; i++) {
-        if (hidden_layer_output->data[i] > hidden_layer_output->data[j]) {
-            j = i;
+    ALG_PROFILE_BEGIN(layer2_mark);
+    for (j = 0; j < NETWORKS_LINNER1_SIZE; j++) {
+        x = hidden[j];
+        if (x == 0.0f) {
+            continue;
+        }
+        weight = networks_plan.linner_layer2_weight +
+                 j * NETWORKS_LINNER2_SIZE;
+        for (i = 0; i < NETWORKS_LINNER2_SIZE; i++) {
+            output[i] += x * weight[i];
         }
     }
-    return (ClassResult)j;
-}
-void dump_layer(LayerData *input_data)
-{
-    for (int i = 0; i < input_data->size; ++i) {
-        printf("%f ", input_data->data[i]);
-    }
-    printf("\n\n");
-}
 
-int foward_process(LayerData *input_data, int *class)
-{
-    float linner_layer1_output_data[NETWORKS_LINNER1_SIZE] = { 0.0f };
-    float linner_layer2_output_data[NETWORKS_LINNER2_SIZE] = { 0.0f };
-    LayerData linner_layer1_output;
-    LayerData linner_layer2_output;
-
-    linner_layer1_output.size = NETWORKS_LINNER1_SIZE;
-    linner_layer1_output.data = linner_layer1_output_data;
+    ALG_PROFILE_END(PROFILE_NET_LAYER2, layer2_mark);
 
-    linner_layer2_output.size = NETWORKS_LINNER2_SIZE;
-    linner_layer2_output.data = linner_layer2_output_data;
+    ALG_PROFILE_BEGIN(pool_mark);
+    for (i = 0; i < NETWORKS_LINNER2_SIZE; i++) {
+        x         = output[i] + networks_plan.linner_layer2_bias[i];
+        output[i] = x;
+        if (i % NETWORKS_POOL_SIZE == 0) {
+            pool = i == 0 ? x : -100000;
+        }
+        pool = (i == 0 || pool > x) ? pool : x;
+        if ((i + 1) % NETWORKS_POOL_SIZE == 0 &&
+            (i + 1 == NETWORKS_POOL_SIZE || pool > best)) {
+            best       = pool;
+            best_class = i / NETWORKS_POOL_SIZE;
+        }
+    }
 
-    float hidden_layer_output_data[NETWORKS_OUTPUT_SIZE] = { 0.0f };
+    ALG_PROFILE_END(PROFILE_NET_POOL, pool_mark);
+    ALG_TRACE_FLOATS(TRACE_NET_OUTPUT, output, NETWORKS_LINNER2_SIZE);
 
-    LayerData hidden_layer_output;
-    hidden_layer_output.size = NETWORKS_OUTPUT_SIZE;
-    hidden_layer_output.data = hidden_layer_output_data;
+    *class = best_class;
+    ALG_TRACE_INTS(TRACE_NET_CLASS, class, 1);
+    ALG_TRACE_END(TRACE_NET_FORWARD);
+    return NET_NORMAL;
+}
 
+#if ALG_FIXED_POINT
+int foward_process_q(const LayerDataQ *input_data, int *class)
+{
+    int32_t linner_layer1_output_data[NETWORKS_LINNER1_SIZE] = { 0 };
+    int32_t linner_layer2_output_data[NETWORKS_LINNER2_SIZE] = { 0 };
+    int32_t hidden_layer_output_data[NETWORKS_OUTPUT_SIZE]   = { 0 };
+    LayerDataQ linner_layer1_output = { NETWORKS_LINNER1_SIZE, 0,
+                                        linner_layer1_output_data };
+    LayerDataQ linner_layer2_output = { NETWORKS_LINNER2_SIZE, 0,
+                                        linner_layer2_output_data };
+    LayerDataQ hidden_layer_output  = { NETWORKS_OUTPUT_SIZE, 0,
+                                        hidden_layer_output_data };
     int ret;
-    printf("asdsadasdas");
-    dump_layer(input_data);
-    ret = linear_calculation(&bp_networks.linner_layer1, input_data,
-                             &linner_layer1_output);
 
-    if (ret != NET_NORMAL) {
-        printf("linnear1 wrong!\n");
-        return ret;
+    ALG_TRACE_BEGIN(TRACE_NET_FORWARD);
+    ALG_TRACE_INTS(TRACE_NET_INPUT, input_data->data, input_data->size);
+    ALG_PROFILE_BEGIN(layer1_mark);
+    ret = linear_q_calculation(&linner_layer1_q, input_data,
+                               &linner_layer1_output);
+    if (ret == NET_NORMAL) {
+        ret = relu_q(&linner_layer1_output);
     }
-    dump_layer(&linner_layer1_output);
-    ret = relu(&linner_layer1_output);
-
+    ALG_PROFILE_END(PROFILE_NET_LAYER1, layer1_mark);
     if (ret != NET_NORMAL) {
-        printf("relu wrong!\n");
+        // the span is closed on every return, the trace stays balanced
+        ALG_TRACE_END(TRACE_NET_FORWARD);
         return ret;
     }
-    dump_layer(&linner_layer1_output);
-    ret = batch_normal1d(&linner_layer1_output);
-
+    ALG_TRACE_INTS(TRACE_NET_HIDDEN, linner_layer1_output_data,
+                   NETWORKS_LINNER1_SIZE);
+    ALG_PROFILE_BEGIN(layer2_mark);
+    ret = linear_q_calculation(&linner_layer2_q, &linner_layer1_output,
+                               &linner_layer2_output);
+    ALG_PROFILE_END(PROFILE_NET_LAYER2, layer2_mark);
     if (ret != NET_NORMAL) {
-        printf("batch_normal1d wrong!\n");
+        ALG_TRACE_END(TRACE_NET_FORWARD);
         return ret;
     }
-    dump_layer(&linner_layer1_output);
-    ret = linear_calculation(&bp_networks.linner_layer2, &linner_layer1_output,
-                             &linner_layer2_output);
-
-    if (ret != NET_NORMAL) {
-        printf("linnear2 wrong!\n");
-        return ret;
+    ALG_TRACE_INTS(TRACE_NET_OUTPUT, linner_layer2_output_data,
+                   NETWORKS_LINNER2_SIZE);
+    ALG_PROFILE_BEGIN(pool_mark);
+    // same -100000 restart as the float foward_process()
+    ret = max_pool_q(&linner_layer2_output, NETWORKS_POOL_SIZE, -100000,
+                     &hidden_layer_output);
+    if (ret == NET_NORMAL) {
+        *class = argmax_q(&hidden_layer_output);
     }
-    dump_layer(&linner_layer2_output);
-    ret = max_pool(&linner_layer2_output, &hidden_layer_output);
-
+    ALG_PROFILE_END(PROFILE_NET_POOL, pool_mark);
     if (ret != NET_NORMAL) {
-        printf("max_pool wrong!\n");
+        ALG_TRACE_END(TRACE_NET_FORWARD);
         return ret;
     }
-    dump_layer(&hidden_layer_output);
-    *class = result_classification(&hidden_layer_output);
-    printf("action:%s\n", action_list[*class]);
+    ALG_TRACE_INTS(TRACE_NET_CLASS, class, 1);
+    ALG_TRACE_END(TRACE_NET_FORWARD);
     return ret;
 }
+#endif
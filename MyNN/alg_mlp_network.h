@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "alg_mlp_fixed.h"
 
 typedef enum ClassResult
 {
@@ -27,9 +28,18 @@ typedef struct LayerData
     float *data;
 } LayerData;
 
+/* builds the execution plan, call it once before foward_process() */
 int networks_init(void);
 
 /* input_data size should be 2 */
 int foward_process(LayerData *input_data, int *class);
 
+#if ALG_FIXED_POINT
+/* fraction bits of the peak interval features (7-9, 17-19), the others are
+ * plain integers */
+#define NETWORKS_LAMBDA_FRAC (8)
+
+int foward_process_q(const LayerDataQ *input_data, int *class);
+#endif
+
 #endif
\ No newline at end of file
@@ -14,6 +14,14 @@
 #define NET_NORMAL 0
 #define NET_ERR_GENERIC -1
 
+/* rows per tile of foward_process_batch(), the activations of a tile stay in
+ * L1 while the packed weights stream past them */
+#define NETWORKS_BATCH_TILE (16)
+
+#if NETWORKS_BATCH_THREADS > 1
+#include <pthread.h>
+#endif
+
 /* weight: reshape the original [row_num, column_num] matrix into
  * [row_num*column_num, 1] along columns */
 typedef struct NetwoksLayer {
@@ -31,6 +39,24 @@ typedef struct BpNetworks {
 
 static BpNetworks bp_networks;
 
+/* weights of foward_process_batch(), transposed to [row_num][column_num] in
+ * networks_init() so each input scales one contiguous weight row */
+typedef struct NetworksPack {
+    uint8_t ready;
+    double batch_normal_sd[NETWORKS_BATCHNORMAL1D_SIZE];
+    float linner_layer1_weight[NETWORKS_INPUT_SIZE * NETWORKS_LINNER1_SIZE];
+    float linner_layer2_weight[NETWORKS_LINNER1_SIZE * NETWORKS_LINNER2_SIZE];
+} NetworksPack;
+
+static NetworksPack networks_pack;
+
+/* activations of one tile, reused by every tile of a batch */
+typedef struct NetworksBatchBuffer {
+    float input[NETWORKS_BATCH_TILE][NETWORKS_INPUT_SIZE];
+    float hidden[NETWORKS_BATCH_TILE][NETWORKS_LINNER1_SIZE];
+    float output[NETWORKS_BATCH_TILE][NETWORKS_LINNER2_SIZE];
+} NetworksBatchBuffer;
+
 //* changed weight
 const float linner_layer1_weight[NETWORKS_INPUT_SIZE * NETWORKS_LINNER1_SIZE] = {
     -0.4825854629403204,   0.07449666251875195,    -0.5777879502629854,
@@ -939,6 +965,58 @@ const char *action_list[11] = {
     "jumping_squat", "jumping_jack", "jumping_lunge", "other", "sit",
 };
 
+#if ALG_FIXED_POINT
+/* Q-format copy of the layers, derived from the float tables in
+ * networks_init(); the input batch norm is folded into layer 1 */
+static int16_t linner_layer1_weight_q[NETWORKS_INPUT_SIZE *
+                                      NETWORKS_LINNER1_SIZE];
+static int64_t linner_layer1_bias_q[NETWORKS_LINNER1_SIZE];
+static int32_t linner_layer1_mult_q[NETWORKS_INPUT_SIZE];
+static int8_t linner_layer1_shift_q[NETWORKS_INPUT_SIZE];
+static int64_t linner_layer1_offset_q[NETWORKS_INPUT_SIZE];
+
+static int16_t linner_layer2_weight_q[NETWORKS_LINNER1_SIZE *
+                                      NETWORKS_LINNER2_SIZE];
+static int64_t linner_layer2_bias_q[NETWORKS_LINNER2_SIZE];
+static int32_t linner_layer2_mult_q[NETWORKS_LINNER1_SIZE];
+static int8_t linner_layer2_shift_q[NETWORKS_LINNER1_SIZE];
+static int64_t linner_layer2_offset_q[NETWORKS_LINNER1_SIZE];
+
+static LinearLayerQ linner_layer1_q = {
+    NETWORKS_INPUT_SIZE,   NETWORKS_LINNER1_SIZE, linner_layer1_weight_q,
+    linner_layer1_bias_q,  linner_layer1_mult_q,  linner_layer1_shift_q,
+    linner_layer1_offset_q
+};
+static LinearLayerQ linner_layer2_q = {
+    NETWORKS_LINNER1_SIZE, NETWORKS_LINNER2_SIZE, linner_layer2_weight_q,
+    linner_layer2_bias_q,  linner_layer2_mult_q,  linner_layer2_shift_q,
+    linner_layer2_offset_q
+};
+
+static int networks_init_q(void)
+{
+    double scale[NETWORKS_BATCHNORMAL1D_SIZE];
+    double offset[NETWORKS_BATCHNORMAL1D_SIZE];
+    uint16_t i = 0;
+    int ret;
+
+    for (i = 0; i < NETWORKS_BATCHNORMAL1D_SIZE; i++) {
+        scale[i]  = batch_normal_weight[i] /
+                   sqrt(batch_normal_running_var[i] + EPS);
+        offset[i] = batch_normal_bias[i] -
+                    batch_normal_running_mean[i] * scale[i];
+    }
+
+    ret = linear_q_build(&linner_layer1_q, linner_layer1_weight,
+                         linner_layer1_bias, scale, offset, NULL);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+    return linear_q_build(&linner_layer2_q, linner_layer2_weight,
+                          linner_layer2_bias, NULL, NULL, NULL);
+}
+#endif
+
 static int linear_calculation(NetwoksLayer *layer, LayerData *input_data,
                               LayerData *output_data)
 {
@@ -1013,6 +1091,8 @@ static int max_pool(LayerData *input_data, LayerData *output_data)
 
 int networks_init(void)
 {
+    uint16_t i = 0, j = 0;
+
     memset(&bp_networks, 0, sizeof(BpNetworks));
 
     bp_networks.linner_layer1.row_num    = NETWORKS_INPUT_SIZE;
@@ -1025,6 +1105,74 @@ int networks_init(void)
     bp_networks.linner_layer2.weight     = linner_layer2_weight;
     bp_networks.linner_layer2.bias       = linner_layer2_bias;
 
+    for (i = 0; i < NETWORKS_BATCHNORMAL1D_SIZE; i++) {
+        networks_pack.batch_normal_sd[i] =
+            sqrt(batch_normal_running_var[i] + EPS);
+    }
+    for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+        for (j = 0; j < NETWORKS_INPUT_SIZE; j++) {
+            networks_pack.linner_layer1_weight[j * NETWORKS_LINNER1_SIZE + i] =
+                linner_layer1_weight[i * NETWORKS_INPUT_SIZE + j];
+        }
+    }
+    for (i = 0; i < NETWORKS_LINNER2_SIZE; i++) {
+        for (j = 0; j < NETWORKS_LINNER1_SIZE; j++) {
+            networks_pack.linner_layer2_weight[j * NETWORKS_LINNER2_SIZE + i] =
+                linner_layer2_weight[i * NETWORKS_LINNER1_SIZE + j];
+        }
+    }
+    networks_pack.ready = 1;
+
+#if ALG_FIXED_POINT
+    return networks_init_q();
+#else
+    return NET_NORMAL;
+#endif
+}
+
+int networks_export_float(MlpFloat *net)
+{
+    static double weight1[NETWORKS_INPUT_SIZE * NETWORKS_LINNER1_SIZE];
+    static double bias1[NETWORKS_LINNER1_SIZE];
+    static double weight2[NETWORKS_LINNER1_SIZE * NETWORKS_LINNER2_SIZE];
+    static double bias2[NETWORKS_LINNER2_SIZE];
+    double scale = 0, offset = 0;
+    uint16_t i = 0, j = 0;
+
+    if (!net) {
+        return NET_ERR_GENERIC;
+    }
+
+    // w1' = w1 * scale, b1' = b1 + w1 . offset
+    for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+        bias1[i] = linner_layer1_bias[i];
+    }
+    for (j = 0; j < NETWORKS_INPUT_SIZE; j++) {
+        scale  = batch_normal_weight[j] /
+                sqrt(batch_normal_running_var[j] + EPS);
+        offset = batch_normal_bias[j] - batch_normal_running_mean[j] * scale;
+        for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+            weight1[i * NETWORKS_INPUT_SIZE + j] =
+                linner_layer1_weight[i * NETWORKS_INPUT_SIZE + j] * scale;
+            bias1[i] +=
+                linner_layer1_weight[i * NETWORKS_INPUT_SIZE + j] * offset;
+        }
+    }
+    for (i = 0; i < NETWORKS_LINNER1_SIZE * NETWORKS_LINNER2_SIZE; i++) {
+        weight2[i] = linner_layer2_weight[i];
+    }
+    for (i = 0; i < NETWORKS_LINNER2_SIZE; i++) {
+        bias2[i] = linner_layer2_bias[i];
+    }
+
+    net->input_size  = NETWORKS_INPUT_SIZE;
+    net->hidden_size = NETWORKS_LINNER1_SIZE;
+    net->output_size = NETWORKS_LINNER2_SIZE;
+    net->pool_size   = NETWORKS_POOL_SIZE;
+    net->weight1     = weight1;
+    net->bias1       = bias1;
+    net->weight2     = weight2;
+    net->bias2       = bias2;
     return NET_NORMAL;
 }
 
@@ -1079,7 +1227,7 @@ int foward_process(LayerData *input_data, int *class)
     linner_layer2_output.size = NETWORKS_LINNER2_SIZE;
     linner_layer2_output.data = linner_layer2_output_data;
 
-    float hidden_layer_output_data[NETWORKS_POOL_SIZE] = { 0.0f };
+    float hidden_layer_output_data[NETWORKS_CLASS_NUM] = { 0.0f };
 
     LayerData hidden_layer_output;
     hidden_layer_output.size = NETWORKS_CLASS_NUM;
@@ -1132,4 +1280,189 @@ int foward_process(LayerData *input_data, int *class)
     //        hidden_layer_output.data[1], hidden_layer_output.data[2],
     //        hidden_layer_output.data[3], hidden_layer_output.data[4]);
     return ret;
-}
\ No newline at end of file
+}
+
+/* batch_normal1d -> linner_layer1 -> relu -> linner_layer2 -> max_pool ->
+ * argmax for up to NETWORKS_BATCH_TILE rows as two small GEMMs. Every sum
+ * runs in the order of foward_process(), so the classes are identical. */
+static void foward_process_tile(const float *x, uint16_t rows,
+                                NetworksBatchBuffer *buf, int *classes)
+{
+    const float *weight = NULL;
+    float a = 0.0f, max = 0.0f;
+    uint16_t r = 0, i = 0, k = 0;
+    int best = 0;
+
+    for (r = 0; r < rows; r++) {
+        for (k = 0; k < NETWORKS_INPUT_SIZE; k++) {
+            buf->input[r][k] =
+                ((x[r * NETWORKS_INPUT_SIZE + k] -
+                  batch_normal_running_mean[k]) /
+                 networks_pack.batch_normal_sd[k]) *
+                    batch_normal_weight[k] +
+                batch_normal_bias[k];
+        }
+    }
+
+    memset(buf->hidden, 0, sizeof(buf->hidden[0]) * rows);
+    for (k = 0; k < NETWORKS_INPUT_SIZE; k++) {
+        weight = networks_pack.linner_layer1_weight + k * NETWORKS_LINNER1_SIZE;
+        for (r = 0; r < rows; r++) {
+            a = buf->input[r][k];
+            for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+                buf->hidden[r][i] += a * weight[i];
+            }
+        }
+    }
+    for (r = 0; r < rows; r++) {
+        for (i = 0; i < NETWORKS_LINNER1_SIZE; i++) {
+            a                 = buf->hidden[r][i] + linner_layer1_bias[i];
+            buf->hidden[r][i] = a < 0.0f ? 0.0f : a;
+        }
+    }
+
+    memset(buf->output, 0, sizeof(buf->output[0]) * rows);
+    for (k = 0; k < NETWORKS_LINNER1_SIZE; k++) {
+        weight = networks_pack.linner_layer2_weight + k * NETWORKS_LINNER2_SIZE;
+        for (r = 0; r < rows; r++) {
+            a = buf->hidden[r][k];
+            for (i = 0; i < NETWORKS_LINNER2_SIZE; i++) {
+                buf->output[r][i] += a * weight[i];
+            }
+        }
+    }
+
+    for (r = 0; r < rows; r++) {
+        float pool[NETWORKS_CLASS_NUM];
+        for (i = 0; i < NETWORKS_LINNER2_SIZE; i++) {
+            a = buf->output[r][i] + linner_layer2_bias[i];
+            if (i % NETWORKS_POOL_SIZE == 0) {
+                max = a;
+            }
+            max = a > max ? a : max;
+            if ((i + 1) % NETWORKS_POOL_SIZE == 0) {
+                pool[i / NETWORKS_POOL_SIZE] = max;
+            }
+        }
+        best = 0;
+        for (i = 1; i < NETWORKS_CLASS_NUM; i++) {
+            best = pool[i] > pool[best] ? i : best;
+        }
+        classes[r] = best;
+    }
+}
+
+static void foward_process_rows(const float *x, size_t n, int *classes)
+{
+    NetworksBatchBuffer buf;
+    size_t r    = 0;
+    size_t rows = 0;
+
+    for (r = 0; r < n; r += rows) {
+        rows = n - r < NETWORKS_BATCH_TILE ? n - r : NETWORKS_BATCH_TILE;
+        foward_process_tile(x + r * NETWORKS_INPUT_SIZE, (uint16_t)rows, &buf,
+                            classes + r);
+    }
+}
+
+#if NETWORKS_BATCH_THREADS > 1
+typedef struct NetworksBatchJob {
+    const float *x;
+    size_t n;
+    int *classes;
+} NetworksBatchJob;
+
+static void *foward_process_job(void *arg)
+{
+    NetworksBatchJob *job = arg;
+
+    foward_process_rows(job->x, job->n, job->classes);
+    return NULL;
+}
+#endif
+
+int foward_process_batch(const float *x, size_t n, int *classes)
+{
+#if NETWORKS_BATCH_THREADS > 1
+    pthread_t thread[NETWORKS_BATCH_THREADS];
+    NetworksBatchJob job[NETWORKS_BATCH_THREADS];
+    uint8_t started[NETWORKS_BATCH_THREADS] = { 0 };
+    size_t chunk = 0, begin = 0;
+    int t        = 0;
+#endif
+
+    if (!networks_pack.ready || (n != 0 && (!x || !classes))) {
+        return NET_ERR_GENERIC;
+    }
+    if (n == 0) {
+        return NET_NORMAL;
+    }
+
+#if NETWORKS_BATCH_THREADS > 1
+    // whole tiles per thread, a thread that cannot start runs inline
+    chunk = (n + NETWORKS_BATCH_THREADS - 1) / NETWORKS_BATCH_THREADS;
+    chunk = (chunk + NETWORKS_BATCH_TILE - 1) / NETWORKS_BATCH_TILE *
+            NETWORKS_BATCH_TILE;
+    for (t = 0; t < NETWORKS_BATCH_THREADS && begin < n; t++) {
+        job[t].x       = x + begin * NETWORKS_INPUT_SIZE;
+        job[t].n       = n - begin < chunk ? n - begin : chunk;
+        job[t].classes = classes + begin;
+        begin += job[t].n;
+        if (t > 0) {
+            started[t] =
+                pthread_create(&thread[t], NULL, foward_process_job, &job[t]) ==
+                0;
+        }
+    }
+    foward_process_job(&job[0]);
+    while (--t > 0) {
+        if (started[t]) {
+            pthread_join(thread[t], NULL);
+        } else {
+            foward_process_job(&job[t]);
+        }
+    }
+#else
+    foward_process_rows(x, n, classes);
+#endif
+    return NET_NORMAL;
+}
+
+#if ALG_FIXED_POINT
+int foward_process_q(const LayerDataQ *input_data, int *class)
+{
+    int32_t linner_layer1_output_data[NETWORKS_LINNER1_SIZE] = { 0 };
+    int32_t linner_layer2_output_data[NETWORKS_LINNER2_SIZE] = { 0 };
+    int32_t hidden_layer_output_data[NETWORKS_CLASS_NUM]     = { 0 };
+    LayerDataQ linner_layer1_output = { NETWORKS_LINNER1_SIZE, 0,
+                                        linner_layer1_output_data };
+    LayerDataQ linner_layer2_output = { NETWORKS_LINNER2_SIZE, 0,
+                                        linner_layer2_output_data };
+    LayerDataQ hidden_layer_output  = { NETWORKS_CLASS_NUM, 0,
+                                        hidden_layer_output_data };
+    int ret;
+
+    ret = linear_q_calculation(&linner_layer1_q, input_data,
+                               &linner_layer1_output);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+    ret = relu_q(&linner_layer1_output);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+    ret = linear_q_calculation(&linner_layer2_q, &linner_layer1_output,
+                               &linner_layer2_output);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+    ret = max_pool_q(&linner_layer2_output, NETWORKS_POOL_SIZE, INT32_MIN,
+                     &hidden_layer_output);
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+
+    *class = argmax_q(&hidden_layer_output);
+    return ret;
+}
+#endif
@@ -4,11 +4,14 @@
 // #define NET_ERR_GENERIC -1
 // #define NET_NORMAL 0
 
+#include <stddef.h>
 #include <stdint.h>
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "alg_mlp_fixed.h"
+#include "alg_mlp_int8.h"
 
 typedef enum ClassResult {
     CLASS_0 = 0,
@@ -30,4 +33,23 @@ int networks_init(void);
 /* input_data size should be 2 */
 int foward_process(LayerData *input_data, int *class);
 
+/* number of threads foward_process_batch() splits its rows over, > 1 needs
+ * pthreads */
+#ifndef NETWORKS_BATCH_THREADS
+#define NETWORKS_BATCH_THREADS (1)
+#endif
+
+/* classes[i] of the 20 features at x + 20 * i for i < n, the same classes
+ * as foward_process() without touching x */
+int foward_process_batch(const float *x, size_t n, int *classes);
+
+/* the network as Linear -> ReLU -> Linear with the input batch norm folded
+ * into layer 1, for quantization on the host */
+int networks_export_float(MlpFloat *net);
+
+#if ALG_FIXED_POINT
+/* input_data: the same 20 features as integers (Q frac) */
+int foward_process_q(const LayerDataQ *input_data, int *class);
+#endif
+
 #endif
@@ -0,0 +1,402 @@
+#include "alg_model_blob.h"
+#include <stddef.h>
+#include <string.h>
+
+#if MODEL_BLOB_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if MODEL_BLOB_VPI_STORAGE
+#include <stdbool.h>
+#include "vpi_error.h"
+#include "vpi_storage.h"
+#endif
+
+#define NET_NORMAL      0
+#define NET_ERR_GENERIC -1
+
+static const uint8_t dtype_size[] = { 4, 2, 1 };
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+    uint32_t i = 0;
+    int k      = 0;
+
+    crc = ~crc;
+    for (i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+/* a tensor of len bytes at off lies after the layer table, aligned */
+static int tensor_check(const ModelBlob *model, uint32_t off, uint32_t len)
+{
+    uint32_t start = sizeof(ModelBlobHeader) +
+                     model->header.layer_num * sizeof(ModelBlobLayer);
+
+    if (off % MODEL_BLOB_ALIGN != 0 || off < start ||
+        off > model->header.size || len > model->header.size - off) {
+        return NET_ERR_GENERIC;
+    }
+    return NET_NORMAL;
+}
+
+static int layer_check(const ModelBlob *model, const ModelBlobLayer *layer)
+{
+    uint32_t n = layer->out_size;
+
+    if (layer->in_size == 0 || layer->in_size > MODEL_BLOB_MAX_SIZE ||
+        n == 0 || n > MODEL_BLOB_MAX_SIZE) {
+        return NET_ERR_GENERIC;
+    }
+
+    switch (layer->type) {
+    case MODEL_LAYER_LINEAR:
+        if (layer->dtype > MODEL_DTYPE_INT8 ||
+            tensor_check(model, layer->weight,
+                         layer->in_size * n * dtype_size[layer->dtype]) !=
+                NET_NORMAL ||
+            tensor_check(model, layer->bias, n * sizeof(float)) !=
+                NET_NORMAL) {
+            return NET_ERR_GENERIC;
+        }
+        if (layer->dtype == MODEL_DTYPE_INT8) {
+            return tensor_check(model, layer->scale, n * sizeof(float));
+        }
+        return NET_NORMAL;
+    case MODEL_LAYER_AFFINE:
+        if (layer->in_size != n ||
+            tensor_check(model, layer->scale, n * sizeof(float)) !=
+                NET_NORMAL) {
+            return NET_ERR_GENERIC;
+        }
+        return tensor_check(model, layer->bias, n * sizeof(float));
+    case MODEL_LAYER_RELU:
+        return layer->in_size == n ? NET_NORMAL : NET_ERR_GENERIC;
+    case MODEL_LAYER_MAXPOOL:
+        if (layer->param == 0 || layer->in_size % layer->param != 0 ||
+            layer->in_size / layer->param != n) {
+            return NET_ERR_GENERIC;
+        }
+        return NET_NORMAL;
+    default:
+        return NET_ERR_GENERIC;
+    }
+}
+
+/* header and layer table are in model, the tensors are not read here */
+static int blob_check(const ModelBlob *model)
+{
+    const ModelBlobHeader *header = &model->header;
+    uint16_t size = header->input_size;
+    uint16_t i    = 0;
+
+    if (header->magic != MODEL_BLOB_MAGIC ||
+        header->version != MODEL_BLOB_VERSION || header->layer_num == 0 ||
+        header->layer_num > MODEL_BLOB_MAX_LAYER ||
+        header->size < sizeof(ModelBlobHeader) +
+                           header->layer_num * sizeof(ModelBlobLayer)) {
+        return NET_ERR_GENERIC;
+    }
+    for (i = 0; i < header->layer_num; i++) {
+        if (model->layer[i].in_size != size ||
+            layer_check(model, &model->layer[i]) != NET_NORMAL) {
+            return NET_ERR_GENERIC;
+        }
+        size = model->layer[i].out_size;
+    }
+    return size == header->output_size ? NET_NORMAL : NET_ERR_GENERIC;
+}
+
+int model_blob_open(ModelBlob *model, const void *data, uint32_t size)
+{
+    const uint8_t *base = data;
+
+    if (!model || !data || ((uintptr_t)data % MODEL_BLOB_ALIGN) != 0 ||
+        size < sizeof(ModelBlobHeader)) {
+        return NET_ERR_GENERIC;
+    }
+    memset(model, 0, sizeof(ModelBlob));
+    memcpy(&model->header, base, sizeof(ModelBlobHeader));
+    if (model->header.size > size ||
+        model->header.layer_num > MODEL_BLOB_MAX_LAYER ||
+        model->header.size < sizeof(ModelBlobHeader) +
+                                 model->header.layer_num *
+                                     sizeof(ModelBlobLayer)) {
+        return NET_ERR_GENERIC;
+    }
+    memcpy(model->layer, base + sizeof(ModelBlobHeader),
+           model->header.layer_num * sizeof(ModelBlobLayer));
+    if (blob_check(model) != NET_NORMAL ||
+        crc32_update(0, base + sizeof(ModelBlobHeader),
+                     model->header.size - sizeof(ModelBlobHeader)) !=
+            model->header.crc) {
+        return NET_ERR_GENERIC;
+    }
+
+    model->base = base;
+    return NET_NORMAL;
+}
+
+int model_blob_open_read(ModelBlob *model, ModelBlobRead read, void *ctx)
+{
+    uint8_t buf[256];
+    uint32_t off = sizeof(ModelBlobHeader), len = 0, crc = 0;
+
+    if (!model || !read) {
+        return NET_ERR_GENERIC;
+    }
+    memset(model, 0, sizeof(ModelBlob));
+    if (read(ctx, 0, &model->header, sizeof(ModelBlobHeader)) != 0 ||
+        model->header.layer_num > MODEL_BLOB_MAX_LAYER ||
+        read(ctx, sizeof(ModelBlobHeader), model->layer,
+             model->header.layer_num * sizeof(ModelBlobLayer)) != 0 ||
+        blob_check(model) != NET_NORMAL) {
+        return NET_ERR_GENERIC;
+    }
+
+    // the whole blob passes through buf once for the crc
+    for (off = sizeof(ModelBlobHeader); off < model->header.size; off += len) {
+        len = model->header.size - off;
+        len = len > sizeof(buf) ? sizeof(buf) : len;
+        if (read(ctx, off, buf, len) != 0) {
+            return NET_ERR_GENERIC;
+        }
+        crc = crc32_update(crc, buf, len);
+    }
+    if (crc != model->header.crc) {
+        return NET_ERR_GENERIC;
+    }
+
+    model->read     = read;
+    model->read_ctx = ctx;
+    return NET_NORMAL;
+}
+
+/* the tensor in place, or read into buf when the blob is streamed */
+static const void *blob_tensor(const ModelBlob *model, uint32_t off,
+                               void *buf, uint32_t size)
+{
+    if (model->base) {
+        return model->base + off;
+    }
+    if (model->read(model->read_ctx, off, buf, size) != 0) {
+        return NULL;
+    }
+    return buf;
+}
+
+static float half_to_float(uint16_t h)
+{
+    union {
+        uint32_t u;
+        float f;
+    } v;
+    uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    uint32_t exp  = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+
+    if (exp == 0) {
+        // zero and subnormals are mant * 2^-24
+        v.f = (float)mant * (1.0f / 16777216.0f);
+        v.u |= sign;
+    } else if (exp == 0x1f) {
+        v.u = sign | 0x7f800000u | (mant << 13);
+    } else {
+        v.u = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    return v.f;
+}
+
+static int linear_calculation(const ModelBlob *model,
+                              const ModelBlobLayer *layer, const float *input,
+                              float *output)
+{
+    float row_buf[MODEL_BLOB_MAX_SIZE];
+    float bias_buf[MODEL_BLOB_MAX_SIZE];
+    float scale_buf[MODEL_BLOB_MAX_SIZE];
+    uint32_t row_size  = layer->in_size * dtype_size[layer->dtype];
+    const float *bias  = NULL;
+    const float *scale = NULL;
+    const void *row    = NULL;
+    float tmp_sum      = 0.0f;
+    uint16_t i = 0, j = 0;
+
+    bias = blob_tensor(model, layer->bias, bias_buf,
+                       layer->out_size * sizeof(float));
+    if (layer->dtype == MODEL_DTYPE_INT8) {
+        scale = blob_tensor(model, layer->scale, scale_buf,
+                            layer->out_size * sizeof(float));
+        if (!scale) {
+            return NET_ERR_GENERIC;
+        }
+    }
+    if (!bias) {
+        return NET_ERR_GENERIC;
+    }
+
+    for (i = 0; i < layer->out_size; i++) {
+        row = blob_tensor(model, layer->weight + i * row_size, row_buf,
+                          row_size);
+        if (!row) {
+            return NET_ERR_GENERIC;
+        }
+        tmp_sum = 0.0f;
+        switch (layer->dtype) {
+        case MODEL_DTYPE_FP32:
+            for (j = 0; j < layer->in_size; j++) {
+                tmp_sum += input[j] * ((const float *)row)[j];
+            }
+            break;
+        case MODEL_DTYPE_FP16:
+            for (j = 0; j < layer->in_size; j++) {
+                tmp_sum += input[j] * half_to_float(((const uint16_t *)row)[j]);
+            }
+            break;
+        default:
+            for (j = 0; j < layer->in_size; j++) {
+                tmp_sum += input[j] * ((const int8_t *)row)[j];
+            }
+            tmp_sum *= scale[i];
+            break;
+        }
+        output[i] = tmp_sum + bias[i];
+    }
+    return NET_NORMAL;
+}
+
+static int affine_calculation(const ModelBlob *model,
+                              const ModelBlobLayer *layer, float *data)
+{
+    float bias_buf[MODEL_BLOB_MAX_SIZE];
+    float scale_buf[MODEL_BLOB_MAX_SIZE];
+    const float *bias  = blob_tensor(model, layer->bias, bias_buf,
+                                     layer->out_size * sizeof(float));
+    const float *scale = blob_tensor(model, layer->scale, scale_buf,
+                                     layer->out_size * sizeof(float));
+    uint16_t i = 0;
+
+    if (!bias || !scale) {
+        return NET_ERR_GENERIC;
+    }
+    for (i = 0; i < layer->out_size; i++) {
+        data[i] = data[i] * scale[i] + bias[i];
+    }
+    return NET_NORMAL;
+}
+
+int model_blob_forward(const ModelBlob *model, const float *input, int *class)
+{
+    float buf[2][MODEL_BLOB_MAX_SIZE];
+    const ModelBlobLayer *layer = NULL;
+    float *data = buf[0], *next = buf[1], *tmp = NULL;
+    uint16_t i = 0, j = 0, k = 0;
+    int ret    = NET_NORMAL;
+
+    if (!model || (!model->base && !model->read) || !input || !class) {
+        return NET_ERR_GENERIC;
+    }
+    memcpy(data, input, model->header.input_size * sizeof(float));
+
+    for (i = 0; i < model->header.layer_num && ret == NET_NORMAL; i++) {
+        layer = &model->layer[i];
+        switch (layer->type) {
+        case MODEL_LAYER_LINEAR:
+            ret  = linear_calculation(model, layer, data, next);
+            tmp  = data;
+            data = next;
+            next = tmp;
+            break;
+        case MODEL_LAYER_AFFINE:
+            ret = affine_calculation(model, layer, data);
+            break;
+        case MODEL_LAYER_RELU:
+            for (j = 0; j < layer->out_size; j++) {
+                data[j] = data[j] < 0.0f ? 0.0f : data[j];
+            }
+            break;
+        default:
+            // in place, group j only reads entries at or after j
+            for (j = 0; j < layer->out_size; j++) {
+                float max = data[j * layer->param];
+                for (k = 1; k < layer->param; k++) {
+                    float value = data[j * layer->param + k];
+                    max         = value > max ? value : max;
+                }
+                data[j] = max;
+            }
+            break;
+        }
+    }
+    if (ret != NET_NORMAL) {
+        return ret;
+    }
+
+    *class = 0;
+    for (j = 1; j < model->header.output_size; j++) {
+        if (data[j] > data[*class]) {
+            *class = j;
+        }
+    }
+    return NET_NORMAL;
+}
+
+#if MODEL_BLOB_MMAP
+int model_blob_map(ModelBlob *model, const char *path)
+{
+    struct stat st;
+    void *data = MAP_FAILED;
+    int fd     = -1;
+
+    if (!model || !path) {
+        return NET_ERR_GENERIC;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NET_ERR_GENERIC;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= UINT32_MAX) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NET_ERR_GENERIC;
+    }
+
+    if (model_blob_open(model, data, (uint32_t)st.st_size) != NET_NORMAL) {
+        munmap(data, (size_t)st.st_size);
+        return NET_ERR_GENERIC;
+    }
+    model->map_size = (uint32_t)st.st_size;
+    return NET_NORMAL;
+}
+
+void model_blob_unmap(ModelBlob *model)
+{
+    if (model && model->base && model->map_size) {
+        munmap((void *)model->base, model->map_size);
+        model->base     = NULL;
+        model->map_size = 0;
+    }
+}
+#endif
+
+#if MODEL_BLOB_VPI_STORAGE
+int model_blob_storage_read(void *ctx, uint32_t off, void *buf, uint32_t size)
+{
+    const ModelBlobPartition *part = ctx;
+
+    if (!part || vpi_storage_read(part->part_no, part->offset + off, size,
+                                  buf, false) != VPI_SUCCESS) {
+        return NET_ERR_GENERIC;
+    }
+    return NET_NORMAL;
+}
+#endif
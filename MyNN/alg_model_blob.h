@@ -0,0 +1,141 @@
+#ifndef __MODEL_BLOB_H_
+#define __MODEL_BLOB_H_
+
+#include <stdint.h>
+
+/* A model blob is a little endian image of a feed-forward classifier:
+ *
+ *   ModelBlobHeader | ModelBlobLayer[layer_num] | tensors
+ *
+ * Every tensor starts on a MODEL_BLOB_ALIGN boundary and is addressed by its
+ * offset from the start of the blob, so the same image works from an mmap
+ * of a file, an XIP flash window or a plain read callback. The class is the
+ * argmax of the last layer output. MyNN/pth_to_blob.py writes them. */
+
+#define MODEL_BLOB_MAGIC     (0x424D4353u) /* "SCMB" */
+#define MODEL_BLOB_VERSION   (1)
+#define MODEL_BLOB_ALIGN     (16)
+#define MODEL_BLOB_MAX_LAYER (16)
+#define MODEL_BLOB_MAX_SIZE  (64) /* widest layer input or output */
+
+/* 1 adds model_blob_map() for hosts with mmap */
+#ifndef MODEL_BLOB_MMAP
+#if defined(__unix__) || defined(__APPLE__)
+#define MODEL_BLOB_MMAP (1)
+#else
+#define MODEL_BLOB_MMAP (0)
+#endif
+#endif
+
+/* 1 adds model_blob_storage_read() on top of vpi_storage_read() */
+#ifndef MODEL_BLOB_VPI_STORAGE
+#define MODEL_BLOB_VPI_STORAGE (0)
+#endif
+
+/* tensors of a layer, n = out_size:
+ * LINEAR : weight[n][in_size] of dtype, bias float[n], and for INT8 one
+ *          float scale per output row (w = weight * scale)
+ * AFFINE : y = x * scale + bias, float scale[n] and bias[n], an inference
+ *          time batch norm
+ * RELU   : no tensors
+ * MAXPOOL: max over consecutive groups of param, n = in_size / param */
+typedef enum ModelLayerType {
+    MODEL_LAYER_LINEAR = 1,
+    MODEL_LAYER_AFFINE,
+    MODEL_LAYER_RELU,
+    MODEL_LAYER_MAXPOOL,
+} ModelLayerType;
+
+typedef enum ModelDtype {
+    MODEL_DTYPE_FP32 = 0,
+    MODEL_DTYPE_FP16,
+    MODEL_DTYPE_INT8,
+} ModelDtype;
+
+typedef struct ModelBlobHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t layer_num;
+    uint16_t input_size;
+    uint16_t output_size; /* scores the argmax runs over */
+    uint32_t size;        /* whole blob in bytes */
+    uint32_t crc;         /* crc32 of the bytes after the header */
+    uint32_t reserved[3];
+} ModelBlobHeader;
+
+typedef struct ModelBlobLayer {
+    uint8_t type;   /* ModelLayerType */
+    uint8_t dtype;  /* ModelDtype of a LINEAR weight */
+    uint16_t param; /* MAXPOOL kernel */
+    uint16_t in_size;
+    uint16_t out_size;
+    uint32_t weight; /* tensor offsets, 0 when unused */
+    uint32_t bias;
+    uint32_t scale;
+    uint32_t reserved[3];
+} ModelBlobLayer;
+
+/**
+ * @brief reads size bytes at offset off of the blob into buf
+ * @return 0 on success
+ */
+typedef int (*ModelBlobRead)(void *ctx, uint32_t off, void *buf,
+                             uint32_t size);
+
+/* base is set for blobs that are addressable in place, otherwise tensors are
+ * streamed through read one row at a time */
+typedef struct ModelBlob {
+    const uint8_t *base;
+    ModelBlobRead read;
+    void *read_ctx;
+    uint32_t map_size;
+    ModelBlobHeader header;
+    ModelBlobLayer layer[MODEL_BLOB_MAX_LAYER];
+} ModelBlob;
+
+/**
+ * @brief use a blob that is addressable in place, nothing is copied
+ * @param data: the blob, MODEL_BLOB_ALIGN aligned
+ * @param size: bytes available at data
+ * @return 0 on success, -1 on a malformed blob
+ */
+int model_blob_open(ModelBlob *model, const void *data, uint32_t size);
+
+/**
+ * @brief use a blob behind a read callback, e.g. a flash partition. Only the
+ * header and layer table are kept in RAM.
+ * @return 0 on success, -1 on a read error or a malformed blob
+ */
+int model_blob_open_read(ModelBlob *model, ModelBlobRead read, void *ctx);
+
+/**
+ * @brief run the model
+ * @param input: header.input_size features
+ * @param class: argmax of the last layer
+ */
+int model_blob_forward(const ModelBlob *model, const float *input, int *class);
+
+#if MODEL_BLOB_MMAP
+/**
+ * @brief mmap a blob file read only and open it
+ */
+int model_blob_map(ModelBlob *model, const char *path);
+
+void model_blob_unmap(ModelBlob *model);
+#endif
+
+#if MODEL_BLOB_VPI_STORAGE
+/* where a blob sits in flash */
+typedef struct ModelBlobPartition {
+    int8_t part_no;
+    uint32_t offset;
+} ModelBlobPartition;
+
+/**
+ * @brief ModelBlobRead over vpi_storage_read(), ctx is a ModelBlobPartition
+ */
+int model_blob_storage_read(void *ctx, uint32_t off, void *buf,
+                            uint32_t size);
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+/* Float vs Q-format comparison of the classifier on feature.csv/label.csv.
+ * build: make fixed_point_eval (needs ALG_FIXED_POINT=1)
+ * usage: fixed_point_eval [feature.csv] [label.csv] */
+#include <stdio.h>
+#include <time.h>
+#include "alg_mlp_networks.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define MAX_WINDOWS (4000)
+#define FEATURE_NUM (20)
+
+static float feature[MAX_WINDOWS][FEATURE_NUM];
+static int label[MAX_WINDOWS];
+
+/* cycle counter where there is one, nanoseconds otherwise */
+static uint64_t read_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static int load_csv(const char *feature_path, const char *label_path)
+{
+    char str[512];
+    int num = 0, label_num = 0;
+
+    FILE *fp = fopen(label_path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", label_path);
+        return -1;
+    }
+    while (label_num < MAX_WINDOWS && fgets(str, sizeof(str), fp) != NULL) {
+        label[label_num++] = atoi(str);
+    }
+    fclose(fp);
+
+    fp = fopen(feature_path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", feature_path);
+        return -1;
+    }
+    while (num < label_num && fgets(str, sizeof(str), fp) != NULL) {
+        float *data = feature[num];
+        char *cursor = str;
+        int i = 0;
+        for (i = 0; i < FEATURE_NUM; i++) {
+            data[i] = strtof(cursor, &cursor);
+            if (*cursor == ',') {
+                cursor++;
+            }
+        }
+        num++;
+    }
+    fclose(fp);
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    const char *feature_path = argc > 1 ? argv[1] : "feature.csv";
+    const char *label_path   = argc > 2 ? argv[2] : "label.csv";
+    float data[FEATURE_NUM];
+    int32_t data_q[FEATURE_NUM];
+    LayerData input_data     = { FEATURE_NUM, data };
+    LayerDataQ input_data_q  = { FEATURE_NUM, 0, data_q };
+    uint64_t float_cycles = 0, fixed_cycles = 0, start = 0;
+    int float_hit = 0, fixed_hit = 0, agree = 0;
+    int res = 0, res_q = 0, num = 0, i = 0, j = 0;
+
+    num = load_csv(feature_path, label_path);
+    if (num <= 0) {
+        return 1;
+    }
+    if (networks_init() != 0) {
+        printf("networks_init failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < num; i++) {
+        /* the fixed point extractor produces truncated integer features */
+        for (j = 0; j < FEATURE_NUM; j++) {
+            data[j]   = feature[i][j];
+            data_q[j] = (int32_t)feature[i][j];
+        }
+
+        start = read_cycles();
+        foward_process(&input_data, &res);
+        float_cycles += read_cycles() - start;
+
+        start = read_cycles();
+        foward_process_q(&input_data_q, &res_q);
+        fixed_cycles += read_cycles() - start;
+
+        float_hit += res == label[i];
+        fixed_hit += res_q == label[i];
+        agree += res == res_q;
+    }
+
+    printf("windows:%d\n", num);
+    printf("float  accuracy:%f cycles/window:%.1f\n", (float)float_hit / num,
+           (double)float_cycles / num);
+    printf("fixed  accuracy:%f cycles/window:%.1f\n", (float)fixed_hit / num,
+           (double)fixed_cycles / num);
+    printf("agreement:%f (%d/%d)\n", (float)agree / num, agree, num);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/* Calibrates the int8 classifier on feature.csv and compares it with the
+ * float one on label.csv.
+ * build: make int8_calibrate
+ * usage: int8_calibrate [feature.csv] [label.csv] [out.c]
+ * out.c receives the int8 tables as "const MlpI8 networks_i8" */
+#include <stdio.h>
+#include <time.h>
+#include "alg_mlp_networks.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define MAX_WINDOWS (4000)
+#define FEATURE_NUM (20)
+
+static float feature[MAX_WINDOWS][FEATURE_NUM];
+static int label[MAX_WINDOWS];
+
+/* cycle counter where there is one, nanoseconds otherwise */
+static uint64_t read_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static int load_csv(const char *feature_path, const char *label_path)
+{
+    char str[512];
+    int num = 0, label_num = 0;
+
+    FILE *fp = fopen(label_path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", label_path);
+        return -1;
+    }
+    while (label_num < MAX_WINDOWS && fgets(str, sizeof(str), fp) != NULL) {
+        label[label_num++] = atoi(str);
+    }
+    fclose(fp);
+
+    fp = fopen(feature_path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", feature_path);
+        return -1;
+    }
+    while (num < label_num && fgets(str, sizeof(str), fp) != NULL) {
+        float *data = feature[num];
+        char *cursor = str;
+        int i = 0;
+        for (i = 0; i < FEATURE_NUM; i++) {
+            data[i] = strtof(cursor, &cursor);
+            if (*cursor == ',') {
+                cursor++;
+            }
+        }
+        num++;
+    }
+    fclose(fp);
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    const char *feature_path = argc > 1 ? argv[1] : "feature.csv";
+    const char *label_path   = argc > 2 ? argv[2] : "label.csv";
+    const char *out_path     = argc > 3 ? argv[3] : NULL;
+    static MlpI8Storage storage;
+    MlpFloat net;
+    MlpI8 net_i8;
+    double in_max[FEATURE_NUM] = { 0 };
+    double hidden[INT8_MAX_LAYER_SIZE];
+    double hidden_max = 0;
+    float data[FEATURE_NUM];
+    LayerData input_data = { FEATURE_NUM, data };
+    uint64_t float_cycles = 0, int8_cycles = 0, start = 0;
+    int float_hit = 0, int8_hit = 0, agree = 0;
+    int res = 0, res_i8 = 0, num = 0, i = 0, j = 0;
+    FILE *fp = NULL;
+
+    num = load_csv(feature_path, label_path);
+    if (num <= 0) {
+        return 1;
+    }
+    if (networks_init() != 0 || networks_export_float(&net) != 0) {
+        printf("networks_init failed\n");
+        return 1;
+    }
+
+    /* symmetric ranges: the largest input and ReLU output seen */
+    for (i = 0; i < num; i++) {
+        for (j = 0; j < FEATURE_NUM; j++) {
+            double v  = fabs(feature[i][j]);
+            in_max[j] = v > in_max[j] ? v : in_max[j];
+        }
+        mlp_float_forward(&net, feature[i], hidden);
+        for (j = 0; j < net.hidden_size; j++) {
+            hidden_max = hidden[j] > hidden_max ? hidden[j] : hidden_max;
+        }
+    }
+    if (mlp_i8_build(&net, in_max, hidden_max, &storage, &net_i8) != 0) {
+        printf("mlp_i8_build failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < num; i++) {
+        /* foward_process() normalizes its input in place */
+        for (j = 0; j < FEATURE_NUM; j++) {
+            data[j] = feature[i][j];
+        }
+
+        start = read_cycles();
+        foward_process(&input_data, &res);
+        float_cycles += read_cycles() - start;
+
+        start = read_cycles();
+        mlp_i8_forward(&net_i8, feature[i], &res_i8);
+        int8_cycles += read_cycles() - start;
+
+        float_hit += res == label[i];
+        int8_hit += res_i8 == label[i];
+        agree += res == res_i8;
+    }
+
+    printf("windows:%d hidden_max:%g\n", num, hidden_max);
+    printf("float  accuracy:%f cycles/window:%.1f weight bytes:%u\n",
+           (float)float_hit / num, (double)float_cycles / num,
+           (unsigned)((net.input_size + 1) * net.hidden_size +
+                      (net.hidden_size + 1) * net.output_size) *
+               (unsigned)sizeof(float));
+    printf("int8   accuracy:%f cycles/window:%.1f weight bytes:%u\n",
+           (float)int8_hit / num, (double)int8_cycles / num,
+           (unsigned)(net.input_size * net.hidden_size +
+                      net.hidden_size * net.output_size +
+                      (net.hidden_size + net.output_size) *
+                          (2 * sizeof(int32_t) + 1) +
+                      net.input_size * sizeof(float)));
+    printf("agreement:%f (%d/%d)\n", (float)agree / num, agree, num);
+
+    if (out_path) {
+        fp = fopen(out_path, "w");
+        if (!fp || mlp_i8_export(&net_i8, "networks_i8", fp) != 0) {
+            printf("cannot write %s\n", out_path);
+            return 1;
+        }
+        fclose(fp);
+        printf("wrote %s\n", out_path);
+    }
+    return 0;
+}
@@ -1,102 +1,386 @@
+/* Accuracy of the 5-class classifier on feature.csv/label.csv, with the
+ * per class precision/recall and the confusion matrix.
+ * build: make mlp_eval
+ * usage: mlp_eval [-j threads] [-f feature.csv] [-l label.csv]
+ *
+ * Both files are mapped and parsed in one pass into one contiguous feature
+ * matrix, so their size is bounded by memory only. The rows are scored in
+ * tasks of EVAL_TASK_ROWS through foward_process_batch() on the threads of
+ * alg_task_pool. */
+#include <float.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "alg_mlp_networks.h"
-// float data[21];
-int label[4000];
+#include "alg_task_pool.h"
 
-int main()
+#define FEATURE_NUM    (20)
+#define CLASS_NUM      (CLASS_4 + 1)
+#define EVAL_TASK_ROWS (4096) /* rows per foward_process_batch() call */
+#define EVAL_TOKEN_MAX (64)   /* bytes of a number for the strtof() path */
+
+/* a mapped input file, text is NULL for an empty one */
+typedef struct EvalFile {
+    const char *text;
+    size_t size;
+} EvalFile;
+
+typedef struct EvalSet {
+    float *feature; /* num x FEATURE_NUM */
+    int *label;
+    int *pred;
+    size_t num;
+} EvalSet;
+
+/* exact powers of ten in a double */
+static const double pow10_exact[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static uint64_t read_ns(void)
 {
-    uint16_t size = 20;
-    LayerData input_data;
-    int res, num = 0, cnt = 0;
-
-    FILE *fp = fopen("label.csv", "r");
-    char str[201];
-    while (fgets(str, 200, fp) != NULL) {
-        label[num] = atoi(str);
-        num++;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int file_map(EvalFile *file, const char *path)
+{
+    struct stat st;
+    void *text = NULL;
+    int fd     = open(path, O_RDONLY);
+
+    file->text = NULL;
+    file->size = 0;
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < 0 ||
+        (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return -1;
     }
-    fclose(fp);
-
-    networks_init();
-
-    FILE *fp2 = fopen("feature.csv", "r");
-    num       = 0;
-    while (fgets(str, 200, fp2) != NULL) {
-        float data[20];
-        int num_read =
-            sscanf(str,
-                   "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%"
-                   "f",
-                   &data[0], &data[1], &data[2], &data[3], &data[4], &data[5],
-                   &data[6], &data[7], &data[8], &data[9], &data[10],
-                   &data[11], &data[12], &data[13], &data[14], &data[15],
-                   &data[16], &data[17], &data[18], &data[19]);
-        input_data.data = data;
-        input_data.size = size;
-        // for (int i = 0; i < size; i++) {
-        //     printf("%f ", input_data.data[i]);
-        // }
-        // printf("\n %d \n",size);
-
-        foward_process(&input_data, &res);
-
-        // printf("pred:%d, label:%d\n", res, label[num]);
-        if (res == label[num])
-            cnt++;
+    if (st.st_size > 0) {
+        text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(text, (size_t)st.st_size, MADV_SEQUENTIAL);
+        file->text = text;
+        file->size = (size_t)st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+static void file_unmap(EvalFile *file)
+{
+    if (file->text) {
+        munmap((void *)file->text, file->size);
+    }
+}
 
+/* lines of text, counting a last one without '\n' */
+static size_t line_num(const EvalFile *file)
+{
+    const char *p = file->text, *end = file->text + file->size;
+    size_t num    = 0;
+
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
         num++;
+        p++;
     }
-    printf("accuracy:%f", (float)cnt / num);
-    fclose(fp2);
-
-    /*** strtok_s函数读取csv文件存在问题，会丢失数据 ***/
-
-    // FILE *fp = fopen("label.csv", "r");
-    // char str[101];
-    // while (fgets(str, 100, fp) != NULL) {
-    //     label[num] = atoi(str);
-    //     num++;
-    // }
-    // fclose(fp);
-
-    // networks_init();
-
-    // FILE *fp2 = fopen("feature.csv", "r");
-    // num       = 0;
-    // while (fgets(str, 100, fp2) != NULL) {
-    //     char *save_ptr;
-    //     data[0] = atof(strtok_s(str, ",", &save_ptr));
-    //     printf("%f ",data[0]);
-    //     for (int i = 1; i < 20; i++) {
-    //         data[i] = atof(strtok_s(NULL, ",", &save_ptr));
-    //         printf("%f ",data[i]);
-    //     }
-    //     // printf("%f,%f,", data[0], data[1]);
-    //     input_data.data = data;
-    //     input_data.size = size;
-
-    //     foward_process(&input_data, &res);
-
-    //     printf("pred:%d, label:%d\n", res, label[num]);
-    //     if (res == label[num])
-    //         cnt++;
-    //     num++;
-    // }
-    // printf("accuracy:%f", (float)cnt / num);
-    // fclose(fp2);
-
-    /*** 单个测试 ***/
-
-    // networks_init();
-
-    // float input[30] = { 155023.3425, 174359.7802, 1897872.179, 404364.7055,
-    //                     563529.0166, 254092.2954, 858075.2719, 1.0,
-    //                     1.0,         1.0,         1151436.627, 6479623.688,
-    //                     1751098.447, 1726270.579, 3319715.195, 3177914.259,
-    //                     1662349.201, 2.0,         1.0,         1.0 };
-    // input_data.data = input;
-    // input_data.size = 20;
-    // foward_process(&input_data, &res);
-    // printf("pred:%d\n", res);
-    return 0;
+    return num + (file->size > 0 && file->text[file->size - 1] != '\n');
+}
+
+// the same float as strtof(), slow only for more than 15 significant
+// digits, huge exponents or a double landing halfway between two floats
+static const char *scan_float(const char *p, const char *end, float *value)
+{
+    const char *start = p;
+    char token[EVAL_TOKEN_MAX + 1];
+    uint64_t mant = 0, bits = 0;
+    int digits = 0, exp10 = 0, e = 0, neg = 0, eneg = 0, any = 0;
+    double d = 0.0;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p++ == '-';
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = 1) {
+        if (digits < 19) {
+            mant = mant * 10 + (uint64_t)(*p - '0');
+            digits += mant != 0;
+        } else {
+            exp10++;
+            digits++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = 1) {
+            if (digits < 19) {
+                mant = mant * 10 + (uint64_t)(*p - '0');
+                digits += mant != 0;
+                exp10--;
+            }
+        }
+    }
+    if (!any) {
+        return NULL;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) {
+            eneg = *p++ == '-';
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            return NULL;
+        }
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        }
+        exp10 += eneg ? -e : e;
+    }
+
+    if (digits <= 15 && exp10 >= -22 && exp10 <= 22) {
+        d = (double)mant;
+        d = exp10 < 0 ? d / pow10_exact[-exp10] : d * pow10_exact[exp10];
+        memcpy(&bits, &d, sizeof(bits));
+        if (d == 0.0 || (d >= FLT_MIN && d <= FLT_MAX &&
+                         (bits & 0x1fffffffu) != 0x10000000u)) {
+            *value = neg ? -(float)d : (float)d;
+            return p;
+        }
+    }
+    if (p - start > EVAL_TOKEN_MAX) {
+        return NULL;
+    }
+    memcpy(token, start, (size_t)(p - start));
+    token[p - start] = '\0';
+    *value           = strtof(token, NULL);
+    return p;
+}
+
+/* p at the end of a line: "\r\n", "\n" or the end, the next line or NULL */
+static const char *scan_eol(const char *p, const char *end)
+{
+    if (p < end && *p == '\r') {
+        p++;
+    }
+    if (p == end) {
+        return p;
+    }
+    return *p == '\n' ? p + 1 : NULL;
+}
+
+static int load_features(EvalSet *set, const char *path)
+{
+    EvalFile file;
+    const char *p = NULL, *end = NULL, *next = NULL;
+    size_t cap = 0, line = 0;
+    float *row = NULL;
+    int i = 0, ret = 0;
+
+    if (file_map(&file, path) != 0) {
+        printf("cannot open %s\n", path);
+        return -1;
+    }
+    cap          = line_num(&file);
+    set->num     = 0;
+    set->feature = malloc((cap > 0 ? cap : 1) * FEATURE_NUM * sizeof(float));
+    if (!set->feature) {
+        file_unmap(&file);
+        return -1;
+    }
+    p   = file.text;
+    end = file.text + file.size;
+    for (line = 1; p < end && ret == 0; line++, p = next) {
+        if ((next = scan_eol(p, end)) != NULL) {
+            continue; // blank line
+        }
+        row = set->feature + set->num * FEATURE_NUM;
+        for (i = 0; i < FEATURE_NUM && p; i++) {
+            if (i > 0) {
+                p = p < end && *p == ',' ? p + 1 : NULL;
+            }
+            p = p ? scan_float(p, end, &row[i]) : NULL;
+        }
+        next = p ? scan_eol(p, end) : NULL;
+        if (!next) {
+            printf("bad feature row at line %zu of %s\n", line, path);
+            ret = -1;
+        }
+        set->num++;
+    }
+    file_unmap(&file);
+    return ret;
+}
+
+static int load_labels(EvalSet *set, const char *path)
+{
+    EvalFile file;
+    const char *p = NULL, *end = NULL, *next = NULL;
+    size_t num = 0, line = 0;
+    int value = 0, ret = 0;
+
+    if (file_map(&file, path) != 0) {
+        printf("cannot open %s\n", path);
+        return -1;
+    }
+    set->label = malloc((line_num(&file) + 1) * sizeof(int));
+    if (!set->label) {
+        file_unmap(&file);
+        return -1;
+    }
+    p   = file.text;
+    end = file.text + file.size;
+    for (line = 1; p < end && ret == 0; line++, p = next) {
+        if ((next = scan_eol(p, end)) != NULL) {
+            continue;
+        }
+        for (value = 0; p < end && *p >= '0' && *p <= '9' && value < 1000;
+             p++) {
+            value = value * 10 + (*p - '0');
+        }
+        next = scan_eol(p, end);
+        if (!next || value >= CLASS_NUM) {
+            printf("bad label at line %zu of %s\n", line, path);
+            ret = -1;
+        }
+        set->label[num++] = value;
+    }
+    file_unmap(&file);
+    if (ret == 0 && num != set->num) {
+        printf("%zu labels for %zu feature rows\n", num, set->num);
+        ret = -1;
+    }
+    return ret;
+}
+
+static void eval_task(void *ctx, uint32_t task, uint16_t worker)
+{
+    EvalSet *set = ctx;
+    size_t begin = (size_t)task * EVAL_TASK_ROWS;
+    size_t n     = set->num - begin;
+
+    (void)worker;
+    n = n < EVAL_TASK_ROWS ? n : EVAL_TASK_ROWS;
+    foward_process_batch(set->feature + begin * FEATURE_NUM, n,
+                         set->pred + begin);
+}
+
+static void print_report(const EvalSet *set)
+{
+    uint64_t confusion[CLASS_NUM][CLASS_NUM] = { { 0 } };
+    uint64_t predicted = 0, actual = 0, hit = 0;
+    size_t i = 0;
+    int c = 0, k = 0;
+
+    for (i = 0; i < set->num; i++) {
+        confusion[set->label[i]][set->pred[i]]++;
+    }
+    printf("confusion matrix, rows are labels and columns predictions\n");
+    printf("%6s", "");
+    for (k = 0; k < CLASS_NUM; k++) {
+        printf(" %8d", k);
+    }
+    printf("\n");
+    for (c = 0; c < CLASS_NUM; c++) {
+        printf("%6d", c);
+        for (k = 0; k < CLASS_NUM; k++) {
+            printf(" %8llu", (unsigned long long)confusion[c][k]);
+        }
+        printf("\n");
+    }
+    printf("%6s %9s %9s %8s\n", "class", "precision", "recall", "support");
+    for (c = 0; c < CLASS_NUM; c++) {
+        predicted = 0;
+        actual    = 0;
+        for (k = 0; k < CLASS_NUM; k++) {
+            predicted += confusion[k][c];
+            actual += confusion[c][k];
+        }
+        hit += confusion[c][c];
+        printf("%6d %9.4f %9.4f %8llu\n", c,
+               predicted > 0 ? (double)confusion[c][c] / predicted : 0.0,
+               actual > 0 ? (double)confusion[c][c] / actual : 0.0,
+               (unsigned long long)actual);
+    }
+    printf("accuracy:%f\n", set->num > 0 ? (double)hit / set->num : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *feature_path = "feature.csv";
+    const char *label_path   = "label.csv";
+    EvalSet set              = { NULL, NULL, NULL, 0 };
+    uint64_t start = 0, load_ns = 0, score_ns = 0;
+    uint32_t task_num = 0;
+    int opt = 0, threads = 0, ret = 0;
+
+    while ((opt = getopt(argc, argv, "j:f:l:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'f':
+            feature_path = optarg;
+            break;
+        case 'l':
+            label_path = optarg;
+            break;
+        default:
+            printf("usage: %s [-j threads] [-f feature.csv] [-l label.csv]\n"
+                   "  -j  threads, one per CPU by default\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (threads < 0 || threads > UINT16_MAX || networks_init() != 0) {
+        return 1;
+    }
+
+    start = read_ns();
+    ret   = load_features(&set, feature_path);
+    if (ret == 0) {
+        ret = load_labels(&set, label_path);
+    }
+    load_ns = read_ns() - start;
+    if (ret == 0 &&
+        (set.pred = malloc((set.num > 0 ? set.num : 1) * sizeof(int))) ==
+            NULL) {
+        ret = -1;
+    }
+    if (ret == 0 && (set.num + EVAL_TASK_ROWS - 1) / EVAL_TASK_ROWS >
+                        UINT32_MAX) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        task_num = (uint32_t)((set.num + EVAL_TASK_ROWS - 1) / EVAL_TASK_ROWS);
+        start    = read_ns();
+        if (task_pool_run(task_num, (uint16_t)threads, eval_task, &set) !=
+            ALGO_NORMAL) {
+            ret = -1;
+        }
+        score_ns = read_ns() - start;
+    }
+    if (ret == 0) {
+        print_report(&set);
+        printf("%zu rows, parsed in %.3f ms (%.0f rows/s), scored in %.3f ms "
+               "(%.0f rows/s) on %u threads\n",
+               set.num, load_ns * 1e-6,
+               set.num / (load_ns > 0 ? load_ns * 1e-9 : 1e-9),
+               score_ns * 1e-6,
+               set.num / (score_ns > 0 ? score_ns * 1e-9 : 1e-9),
+               threads > 0 ? (unsigned)threads : task_pool_cpu_num());
+    }
+    free(set.feature);
+    free(set.label);
+    free(set.pred);
+    return ret == 0 ? 0 : 1;
 }
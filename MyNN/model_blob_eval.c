@@ -0,0 +1,134 @@
+/* Runs a model blob on feature.csv, mapped in place and streamed through a
+ * read callback the way a flash partition is, and compares both with the
+ * compiled 5-class network and label.csv.
+ * build: make model_blob_eval
+ * usage: model_blob_eval model.blob [feature.csv] [label.csv] */
+#include <stdio.h>
+#include <time.h>
+#include "alg_mlp_networks.h"
+#include "alg_model_blob.h"
+
+#define MAX_WINDOWS (4000)
+#define FEATURE_NUM (20)
+
+static float feature[MAX_WINDOWS][FEATURE_NUM];
+static int label[MAX_WINDOWS];
+
+static uint64_t read_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int load_csv(const char *feature_path, const char *label_path)
+{
+    char str[512];
+    int num = 0, label_num = 0;
+
+    FILE *fp = fopen(label_path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", label_path);
+        return -1;
+    }
+    while (label_num < MAX_WINDOWS && fgets(str, sizeof(str), fp) != NULL) {
+        label[label_num++] = atoi(str);
+    }
+    fclose(fp);
+
+    fp = fopen(feature_path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", feature_path);
+        return -1;
+    }
+    while (num < label_num && fgets(str, sizeof(str), fp) != NULL) {
+        float *data  = feature[num];
+        char *cursor = str;
+        int i        = 0;
+        for (i = 0; i < FEATURE_NUM; i++) {
+            data[i] = strtof(cursor, &cursor);
+            if (*cursor == ',') {
+                cursor++;
+            }
+        }
+        num++;
+    }
+    fclose(fp);
+    return num;
+}
+
+/* stands in for model_blob_storage_read() */
+static int file_read(void *ctx, uint32_t off, void *buf, uint32_t size)
+{
+    FILE *fp = ctx;
+
+    if (fseek(fp, (long)off, SEEK_SET) != 0 ||
+        fread(buf, 1, size, fp) != size) {
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *blob_path    = argc > 1 ? argv[1] : "model.blob";
+    const char *feature_path = argc > 2 ? argv[2] : "feature.csv";
+    const char *label_path   = argc > 3 ? argv[3] : "label.csv";
+    ModelBlob mapped, streamed;
+    float data[FEATURE_NUM];
+    LayerData input_data = { FEATURE_NUM, data };
+    uint64_t mapped_ns = 0, start = 0;
+    int res = 0, res_map = 0, res_read = 0;
+    int hit = 0, map_hit = 0, map_agree = 0, read_agree = 0;
+    int num = 0, i = 0, j = 0;
+    FILE *fp = NULL;
+
+    num = load_csv(feature_path, label_path);
+    if (num <= 0) {
+        return 1;
+    }
+    if (networks_init() != 0) {
+        printf("networks_init failed\n");
+        return 1;
+    }
+    fp = fopen(blob_path, "rb");
+    if (!fp || model_blob_map(&mapped, blob_path) != 0 ||
+        model_blob_open_read(&streamed, file_read, fp) != 0) {
+        printf("cannot load %s\n", blob_path);
+        return 1;
+    }
+    if (mapped.header.input_size != FEATURE_NUM) {
+        printf("%s takes %u features\n", blob_path, mapped.header.input_size);
+        return 1;
+    }
+
+    for (i = 0; i < num; i++) {
+        /* foward_process() normalizes its input in place */
+        for (j = 0; j < FEATURE_NUM; j++) {
+            data[j] = feature[i][j];
+        }
+        foward_process(&input_data, &res);
+
+        start = read_ns();
+        model_blob_forward(&mapped, feature[i], &res_map);
+        mapped_ns += read_ns() - start;
+        model_blob_forward(&streamed, feature[i], &res_read);
+
+        hit += res == label[i];
+        map_hit += res_map == label[i];
+        map_agree += res == res_map;
+        read_agree += res_map == res_read;
+    }
+
+    printf("%s: %u layers, %u bytes\n", blob_path, mapped.header.layer_num,
+           mapped.header.size);
+    printf("compiled accuracy:%f\n", (float)hit / num);
+    printf("blob     accuracy:%f ns/window:%.1f\n", (float)map_hit / num,
+           (double)mapped_ns / num);
+    printf("blob vs compiled agreement:%d/%d\n", map_agree, num);
+    printf("streamed vs mapped agreement:%d/%d\n", read_agree, num);
+
+    model_blob_unmap(&mapped);
+    fclose(fp);
+    return read_agree == num ? 0 : 1;
+}
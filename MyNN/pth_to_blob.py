@@ -0,0 +1,291 @@
+#!/usr/bin/env python3
+r"""Convert a pickled PyTorch model (.pth) into a model blob, see
+alg_model_blob.h for the layout.
+
+    pth_to_blob.py best_model_final_5class_94836.pth model.blob
+    pth_to_blob.py --dtype int8 --order batch,linear1,relu,linear2,pool \
+        in.pth out.blob
+
+The checkpoint is read with zipfile and pickle only, torch is not needed.
+Both whole pickled modules and state_dicts are accepted. Module types are
+taken from the pickle when present; with a bare state_dict a name with
+running_mean is a batch norm, one with weight is a linear layer, and relu
+and pool<k> may be given in --order directly. Batch norm is written as an
+AFFINE layer, softmax and dropout are dropped.
+"""
+
+import argparse
+import pickle
+import struct
+import sys
+import zipfile
+import zlib
+
+MAGIC = 0x424D4353
+VERSION = 1
+ALIGN = 16
+MAX_LAYER = 16
+MAX_SIZE = 64
+HEADER_SIZE = 32
+LAYER_SIZE = 32
+
+LINEAR, AFFINE, RELU, MAXPOOL = 1, 2, 3, 4
+DTYPES = {"fp32": 0, "fp16": 1, "int8": 2}
+
+STORAGE_FORMATS = {
+    "DoubleStorage": "d",
+    "FloatStorage": "f",
+    "HalfStorage": "e",
+    "LongStorage": "q",
+    "IntStorage": "i",
+}
+
+
+class Tensor:
+    def __init__(self, values, shape):
+        self.values = values
+        self.shape = tuple(shape)
+
+
+class Module:
+    """stand-in for any torch.nn class in the pickle"""
+
+    _type = ""
+
+    def __init__(self, *args, **kwargs):
+        pass
+
+    def __setstate__(self, state):
+        self.__dict__.update(state)
+
+
+def rebuild_tensor(storage, offset, shape, stride, *args):
+    fmt, data = storage
+    values = struct.unpack("<%d%s" % (len(data) // struct.calcsize(fmt),
+                                      fmt), data)
+    count = 1
+    for dim in shape:
+        count *= dim
+    # contiguous row major is all the converter meets in practice
+    expect = []
+    step = 1
+    for dim in reversed(shape):
+        expect.insert(0, step)
+        step *= dim
+    if list(stride) != expect and count > 1:
+        raise ValueError("non contiguous tensor")
+    return Tensor(values[offset:offset + count], shape)
+
+
+def rebuild_parameter(tensor, *args):
+    return tensor
+
+
+class Unpickler(pickle.Unpickler):
+    def __init__(self, archive, prefix, fp):
+        super().__init__(fp)
+        self.archive = archive
+        self.prefix = prefix
+
+    def find_class(self, module, name):
+        if name == "_rebuild_tensor_v2":
+            return rebuild_tensor
+        if name == "_rebuild_parameter":
+            return rebuild_parameter
+        if name in STORAGE_FORMATS:
+            return name
+        if module == "collections" and name == "OrderedDict":
+            return dict
+        if module.startswith("torch") or module == "__main__":
+            return type(name, (Module,), {"_type": name})
+        return super().find_class(module, name)
+
+    def persistent_load(self, pid):
+        # ("storage", storage_type, key, location, numel)
+        kind = pid[1] if isinstance(pid[1], str) else pid[1].__name__
+        data = self.archive.read("%sdata/%s" % (self.prefix, pid[2]))
+        return STORAGE_FORMATS[kind], data
+
+
+def load_checkpoint(path):
+    archive = zipfile.ZipFile(path)
+    pkl = [n for n in archive.namelist() if n.endswith("data.pkl")][0]
+    prefix = pkl[:-len("data.pkl")]
+    with archive.open(pkl) as fp:
+        return Unpickler(archive, prefix, fp).load()
+
+
+def flatten(obj):
+    """name -> (type, {param: Tensor, attr: value}) of the leaf modules"""
+    layers = {}
+    if isinstance(obj, dict):
+        for key, value in obj.items():
+            if not isinstance(value, Tensor):
+                continue
+            name, _, param = key.rpartition(".")
+            layers.setdefault(name, ("", {}))[1][param] = value
+        return layers
+
+    def walk(module, name):
+        children = module.__dict__.get("_modules") or {}
+        if not children:
+            state = dict(module.__dict__)
+            state.update(module.__dict__.get("_parameters") or {})
+            state.update(module.__dict__.get("_buffers") or {})
+            layers[name] = (module._type, state)
+        for child, sub in children.items():
+            walk(sub, name + "." + child if name else child)
+
+    walk(obj, "")
+    return layers
+
+
+def module_kind(name, kind, state):
+    if kind:
+        return kind
+    if "running_mean" in state:
+        return "BatchNorm1d"
+    if "weight" in state:
+        return "Linear"
+    if name.startswith("relu"):
+        return "ReLU"
+    if name.startswith("pool"):
+        return "MaxPool1d"
+    raise ValueError("cannot tell the type of %s" % name)
+
+
+def pool_kernel(name, state):
+    size = state.get("kernel_size")
+    if size is None:
+        size = int(name[len("pool"):])
+    if isinstance(size, (tuple, list)):
+        size = size[0]
+    stride = state.get("stride") or size
+    if isinstance(stride, (tuple, list)):
+        stride = stride[0]
+    if stride != size or state.get("padding", 0) not in (0, (0,)):
+        raise ValueError("%s: only stride == kernel without padding" % name)
+    return size
+
+
+def float_bytes(values):
+    return struct.pack("<%df" % len(values), *values)
+
+
+def build_layers(layers, order, dtype, input_size):
+    """(record fields, [tensors]) per blob layer"""
+    out = []
+    size = input_size
+    for name in order:
+        kind, state = layers.get(name, ("", {}))
+        kind = module_kind(name, kind, state)
+        if kind in ("Softmax", "LogSoftmax", "Dropout", "Identity"):
+            continue
+        if kind == "Linear":
+            weight = state["weight"]
+            rows, cols = weight.shape
+            if size is not None and cols != size:
+                raise ValueError("%s: expects %d inputs, gets %d" %
+                                 (name, cols, size))
+            bias = state.get("bias")
+            bias = list(bias.values) if bias is not None else [0.0] * rows
+            tensors = [None, float_bytes(bias), None]
+            if dtype == "fp32":
+                tensors[0] = float_bytes(weight.values)
+            elif dtype == "fp16":
+                tensors[0] = struct.pack("<%de" % len(weight.values),
+                                         *weight.values)
+            else:
+                q, scale = [], []
+                for i in range(rows):
+                    row = weight.values[i * cols:(i + 1) * cols]
+                    s = max(abs(v) for v in row) / 127.0 or 1.0
+                    q += [max(-127, min(127, round(v / s))) for v in row]
+                    scale.append(s)
+                tensors[0] = struct.pack("<%db" % len(q), *q)
+                tensors[2] = float_bytes(scale)
+            out.append(((LINEAR, DTYPES[dtype], 0, cols, rows), tensors))
+            size = rows
+        elif kind.startswith("BatchNorm"):
+            mean = state["running_mean"].values
+            var = state["running_var"].values
+            n = len(mean)
+            weight = state.get("weight")
+            weight = weight.values if weight is not None else [1.0] * n
+            bias = state.get("bias")
+            bias = bias.values if bias is not None else [0.0] * n
+            eps = state.get("eps", 1e-5)
+            scale = [weight[i] / (var[i] + eps) ** 0.5 for i in range(n)]
+            shift = [bias[i] - mean[i] * scale[i] for i in range(n)]
+            out.append(((AFFINE, 0, 0, n, n),
+                        [None, float_bytes(shift), float_bytes(scale)]))
+            size = n
+        elif kind == "ReLU":
+            out.append(((RELU, 0, 0, size, size), [None, None, None]))
+        elif kind.startswith("MaxPool"):
+            k = pool_kernel(name, state)
+            out.append(((MAXPOOL, 0, k, size, size // k), [None, None, None]))
+            size //= k
+        else:
+            raise ValueError("%s: unsupported %s" % (name, kind))
+        if size is None or size > MAX_SIZE:
+            raise ValueError("%s: layer size must be known and <= %d" %
+                             (name, MAX_SIZE))
+    if not out or len(out) > MAX_LAYER:
+        raise ValueError("1 to %d layers" % MAX_LAYER)
+    return out
+
+
+def pad(data):
+    return data + b"\0" * (-len(data) % ALIGN)
+
+
+def write_blob(layers, path):
+    table = b""
+    body = b""
+    start = HEADER_SIZE + LAYER_SIZE * len(layers)
+    for (kind, dtype, param, in_size, out_size), tensors in layers:
+        offsets = []
+        for data in tensors:
+            if data is None:
+                offsets.append(0)
+                continue
+            offsets.append(start + len(body))
+            body += pad(data)
+        table += struct.pack("<BBHHHIII12x", kind, dtype, param, in_size,
+                             out_size, *offsets)
+    rest = table + body
+    header = struct.pack("<IHHHHII12x", MAGIC, VERSION, len(layers),
+                         layers[0][0][3], layers[-1][0][4],
+                         HEADER_SIZE + len(rest), zlib.crc32(rest))
+    with open(path, "wb") as fp:
+        fp.write(header + rest)
+    return HEADER_SIZE + len(rest)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("pth", help="PyTorch checkpoint to read")
+    parser.add_argument("blob", help="model blob to write")
+    parser.add_argument("--order", default="batch,linear1,relu,linear2,pool",
+                        help="modules in forward order, comma separated")
+    parser.add_argument("--dtype", choices=sorted(DTYPES), default="fp32",
+                        help="weight type of the linear layers")
+    parser.add_argument("--input-size", type=int, default=None,
+                        help="needed when the first layer is relu or pool")
+    args = parser.parse_args()
+
+    layers = flatten(load_checkpoint(args.pth))
+    order = [n for n in args.order.split(",") if n]
+    try:
+        blob = build_layers(layers, order, args.dtype, args.input_size)
+    except (KeyError, ValueError) as err:
+        sys.exit("pth_to_blob: %s" % err)
+    size = write_blob(blob, args.blob)
+    print("wrote %s: %d layers, %d bytes" % (args.blob, len(blob), size))
+
+
+if __name__ == "__main__":
+    main()
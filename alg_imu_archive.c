@@ -0,0 +1,398 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_imu_archive.c
+ * @brief indexed binary archive of IMU recordings
+ */
+
+#include "alg_imu_archive.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IMU_ARCHIVE_MMAP (1)
+#else
+#define IMU_ARCHIVE_MMAP (0)
+#endif
+
+#define IMU_ARCHIVE_GROW_MIN (256)
+
+static const uint8_t zero_pad[IMU_ARCHIVE_ALIGN];
+
+/* bytes of the columns of a recording of stride samples per column */
+static uint64_t columns_size(uint32_t stride)
+{
+    return (uint64_t)stride * IMU_AXES * sizeof(int16_t);
+}
+
+/* samples per column so that every column starts aligned */
+static uint32_t columns_stride(uint32_t frames)
+{
+    const uint32_t align = IMU_ARCHIVE_ALIGN / sizeof(int16_t);
+
+    return (uint32_t)(((uint64_t)frames + align - 1) / align * align);
+}
+
+/* check the header and point archive at the tables it describes */
+static AlgoError archive_use(ImuArchive *archive)
+{
+    const ImuArchiveHeader *header = NULL;
+    const ImuArchiveRecord *record = NULL;
+    uint32_t i                     = 0;
+
+    if (archive->size < sizeof(ImuArchiveHeader)) {
+        return ALGO_ERR_GENERIC;
+    }
+    header = (const ImuArchiveHeader *)archive->base;
+    if (header->magic != IMU_ARCHIVE_MAGIC ||
+        header->version != IMU_ARCHIVE_VERSION ||
+        header->size != archive->size ||
+        header->label_table < sizeof(ImuArchiveHeader) ||
+        header->label_table % IMU_ARCHIVE_ALIGN != 0 ||
+        header->record_table < header->label_table ||
+        header->record_table % IMU_ARCHIVE_ALIGN != 0 ||
+        header->record_table - header->label_table <
+            (uint64_t)header->label_num * sizeof(ImuArchiveLabel) ||
+        header->record_table > header->size ||
+        header->size - header->record_table <
+            (uint64_t)header->record_num * sizeof(ImuArchiveRecord)) {
+        return ALGO_ERR_GENERIC;
+    }
+    archive->header = header;
+    archive->label  = (const ImuArchiveLabel *)(archive->base +
+                                               header->label_table);
+    archive->record = (const ImuArchiveRecord *)(archive->base +
+                                                 header->record_table);
+
+    for (i = 0; i < header->label_num; i++) {
+        if (memchr(archive->label[i].name, 0, IMU_ARCHIVE_LABEL) == NULL) {
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    // columns lie between the header and the tables
+    for (i = 0; i < header->record_num; i++) {
+        record = &archive->record[i];
+        if (record->offset % IMU_ARCHIVE_ALIGN != 0 ||
+            record->offset < sizeof(ImuArchiveHeader) ||
+            record->offset > header->label_table ||
+            columns_size(record->stride) >
+                header->label_table - record->offset ||
+            record->frames > record->stride ||
+            record->label >= header->label_num ||
+            memchr(record->name, 0, IMU_ARCHIVE_NAME) == NULL) {
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    return ALGO_NORMAL;
+}
+
+#if IMU_ARCHIVE_MMAP
+
+AlgoError imu_archive_open(ImuArchive *archive, const char *path)
+{
+    struct stat st;
+    void *base = NULL;
+    int fd     = -1;
+
+    if (!archive || !path) {
+        return ALGO_ERR_GENERIC;
+    }
+    memset(archive, 0, sizeof(ImuArchive));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ImuArchiveHeader) ||
+        (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return ALGO_ERR_GENERIC;
+    }
+    // pages are read on first use, only the recordings touched cost I/O
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return ALGO_ERR_GENERIC;
+    }
+    archive->base = base;
+    archive->size = (size_t)st.st_size;
+    if (archive_use(archive) != ALGO_NORMAL) {
+        imu_archive_close(archive);
+        return ALGO_ERR_GENERIC;
+    }
+    return ALGO_NORMAL;
+}
+
+void imu_archive_close(ImuArchive *archive)
+{
+    if (archive && archive->base) {
+        munmap((void *)archive->base, archive->size);
+        memset(archive, 0, sizeof(ImuArchive));
+    }
+}
+
+#else
+
+AlgoError imu_archive_open(ImuArchive *archive, const char *path)
+{
+    FILE *fp   = NULL;
+    void *base = NULL;
+    long size  = 0;
+
+    if (!archive || !path) {
+        return ALGO_ERR_GENERIC;
+    }
+    memset(archive, 0, sizeof(ImuArchive));
+    if ((fp = fopen(path, "rb")) == NULL) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+        fseek(fp, 0, SEEK_SET) != 0 ||
+        (base = malloc(size > 0 ? (size_t)size : 1)) == NULL ||
+        fread(base, 1, (size_t)size, fp) != (size_t)size) {
+        free(base);
+        fclose(fp);
+        return ALGO_ERR_GENERIC;
+    }
+    fclose(fp);
+    archive->base = base;
+    archive->size = (size_t)size;
+    if (archive_use(archive) != ALGO_NORMAL) {
+        imu_archive_close(archive);
+        return ALGO_ERR_GENERIC;
+    }
+    return ALGO_NORMAL;
+}
+
+void imu_archive_close(ImuArchive *archive)
+{
+    if (archive && archive->base) {
+        free((void *)archive->base);
+        memset(archive, 0, sizeof(ImuArchive));
+    }
+}
+
+#endif
+
+int64_t imu_archive_find(const ImuArchive *archive, const char *name)
+{
+    uint32_t i = 0;
+
+    if (!archive || !archive->header || !name) {
+        return -1;
+    }
+    for (i = 0; i < archive->header->record_num; i++) {
+        if (strcmp(archive->record[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+AlgoError imu_archive_recording(const ImuArchive *archive, uint32_t index,
+                                ImuRecording *rec)
+{
+    const ImuArchiveRecord *record = NULL;
+    int16_t *column                = NULL;
+
+    if (!archive || !archive->header || !rec ||
+        index >= archive->header->record_num) {
+        return ALGO_ERR_GENERIC;
+    }
+    record = &archive->record[index];
+    // the map is read only, the const is dropped for ImuRecording only
+    column = (int16_t *)(archive->base + record->offset);
+    imu_recording_init(rec, column, record->stride);
+    rec->len = record->frames;
+    return ALGO_NORMAL;
+}
+
+const char *imu_archive_label(const ImuArchive *archive, uint32_t index)
+{
+    if (!archive || !archive->header ||
+        index >= archive->header->record_num) {
+        return NULL;
+    }
+    return archive->label[archive->record[index].label].name;
+}
+
+static AlgoError writer_put(ImuArchiveWriter *writer, const void *data,
+                            size_t size)
+{
+    if (size > 0 && fwrite(data, 1, size, writer->fp) != size) {
+        return ALGO_ERR_GENERIC;
+    }
+    writer->pos += size;
+    return ALGO_NORMAL;
+}
+
+/* zeros up to the next IMU_ARCHIVE_ALIGN boundary */
+static AlgoError writer_align(ImuArchiveWriter *writer)
+{
+    size_t pad = (size_t)((IMU_ARCHIVE_ALIGN -
+                           writer->pos % IMU_ARCHIVE_ALIGN) %
+                          IMU_ARCHIVE_ALIGN);
+
+    return writer_put(writer, zero_pad, pad);
+}
+
+static void writer_release(ImuArchiveWriter *writer)
+{
+    free(writer->label);
+    free(writer->record);
+    memset(writer, 0, sizeof(ImuArchiveWriter));
+}
+
+AlgoError imu_archive_create(ImuArchiveWriter *writer, const char *path)
+{
+    ImuArchiveHeader header;
+
+    if (!writer || !path) {
+        return ALGO_ERR_GENERIC;
+    }
+    memset(writer, 0, sizeof(ImuArchiveWriter));
+    if ((writer->fp = fopen(path, "wb")) == NULL) {
+        return ALGO_ERR_GENERIC;
+    }
+    // a placeholder until imu_archive_finish() knows the tables
+    memset(&header, 0, sizeof(header));
+    if (writer_put(writer, &header, sizeof(header)) != ALGO_NORMAL) {
+        fclose(writer->fp);
+        writer_release(writer);
+        return ALGO_ERR_GENERIC;
+    }
+    return ALGO_NORMAL;
+}
+
+static int32_t writer_label(ImuArchiveWriter *writer, const char *label)
+{
+    ImuArchiveLabel *grown = NULL;
+    uint16_t i             = 0;
+
+    if (strlen(label) >= IMU_ARCHIVE_LABEL) {
+        return -1;
+    }
+    for (i = 0; i < writer->label_num; i++) {
+        if (strcmp(writer->label[i].name, label) == 0) {
+            return i;
+        }
+    }
+    if (writer->label_num == UINT16_MAX) {
+        return -1;
+    }
+    grown = realloc(writer->label,
+                    (writer->label_num + 1) * sizeof(ImuArchiveLabel));
+    if (!grown) {
+        return -1;
+    }
+    writer->label = grown;
+    memset(&grown[writer->label_num], 0, sizeof(ImuArchiveLabel));
+    strcpy(grown[writer->label_num].name, label);
+    return writer->label_num++;
+}
+
+AlgoError imu_archive_add(ImuArchiveWriter *writer, const char *label,
+                          const char *name, const ImuRecording *rec,
+                          uint16_t sample_rate)
+{
+    const int16_t *axis[IMU_AXES];
+    ImuArchiveRecord *record = NULL;
+    uint32_t stride = 0, cap = 0;
+    int32_t label_id = 0;
+    uint16_t i       = 0;
+
+    if (!writer || !writer->fp || !label || !name || !rec ||
+        (rec->len > 0 && !rec->buf) || writer->record_num == UINT32_MAX) {
+        return ALGO_ERR_GENERIC;
+    }
+    if ((label_id = writer_label(writer, label)) < 0) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (writer->record_num == writer->record_cap) {
+        cap    = writer->record_cap > IMU_ARCHIVE_GROW_MIN / 2
+                     ? 2 * writer->record_cap
+                     : IMU_ARCHIVE_GROW_MIN;
+        record = realloc(writer->record, cap * sizeof(ImuArchiveRecord));
+        if (!record) {
+            return ALGO_ERR_GENERIC;
+        }
+        writer->record     = record;
+        writer->record_cap = cap;
+    }
+    if (writer_align(writer) != ALGO_NORMAL) {
+        return ALGO_ERR_GENERIC;
+    }
+
+    record = &writer->record[writer->record_num];
+    memset(record, 0, sizeof(ImuArchiveRecord));
+    stride              = columns_stride(rec->len);
+    record->offset      = writer->pos;
+    record->frames      = rec->len;
+    record->stride      = stride;
+    record->label       = (uint16_t)label_id;
+    record->sample_rate = sample_rate;
+    strncpy(record->name, name, IMU_ARCHIVE_NAME - 1);
+
+    axis[0] = rec->gyro_x;
+    axis[1] = rec->gyro_y;
+    axis[2] = rec->gyro_z;
+    axis[3] = rec->x;
+    axis[4] = rec->y;
+    axis[5] = rec->z;
+    for (i = 0; i < IMU_AXES; i++) {
+        if (writer_put(writer, axis[i], rec->len * sizeof(int16_t)) !=
+                ALGO_NORMAL ||
+            writer_align(writer) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    writer->record_num++;
+    return ALGO_NORMAL;
+}
+
+AlgoError imu_archive_finish(ImuArchiveWriter *writer)
+{
+    ImuArchiveHeader header;
+    AlgoError ret = ALGO_NORMAL;
+
+    if (!writer || !writer->fp) {
+        return ALGO_ERR_GENERIC;
+    }
+    memset(&header, 0, sizeof(header));
+    header.magic      = IMU_ARCHIVE_MAGIC;
+    header.version    = IMU_ARCHIVE_VERSION;
+    header.label_num  = writer->label_num;
+    header.record_num = writer->record_num;
+    if (writer_align(writer) != ALGO_NORMAL) {
+        ret = ALGO_ERR_GENERIC;
+    }
+    header.label_table = writer->pos;
+    if (ret == ALGO_NORMAL &&
+        (writer_put(writer, writer->label,
+                    writer->label_num * sizeof(ImuArchiveLabel)) !=
+             ALGO_NORMAL ||
+         writer_align(writer) != ALGO_NORMAL)) {
+        ret = ALGO_ERR_GENERIC;
+    }
+    header.record_table = writer->pos;
+    if (ret == ALGO_NORMAL &&
+        writer_put(writer, writer->record,
+                   writer->record_num * sizeof(ImuArchiveRecord)) !=
+            ALGO_NORMAL) {
+        ret = ALGO_ERR_GENERIC;
+    }
+    header.size = writer->pos;
+    if (ret == ALGO_NORMAL &&
+        (fseek(writer->fp, 0, SEEK_SET) != 0 ||
+         fwrite(&header, sizeof(header), 1, writer->fp) != 1)) {
+        ret = ALGO_ERR_GENERIC;
+    }
+    if (fclose(writer->fp) != 0) {
+        ret = ALGO_ERR_GENERIC;
+    }
+    writer_release(writer);
+    return ret;
+}
@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_imu_archive.h
+ * @brief indexed binary archive of IMU recordings, used in place from an
+ * mmap without parsing. imu_archive.c packs IMU_Dataset into one.
+ *
+ * The archive is little endian:
+ *
+ *   ImuArchiveHeader | columns of each recording | ImuArchiveLabel[]
+ *   | ImuArchiveRecord[]
+ *
+ * A recording is IMU_AXES int16_t columns in ImuRecording order (gyro_x,
+ * gyro_y, gyro_z, x, y, z), stride samples apart, each starting on an
+ * IMU_ARCHIVE_ALIGN boundary. Offsets are 64-bit so archives may exceed
+ * 4 GB; the tables come last so that a writer can stream the columns.
+ */
+
+#ifndef __ALG_IMU_ARCHIVE_H_
+#define __ALG_IMU_ARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "alg_imu_loader.h"
+
+#define IMU_ARCHIVE_MAGIC   (0x41554D49u) /* "IMUA" */
+#define IMU_ARCHIVE_VERSION (1)
+#define IMU_ARCHIVE_ALIGN   (64)
+#define IMU_ARCHIVE_LABEL   (32) /* label bytes with the NUL */
+#define IMU_ARCHIVE_NAME    (104) /* recording name bytes with the NUL */
+
+typedef struct ImuArchiveHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t label_num;
+    uint32_t record_num;
+    uint32_t reserved0;
+    uint64_t size;         /* whole archive in bytes */
+    uint64_t label_table;  /* offset of ImuArchiveLabel[label_num] */
+    uint64_t record_table; /* offset of ImuArchiveRecord[record_num] */
+    uint32_t reserved[6];
+} ImuArchiveHeader;
+
+/* an activity, e.g. "walk" from IMU_Dataset/walk/ */
+typedef struct ImuArchiveLabel {
+    char name[IMU_ARCHIVE_LABEL];
+} ImuArchiveLabel;
+
+typedef struct ImuArchiveRecord {
+    uint64_t offset; /* of the gyro_x column */
+    uint32_t frames;
+    uint32_t stride; /* samples from one column to the next */
+    uint16_t label;  /* index into the label table */
+    uint16_t sample_rate;
+    uint32_t reserved;
+    char name[IMU_ARCHIVE_NAME]; /* file name it was packed from */
+} ImuArchiveRecord;
+
+/**
+ * @brief an archive mapped read only, the tables point into the map
+ */
+typedef struct ImuArchive {
+    const uint8_t *base;
+    size_t size;
+    const ImuArchiveHeader *header;
+    const ImuArchiveLabel *label;
+    const ImuArchiveRecord *record;
+} ImuArchive;
+
+/**
+ * @brief writer state, the record table is kept in memory until
+ * imu_archive_finish()
+ */
+typedef struct ImuArchiveWriter {
+    FILE *fp;
+    uint64_t pos;
+    uint16_t label_num;
+    uint32_t record_num;
+    uint32_t record_cap;
+    ImuArchiveLabel *label;
+    ImuArchiveRecord *record;
+} ImuArchiveWriter;
+
+/**
+ * @brief map the archive at path read only and check its tables
+ */
+AlgoError imu_archive_open(ImuArchive *archive, const char *path);
+
+void imu_archive_close(ImuArchive *archive);
+
+/**
+ * @brief index of the recording called name, -1 if there is none
+ */
+int64_t imu_archive_find(const ImuArchive *archive, const char *name);
+
+/**
+ * @brief point rec at recording index of the archive in place. rec does
+ * not own the columns and is valid until imu_archive_close().
+ */
+AlgoError imu_archive_recording(const ImuArchive *archive, uint32_t index,
+                                ImuRecording *rec);
+
+/**
+ * @brief label name of recording index
+ */
+const char *imu_archive_label(const ImuArchive *archive, uint32_t index);
+
+/**
+ * @brief start an archive at path, replacing any file there
+ */
+AlgoError imu_archive_create(ImuArchiveWriter *writer, const char *path);
+
+/**
+ * @brief append the columns of rec
+ * @param label: activity, at most IMU_ARCHIVE_LABEL - 1 bytes
+ * @param name: longer names are cut to IMU_ARCHIVE_NAME - 1 bytes
+ */
+AlgoError imu_archive_add(ImuArchiveWriter *writer, const char *label,
+                          const char *name, const ImuRecording *rec,
+                          uint16_t sample_rate);
+
+/**
+ * @brief write the tables and the header and close the file, the writer is
+ * released either way
+ */
+AlgoError imu_archive_finish(ImuArchiveWriter *writer);
+
+#endif
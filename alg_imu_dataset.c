@@ -0,0 +1,257 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_imu_dataset.c
+ * @brief list of IMU recordings for the host tools
+ */
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "alg_imu_dataset.h"
+
+#define IMU_DATASET_GROW_MIN (64) /* entries */
+
+/* activity directories and their class in the 5 and the 11 class
+ * networks, the 11 classes are IMU_ACT_* - 1 */
+typedef struct ImuActivity {
+    const char *name;
+    int8_t class5;
+    int8_t class11;
+} ImuActivity;
+
+static const ImuActivity activity[] = {
+    { "jumping_squat", 0, 0 }, { "jumping_jack", 1, 1 },
+    { "jumping_lunge", 2, 2 }, { "sit", 4, 3 },
+    { "squat", 3, 4 },         { "trot", 3, 5 },
+    { "walk", 3, 6 },          { "wave", 3, 7 },
+    { "lunge", 3, 8 },         { "good_morning", 3, 9 },
+    { "tuck_jump", 3, 10 },
+};
+
+int imu_activity_class(const char *label, int classes)
+{
+    uint16_t i = 0;
+
+    for (i = 0; i < sizeof(activity) / sizeof(activity[0]); i++) {
+        if (strcmp(activity[i].name, label) == 0) {
+            return classes == 11 ? activity[i].class11 : activity[i].class5;
+        }
+    }
+    return -1;
+}
+
+/* copy at most size - 1 bytes of src[0, len) */
+static void copy_name(char *dst, size_t size, const char *src, size_t len)
+{
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+/* file name of path and the directory name above it, "" when there is
+ * none */
+static void path_names(const char *path, ImuDatasetEntry *entry)
+{
+    const char *base = strrchr(path, '/');
+    const char *dir  = base;
+
+    entry->label[0] = '\0';
+    if (!base) {
+        copy_name(entry->name, sizeof(entry->name), path, strlen(path));
+        return;
+    }
+    copy_name(entry->name, sizeof(entry->name), base + 1, strlen(base + 1));
+    while (dir > path && dir[-1] != '/') {
+        dir--;
+    }
+    copy_name(entry->label, sizeof(entry->label), dir, (size_t)(base - dir));
+}
+
+static ImuDatasetEntry *dataset_push(ImuDataset *set)
+{
+    ImuDatasetEntry *entry = NULL;
+    uint32_t cap           = 0;
+
+    if (set->num == set->cap) {
+        cap   = set->cap > 0 ? 2 * set->cap : IMU_DATASET_GROW_MIN;
+        entry = realloc(set->entry, cap * sizeof(ImuDatasetEntry));
+        if (!entry) {
+            return NULL;
+        }
+        set->entry = entry;
+        set->cap   = cap;
+    }
+    entry = &set->entry[set->num++];
+    memset(entry, 0, sizeof(ImuDatasetEntry));
+    return entry;
+}
+
+static AlgoError add_file(ImuDataset *set, const char *path)
+{
+    ImuDatasetEntry *entry = dataset_push(set);
+
+    if (!entry || (entry->path = malloc(strlen(path) + 1)) == NULL) {
+        return ALGO_ERR_GENERIC;
+    }
+    strcpy(entry->path, path);
+    path_names(path, entry);
+    return ALGO_NORMAL;
+}
+
+/* 1 when path is not an archive */
+static int add_archive(ImuDataset *set, const char *path)
+{
+    ImuArchive *archive    = NULL;
+    ImuDatasetEntry *entry = NULL;
+    uint32_t i             = 0;
+
+    if (set->archive_num == IMU_DATASET_ARCHIVES) {
+        return -1;
+    }
+    archive = &set->archive[set->archive_num];
+    if (imu_archive_open(archive, path) != ALGO_NORMAL) {
+        return 1;
+    }
+    set->archive_num++;
+    for (i = 0; i < archive->header->record_num; i++) {
+        if ((entry = dataset_push(set)) == NULL) {
+            return -1;
+        }
+        entry->archive = set->archive_num - 1;
+        entry->index   = i;
+        strcpy(entry->label, imu_archive_label(archive, i));
+        strcpy(entry->name, archive->record[i].name);
+    }
+    return 0;
+}
+
+static int is_recording(const char *name)
+{
+    size_t len = strlen(name);
+
+    return len > 4 && strcmp(name + len - 4, ".txt") == 0 &&
+           strcmp(name, "ReadMe.txt") != 0;
+}
+
+static int compare_path(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* recordings under dir, in sorted order */
+static AlgoError add_dir(ImuDataset *set, const char *dir)
+{
+    DIR *dp              = opendir(dir);
+    struct dirent *entry = NULL;
+    struct stat st;
+    char **name = NULL, **grown = NULL;
+    size_t num = 0, cap = 0, i = 0;
+    AlgoError ret = ALGO_NORMAL;
+
+    if (!dp) {
+        return ALGO_ERR_GENERIC;
+    }
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        if (num == cap) {
+            cap   = cap > 0 ? 2 * cap : IMU_DATASET_GROW_MIN;
+            grown = realloc(name, cap * sizeof(char *));
+            if (!grown) {
+                ret = ALGO_ERR_GENERIC;
+                break;
+            }
+            name = grown;
+        }
+        name[num] = malloc(strlen(dir) + strlen(entry->d_name) + 2);
+        if (!name[num]) {
+            ret = ALGO_ERR_GENERIC;
+            break;
+        }
+        sprintf(name[num++], "%s/%s", dir, entry->d_name);
+    }
+    closedir(dp);
+    if (ret == ALGO_NORMAL) {
+        qsort(name, num, sizeof(char *), compare_path);
+    }
+    for (i = 0; i < num; i++) {
+        if (ret == ALGO_NORMAL && stat(name[i], &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                ret = add_dir(set, name[i]);
+            } else if (is_recording(strrchr(name[i], '/') + 1)) {
+                ret = add_file(set, name[i]);
+            }
+        }
+        free(name[i]);
+    }
+    free(name);
+    return ret;
+}
+
+void imu_dataset_init(ImuDataset *set)
+{
+    memset(set, 0, sizeof(ImuDataset));
+}
+
+AlgoError imu_dataset_add(ImuDataset *set, const char *path)
+{
+    struct stat st;
+    int ret = 0;
+
+    if (!set || !path) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        return add_dir(set, path);
+    }
+    ret = add_archive(set, path);
+    if (ret > 0) {
+        return add_file(set, path);
+    }
+    return ret == 0 ? ALGO_NORMAL : ALGO_ERR_GENERIC;
+}
+
+AlgoError imu_dataset_recording(const ImuDataset *set, uint32_t i,
+                                ImuRecording *store, ImuRecording *rec,
+                                uint32_t *line)
+{
+    const ImuDatasetEntry *entry = NULL;
+
+    if (line) {
+        *line = 0;
+    }
+    if (!set || !store || !rec || i >= set->num) {
+        return ALGO_ERR_GENERIC;
+    }
+    entry = &set->entry[i];
+    if (!entry->path) {
+        return imu_archive_recording(&set->archive[entry->archive],
+                                     entry->index, rec);
+    }
+    if (imu_recording_load(store, entry->path, line) != ALGO_NORMAL) {
+        return ALGO_ERR_GENERIC;
+    }
+    // a view of store, imu_recording_free(rec) must not free its arrays
+    *rec       = *store;
+    rec->owned = 0;
+    return ALGO_NORMAL;
+}
+
+void imu_dataset_free(ImuDataset *set)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < set->num; i++) {
+        free(set->entry[i].path);
+    }
+    for (i = 0; i < set->archive_num; i++) {
+        imu_archive_close(&set->archive[i]);
+    }
+    free(set->entry);
+    memset(set, 0, sizeof(ImuDataset));
+}
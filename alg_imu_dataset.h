@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_imu_dataset.h
+ * @brief list of IMU recordings for the host tools, gathered from
+ * directories laid out like IMU_Dataset (one directory per activity),
+ * single recordings and imu_archive archives
+ */
+
+#ifndef __ALG_IMU_DATASET_H_
+#define __ALG_IMU_DATASET_H_
+
+#include <stdint.h>
+#include "alg_imu_archive.h"
+
+#define IMU_DATASET_ARCHIVES (8) /* archives one dataset may hold open */
+
+/**
+ * @brief one recording
+ * @param path: text file, NULL for a recording of an archive
+ * @param archive, index: the archive and the recording in it
+ * @param label: activity, the name of the directory holding the file
+ * @param name: file name without the directory
+ */
+typedef struct ImuDatasetEntry {
+    char *path;
+    uint16_t archive;
+    uint32_t index;
+    char label[IMU_ARCHIVE_LABEL];
+    char name[IMU_ARCHIVE_NAME];
+} ImuDatasetEntry;
+
+/**
+ * @brief recordings in the order they were added, the archives stay
+ * mapped until imu_dataset_free()
+ */
+typedef struct ImuDataset {
+    ImuDatasetEntry *entry;
+    uint32_t num;
+    uint32_t cap;
+    ImuArchive archive[IMU_DATASET_ARCHIVES];
+    uint16_t archive_num;
+} ImuDataset;
+
+void imu_dataset_init(ImuDataset *set);
+
+/**
+ * @brief add the recordings at path: a directory is searched recursively
+ * for *.txt files but ReadMe.txt, in sorted path order
+ */
+AlgoError imu_dataset_add(ImuDataset *set, const char *path);
+
+/**
+ * @brief frames of recording i. A text file is loaded into store, which
+ * keeps its arrays for the next one, a recording of an archive is read in
+ * place.
+ * @param store: from imu_recording_init(store, NULL, 0), freed by the caller
+ * @param rec: set to the frames, valid until store is reused or freed
+ * @param line: as for imu_recording_parse(), may be NULL
+ */
+AlgoError imu_dataset_recording(const ImuDataset *set, uint32_t i,
+                                ImuRecording *store, ImuRecording *rec,
+                                uint32_t *line);
+
+void imu_dataset_free(ImuDataset *set);
+
+/**
+ * @brief class of an activity label in the 5 or the 11 class network, -1
+ * for an unknown label. The 5 classes follow python.ipynb, the 11 classes
+ * are IMU_ACT_* - 1.
+ */
+int imu_activity_class(const char *label, int classes);
+
+#endif
@@ -0,0 +1,312 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_imu_loader.c
+ * @brief host loader of IMU_Dataset recordings
+ */
+
+#include "alg_imu_loader.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IMU_LOADER_MMAP (1)
+#else
+#define IMU_LOADER_MMAP (0)
+#endif
+
+// shortest line: six one digit values, empty timestamp and the newline
+#define IMU_LINE_MIN (IMU_AXES + IMU_COLUMNS)
+// more digits could overflow the scanner, no int16_t value needs them
+#define IMU_DIGITS_MAX (9)
+#define IMU_GROW_MIN (1024)
+
+static void set_axes(ImuRecording *rec)
+{
+    if (!rec->buf) {
+        rec->gyro_x = rec->gyro_y = rec->gyro_z = NULL;
+        rec->x = rec->y = rec->z = NULL;
+        return;
+    }
+    rec->gyro_x = rec->buf;
+    rec->gyro_y = rec->buf + rec->cap;
+    rec->gyro_z = rec->buf + 2 * (size_t)rec->cap;
+    rec->x      = rec->buf + 3 * (size_t)rec->cap;
+    rec->y      = rec->buf + 4 * (size_t)rec->cap;
+    rec->z      = rec->buf + 5 * (size_t)rec->cap;
+}
+
+AlgoError imu_recording_init(ImuRecording *rec, int16_t *buf, uint32_t cap)
+{
+    if (!rec) {
+        return ALGO_ERR_GENERIC;
+    }
+    memset(rec, 0, sizeof(ImuRecording));
+    rec->owned = buf == NULL;
+    rec->cap   = buf ? cap : 0;
+    rec->buf   = buf;
+    set_axes(rec);
+    return ALGO_NORMAL;
+}
+
+AlgoError imu_recording_reserve(ImuRecording *rec, uint32_t frames)
+{
+    int16_t *buf = NULL;
+    int16_t *old = NULL;
+    size_t bytes = 0;
+    uint16_t i   = 0;
+
+    if (!rec) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (frames <= rec->cap) {
+        return ALGO_NORMAL;
+    }
+    bytes = (size_t)frames * IMU_AXES * sizeof(int16_t);
+    if (!rec->owned || bytes / (IMU_AXES * sizeof(int16_t)) != frames) {
+        return ALGO_ERR_GENERIC;
+    }
+    buf = malloc(bytes);
+    if (!buf) {
+        return ALGO_ERR_GENERIC;
+    }
+    for (i = 0; i < IMU_AXES && rec->len > 0; i++) {
+        memcpy(buf + (size_t)i * frames, rec->buf + (size_t)i * rec->cap,
+               rec->len * sizeof(int16_t));
+    }
+    old      = rec->buf;
+    rec->buf = buf;
+    rec->cap = frames;
+    set_axes(rec);
+    free(old);
+    return ALGO_NORMAL;
+}
+
+static const char *skip_blank(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief scan an optionally signed integer and the blanks around it
+ * @param digits: number of digits, 0 for an empty column
+ * @return the character after it, NULL for a sign without digits or too
+ * many digits
+ */
+static const char *scan_int(const char *p, const char *end, int32_t *value,
+                            uint32_t *digits)
+{
+    const char *start = NULL;
+    uint32_t v = 0, d = 0, neg = 0;
+
+    p     = skip_blank(p, end);
+    neg   = p < end && *p == '-';
+    p    += neg;
+    start = p;
+    while (p < end && (d = (uint32_t)(uint8_t)*p - '0') < 10) {
+        v = v * 10 + d;
+        p++;
+    }
+    *digits = (uint32_t)(p - start);
+    if ((neg && *digits == 0) || *digits > IMU_DIGITS_MAX) {
+        return NULL;
+    }
+    // two's complement negate without a branch
+    *value = (int32_t)((v ^ (0u - neg)) + neg);
+    return skip_blank(p, end);
+}
+
+AlgoError imu_recording_parse(ImuRecording *rec, const char *text,
+                              size_t size, uint32_t *line)
+{
+    const char *p   = text;
+    const char *end = text + size;
+    int32_t value[IMU_COLUMNS];
+    uint32_t digits = 0, line_num = 0, n = 0;
+    uint16_t col = 0;
+
+    if (line) {
+        *line = 0;
+    }
+    if (!rec || (!text && size > 0)) {
+        return ALGO_ERR_GENERIC;
+    }
+    n = rec->len;
+    while (p < end) {
+        line_num++;
+        p = skip_blank(p, end);
+        if (p < end && (*p == '\r' || *p == '\n')) {
+            p += *p == '\r' && p + 1 < end && p[1] == '\n';
+            p++;
+            continue;
+        }
+        if (p == end) {
+            break;
+        }
+        for (col = 0; col < IMU_COLUMNS; col++) {
+            p = scan_int(p, end, &value[col], &digits);
+            // only the timestamp columns may be empty
+            if (!p || (digits == 0 && col < IMU_AXES) ||
+                (col < IMU_AXES &&
+                 (uint32_t)(value[col] + 32768) > UINT16_MAX)) {
+                goto bad_line;
+            }
+            if (col < IMU_COLUMNS - 1) {
+                if (p == end || *p != ',') {
+                    goto bad_line;
+                }
+                p++;
+            }
+        }
+        if (p < end && *p == '\r') {
+            p++;
+        }
+        if (p < end && *p++ != '\n') {
+            goto bad_line;
+        }
+        if (n == rec->cap &&
+            imu_recording_reserve(rec, rec->cap > IMU_GROW_MIN / 2
+                                           ? 2 * rec->cap
+                                           : IMU_GROW_MIN) != ALGO_NORMAL) {
+            goto bad_line;
+        }
+        rec->gyro_x[n] = (int16_t)value[0];
+        rec->gyro_y[n] = (int16_t)value[1];
+        rec->gyro_z[n] = (int16_t)value[2];
+        rec->x[n]      = (int16_t)value[3];
+        rec->y[n]      = (int16_t)value[4];
+        rec->z[n]      = (int16_t)value[5];
+        rec->len       = ++n;
+    }
+    return ALGO_NORMAL;
+
+bad_line:
+    if (line) {
+        *line = line_num;
+    }
+    return ALGO_ERR_GENERIC;
+}
+
+#if IMU_LOADER_MMAP
+
+AlgoError imu_recording_load(ImuRecording *rec, const char *path,
+                             uint32_t *line)
+{
+    struct stat st;
+    void *text    = NULL;
+    AlgoError ret = ALGO_NORMAL;
+    int fd        = -1;
+
+    if (line) {
+        *line = 0;
+    }
+    if (!rec || !path) {
+        return ALGO_ERR_GENERIC;
+    }
+    rec->len = 0;
+    fd       = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < 0 ||
+        (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return ALGO_ERR_GENERIC;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return ALGO_NORMAL;
+    }
+    text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        return ALGO_ERR_GENERIC;
+    }
+    madvise(text, (size_t)st.st_size, MADV_SEQUENTIAL);
+    // one allocation big enough for the shortest possible lines
+    if (rec->owned && (uint64_t)st.st_size / IMU_LINE_MIN < UINT32_MAX) {
+        ret = imu_recording_reserve(
+            rec, (uint32_t)((uint64_t)st.st_size / IMU_LINE_MIN + 1));
+    }
+    if (ret == ALGO_NORMAL) {
+        ret = imu_recording_parse(rec, text, (size_t)st.st_size, line);
+    }
+    munmap(text, (size_t)st.st_size);
+    return ret;
+}
+
+#else
+
+AlgoError imu_recording_load(ImuRecording *rec, const char *path,
+                             uint32_t *line)
+{
+    FILE *fp      = NULL;
+    char *text    = NULL;
+    long size     = 0;
+    AlgoError ret = ALGO_ERR_GENERIC;
+
+    if (line) {
+        *line = 0;
+    }
+    if (!rec || !path) {
+        return ALGO_ERR_GENERIC;
+    }
+    rec->len = 0;
+    if ((fp = fopen(path, "rb")) == NULL) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 &&
+        fseek(fp, 0, SEEK_SET) == 0 &&
+        (text = malloc(size > 0 ? (size_t)size : 1)) != NULL &&
+        fread(text, 1, (size_t)size, fp) == (size_t)size) {
+        ret = ALGO_NORMAL;
+        if (rec->owned) {
+            ret = imu_recording_reserve(rec,
+                                        (uint32_t)(size / IMU_LINE_MIN + 1));
+        }
+        if (ret == ALGO_NORMAL) {
+            ret = imu_recording_parse(rec, text, (size_t)size, line);
+        }
+    }
+    free(text);
+    fclose(fp);
+    return ret;
+}
+
+#endif
+
+AlgoError imu_recording_window(const ImuRecording *rec, uint32_t start,
+                               uint16_t frame_num, AccInput *acc_input)
+{
+    if (!rec || !acc_input || start > rec->len ||
+        frame_num > rec->len - start) {
+        return ALGO_ERR_GENERIC;
+    }
+    acc_input->len    = frame_num;
+    acc_input->gyro_x = rec->gyro_x + start;
+    acc_input->gyro_y = rec->gyro_y + start;
+    acc_input->gyro_z = rec->gyro_z + start;
+    acc_input->x      = rec->x + start;
+    acc_input->y      = rec->y + start;
+    acc_input->z      = rec->z + start;
+    acc_input->stride = 1;
+    return ALGO_NORMAL;
+}
+
+void imu_recording_free(ImuRecording *rec)
+{
+    if (!rec) {
+        return;
+    }
+    if (rec->owned) {
+        free(rec->buf);
+        imu_recording_init(rec, NULL, 0);
+    }
+}
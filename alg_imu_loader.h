@@ -0,0 +1,89 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_imu_loader.h
+ * @brief host loader of IMU_Dataset recordings. A recording has one frame
+ * per line and 8 comma separated columns: gyro_x, gyro_y, gyro_z, x, y, z
+ * and the two 16-bit halves of a timestamp, which may be empty and are not
+ * kept. Blanks around values and blank lines are allowed.
+ */
+
+#ifndef __ALG_IMU_LOADER_H_
+#define __ALG_IMU_LOADER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "alg_step_counter.h"
+
+#define IMU_COLUMNS (8) /* columns per line */
+#define IMU_AXES    (6) /* columns kept, one array each */
+
+/**
+ * @brief a recording as one array per axis
+ * @param len: frames loaded
+ * @param cap: frames each array holds
+ * @param owned: the arrays are allocated here and grow as needed; caller
+ * arrays never grow and a longer recording is an error
+ * @param buf: the six arrays back to back, cap frames each
+ */
+typedef struct ImuRecording {
+    uint32_t len;
+    uint32_t cap;
+    int16_t *gyro_x;
+    int16_t *gyro_y;
+    int16_t *gyro_z;
+    int16_t *x;
+    int16_t *y;
+    int16_t *z;
+    int16_t *buf;
+    uint8_t owned;
+} ImuRecording;
+
+/**
+ * @brief set up an empty recording
+ * @param buf: IMU_AXES * cap int16_t owned by the caller, or NULL to
+ * allocate on demand
+ * @param cap: frames per axis in buf, ignored without buf
+ */
+AlgoError imu_recording_init(ImuRecording *rec, int16_t *buf, uint32_t cap);
+
+/**
+ * @brief make room for at least frames frames, keeping the loaded ones
+ * @return ALGO_ERR_GENERIC when the caller buffer is too small or
+ * allocation fails
+ */
+AlgoError imu_recording_reserve(ImuRecording *rec, uint32_t frames);
+
+/**
+ * @brief append the frames of size bytes of text, which needs no
+ * terminating NUL
+ * @param line: set to the 1-based line of the first bad line, 0 otherwise;
+ * may be NULL
+ * @return ALGO_ERR_GENERIC on a line without IMU_COLUMNS columns, a value
+ * that is not an integer or outside int16_t, or when out of room. The
+ * frames before the bad line are kept.
+ */
+AlgoError imu_recording_parse(ImuRecording *rec, const char *text,
+                              size_t size, uint32_t *line);
+
+/**
+ * @brief replace the frames of rec by those of the file at path, which is
+ * mapped rather than read where the host supports mmap()
+ * @param line: as for imu_recording_parse()
+ */
+AlgoError imu_recording_load(ImuRecording *rec, const char *path,
+                             uint32_t *line);
+
+/**
+ * @brief point acc_input at frame_num frames of rec from start, read in
+ * place
+ */
+AlgoError imu_recording_window(const ImuRecording *rec, uint32_t start,
+                               uint16_t frame_num, AccInput *acc_input);
+
+/**
+ * @brief release the arrays allocated for rec, caller arrays are left alone
+ */
+void imu_recording_free(ImuRecording *rec);
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_profile.h
+ * @brief per stage cycle counts of the step counter pipeline. Everything
+ * compiles to nothing unless ALG_PROFILE is 1.
+ */
+
+#ifndef __ALG_PROFILE_H_
+#define __ALG_PROFILE_H_
+
+#include <stdint.h>
+
+#ifndef ALG_PROFILE
+#define ALG_PROFILE (0)
+#endif
+
+#if ALG_PROFILE
+#if defined(__riscv)
+#include "platform.h"
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+/* profiled stages, the peak stages are one per window axis */
+typedef enum AlgProfileStage {
+    PROFILE_WINDOW = 0, /* step_counter_ctx_process() as a whole */
+    PROFILE_PREPROCESS, /* acc_data_preprocess() */
+    PROFILE_STATISTICS, /* window sums and statistics */
+    PROFILE_PEAK_GX,    /* peak detection of one axis */
+    PROFILE_PEAK_GY,
+    PROFILE_PEAK_GZ,
+    PROFILE_PEAK_AX,
+    PROFILE_PEAK_AY,
+    PROFILE_PEAK_AZ,
+    PROFILE_NETWORK,     /* foward_process() */
+    PROFILE_NET_LAYER1,  /* linner_layer1 and ReLU */
+    PROFILE_NET_LAYER2,  /* linner_layer2 */
+    PROFILE_NET_POOL,    /* max_pool and argmax */
+    PROFILE_STEP_SELECT, /* step count from the axes and the class */
+    PROFILE_STAGE_NUM,
+} AlgProfileStage;
+
+/**
+ * @brief counters of one stage
+ * @param count: number of runs
+ * @param over: runs above budget, budget 0 is no budget
+ * @param cycles: sum over all runs, so cycles / count is the mean
+ * @param instret: retired instructions over all runs where the core
+ * counts them (mcycle/minstret on RISC-V), 0 on hosts
+ * @param min, max: of a single run
+ */
+typedef struct AlgProfileStat {
+    uint32_t count;
+    uint32_t over;
+    uint64_t cycles;
+    uint64_t instret;
+    uint32_t min;
+    uint32_t max;
+    uint32_t budget;
+} AlgProfileStat;
+
+typedef struct AlgProfile {
+    AlgProfileStat stage[PROFILE_STAGE_NUM];
+} AlgProfile;
+
+typedef struct AlgProfileMark {
+    uint64_t cycle;
+    uint64_t instret;
+} AlgProfileMark;
+
+/**
+ * @brief name of a stage, e.g. "preprocess"
+ */
+const char *alg_profile_name(AlgProfileStage stage);
+
+#if ALG_PROFILE
+
+/* cycles are TSC ticks on x86 hosts and nanoseconds on other hosts */
+static inline AlgProfileMark alg_profile_now(void)
+{
+    AlgProfileMark mark;
+#if defined(__riscv)
+    mark.cycle   = __get_rv_cycle();
+    mark.instret = __get_rv_instret();
+#elif defined(__x86_64__) || defined(__i386__)
+    mark.cycle   = __rdtsc();
+    mark.instret = 0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    mark.cycle   = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    mark.instret = 0;
+#endif
+    return mark;
+}
+
+/**
+ * @brief add the run that started at begin to stage. Not reentrant.
+ */
+void alg_profile_add(AlgProfileStage stage, const AlgProfileMark *begin);
+
+#define ALG_PROFILE_BEGIN(mark) AlgProfileMark mark = alg_profile_now()
+#define ALG_PROFILE_END(stage, mark) alg_profile_add((stage), &(mark))
+
+#else
+
+#define ALG_PROFILE_BEGIN(mark)      ((void)0)
+#define ALG_PROFILE_END(stage, mark) ((void)0)
+
+#endif
+
+/**
+ * @brief copy the counters
+ * @return 0 on success, -1 when ALG_PROFILE is off
+ */
+int alg_profile_get(AlgProfile *profile);
+
+/**
+ * @brief clear the counters, budgets are kept
+ */
+void alg_profile_reset(void);
+
+/**
+ * @brief count runs of stage above cycles as over budget, 0 clears it
+ * @return 0 on success, -1 when ALG_PROFILE is off or stage is invalid
+ */
+int alg_profile_set_budget(AlgProfileStage stage, uint32_t cycles);
+
+#endif
@@ -4,10 +4,23 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <math.h>
+#include "alg_window_stats.h"
+#include "alg_profile.h"
 #define ACC_FS (25)
 
+/**
+ * @brief when set, the algorithm never calls malloc()/free(); any use in
+ * alg_step_counter.c is rejected at compile time
+ */
+#ifndef STEP_COUNTER_ZERO_HEAP
+#define STEP_COUNTER_ZERO_HEAP (1)
+#endif
+
 /**
  * @brief the struct of input data
+ * @param stride: distance between two samples of one axis in int16_t, 0 and 1
+ * both mean six separate arrays; use acc_input_from_frames() to read packed
+ * frames in place
  */
 typedef struct AccInput {
     uint16_t len;
@@ -17,23 +30,285 @@ typedef struct AccInput {
     int16_t *gyro_x;
     int16_t *gyro_y;
     int16_t *gyro_z;
+    uint16_t stride;
 } AccInput;
 
 /**
  * @brief error code
  */
-typedef enum AlgoError { ALGO_NORMAL = 0, ALGO_ERR_GENERIC = 1 } AlgoError;
+typedef enum AlgoError {
+    ALGO_NORMAL      = 0,
+    ALGO_ERR_GENERIC = 1,
+    ALGO_ERR_FULL    = 2, /* a bounded queue is full, retrying may succeed */
+} AlgoError;
+
+// buffer size to save historical data
+#define BUF_SEC (3)
+#define BUF_LEN (BUF_SEC * ACC_FS)
+// window size to save new data, the classifier is trained on 5 s windows
+#ifndef WIN_SEC
+#define WIN_SEC (5)
+#endif
+#define WIN_LEN (WIN_SEC * ACC_FS)
+// the total size to save data for each processing
+#define BUF_WIN_LEN (BUF_LEN + WIN_LEN)
+
+#define MEAN_LEN1 (11)
+
+// classifier inputs per window
+#define STEP_FEATURE_NUM (20)
+
+/**
+ * @brief a classifier input, an integer when ALG_FIXED_POINT is 1 (the peak
+ * interval ones Q(NETWORKS_LAMBDA_FRAC))
+ */
+#if ALG_FIXED_POINT
+typedef int32_t FeatureValue;
+#else
+typedef float FeatureValue;
+#endif
+#define MEAN_LEN2 (5)
+// two peaks (or valleys) are never adjacent samples, so a buffer shorter than
+// BUF_WIN_LEN never holds more than this many of either
+#define PEAK_VALLEY_NUM (BUF_WIN_LEN / 2)
+// samples kept before the last valley when the history is carried over
+#define LEFT_DATA_NUM (2)
+
+/**
+ * @brief for store the peaks/valleys number, locations and values
+ * @param p_cnt: peak number
+ * @param v_cnt: valley number
+ * @param p_loc: peak locations
+ * @param v_loc: valley locations
+ * @param p_val: sample value at each peak
+ * @param v_val: sample value at each valley
+ */
+typedef struct PeakValley {
+    uint16_t p_cnt;
+    uint16_t v_cnt;
+    uint16_t *p_loc;
+    uint16_t *v_loc;
+    int16_t *p_val;
+    int16_t *v_val;
+} PeakValley;
 
 /**
- * @brief initialize global variables for step counter algorithm
+ * @brief incremental peak/valley detector of one axis. Samples are pushed one
+ * at a time and every local extremum is recorded with its value, so closing
+ * a window prunes these candidates without touching the samples again. Only
+ * the part after the last valid valley is carried into the next buffer.
+ *
+ * Peaks are confirmed, and their steps counted, only when the window
+ * closes: the false-peak test compares each candidate with the mean of the
+ * whole buffer and the activity gate uses its range, so accepting a peak as
+ * soon as its right valley arrives would change the step counts. The state
+ * is bounded by the buffer, not O(1): up to PEAK_VALLEY_NUM candidates per
+ * list, and the candidates of the carried tail (under BUF_LEN samples) are
+ * kept for the next window to prune again.
+ * @param cnt: samples in the current buffer, carried tail plus new samples
+ * @param sum: sum of those samples
+ * @param first: first sample of the buffer
+ * @param last: the newest LEFT_DATA_NUM + 2 samples, newest last
+ * @param p_cnt, p_loc, p_val: raw peaks of the buffer
+ * @param v_cnt, v_loc, v_val: raw valleys of the buffer
+ * @param v_head_sum: sum of the samples before v_loc - LEFT_DATA_NUM, i.e.
+ * what is dropped when the next buffer starts there
+ * @param v_head_val: sample at v_loc - LEFT_DATA_NUM
+ * @param base: absolute index of the first sample of the buffer
+ * @param counted: absolute index where the slot of the next window starts.
+ * Overlapping windows report only the peaks of their own slot, so a peak
+ * seen by several of them is counted once.
+ */
+typedef struct PeakValleyStream {
+    uint16_t cnt;
+    int32_t sum;
+    int16_t first;
+    int16_t last[LEFT_DATA_NUM + 2];
+    uint16_t p_cnt;
+    uint16_t v_cnt;
+    uint16_t p_loc[PEAK_VALLEY_NUM];
+    int16_t p_val[PEAK_VALLEY_NUM];
+    uint16_t v_loc[PEAK_VALLEY_NUM];
+    int16_t v_val[PEAK_VALLEY_NUM];
+    int32_t v_head_sum[PEAK_VALLEY_NUM];
+    int16_t v_head_val[PEAK_VALLEY_NUM];
+    uint32_t base;
+    uint32_t counted;
+} PeakValleyStream;
+
+/**
+ * @brief struct for storing acceleration data
+ */
+typedef struct AccData {
+    uint16_t len;
+    uint16_t x_cnt;
+    uint16_t y_cnt;
+    uint16_t z_cnt;
+    int16_t *x;
+    int16_t *y;
+    int16_t *z;
+    uint16_t x_gyro_cnt;
+    uint16_t y_gyro_cnt;
+    uint16_t z_gyro_cnt;
+    int16_t *gyro_x;
+    int16_t *gyro_y;
+    int16_t *gyro_z;
+} AccData;
+
+typedef struct AccDataHub {
+    AccData win;
+} AccDataHub;
+
+/**
+ * @brief struct for storing mean filter parameters and data
+ * @param sum: running sum of the samples currently held in buf
+ */
+typedef struct MeanFilter {
+    uint16_t len;
+    uint16_t index;
+    int16_t *buf;
+    uint16_t buf_full;
+    int32_t sum;
+} MeanFilter;
+
+typedef struct MeanFilterGroup {
+    MeanFilter f1;
+    MeanFilter f2;
+} MeanFilterGroup;
+
+typedef struct MeanFilterHub {
+    MeanFilterGroup gyro_x;
+    MeanFilterGroup gyro_y;
+    MeanFilterGroup gyro_z;
+    MeanFilterGroup x;
+    MeanFilterGroup y;
+    MeanFilterGroup z;
+} MeanFilterHub;
+
+/**
+ * @brief all state of one step counter stream, about 12 KB. It is placed by
+ * the caller (static, stack or heap) and must not be moved or copied after
+ * step_counter_ctx_init() because it holds pointers into itself. Different
+ * contexts share no mutable state and can be processed in parallel.
+ * @param hop: new samples between two results, the analysis window is always
+ * WIN_LEN long and overlaps the previous one by WIN_LEN - hop
+ * @param win_new: samples at the end of the window not consumed yet
+ * @param win_sums_valid: win_sums covers the consumed part of the window
+ * @param win_sums: sums of the consumed part, [0] accel and [1] gyro
+ * @param step_rem: remainder of the last robust mean, carried while
+ * hop < WIN_LEN
+ */
+typedef struct StepCounterCtx {
+    AccDataHub acc_data_hub;
+    MeanFilterHub mean_filter_hub;
+    PeakValley peak_valley;
+    uint16_t peak_loc[PEAK_VALLEY_NUM];
+    uint16_t valley_loc[PEAK_VALLEY_NUM];
+    int16_t peak_val[PEAK_VALLEY_NUM];
+    int16_t valley_val[PEAK_VALLEY_NUM];
+    // axis order: gyro_x, gyro_y, gyro_z, x, y, z
+    PeakValleyStream peak_stream[6];
+    int16_t win_data[6][WIN_LEN];
+    int16_t filter1_buf[6][MEAN_LEN1];
+    int16_t filter2_buf[6][MEAN_LEN2];
+    uint16_t hop;
+    uint16_t win_new;
+    uint8_t win_sums_valid;
+    TripleSums win_sums[2];
+    uint16_t step_rem;
+} StepCounterCtx;
+
+/**
+ * @brief result of one step_counter_ctx_process() call
+ * @param step_num: the step counting results
+ * @param class: classifier output for the window, -1 if no window completed
+ * @param feature: the classifier input of the window, set with class
+ */
+typedef struct StepCounterOutput {
+    uint16_t step_num;
+    int16_t class;
+    FeatureValue feature[STEP_FEATURE_NUM];
+} StepCounterOutput;
+
+/**
+ * @brief step_counter_ctx_init() for the context behind
+ * step_counter_process(), a StepCounterCtx owned by alg_step_counter.c.
+ * Streams processed in parallel each need their own context instead.
  */
 AlgoError step_counter_init(void);
 
 /**
- * @brief obtain step counts for current input data
+ * @brief step_counter_ctx_process() on the context behind
+ * step_counter_init(), without the class and features of the window
  * @param acc_input: input data
  * @param step_num: the step counting results
  */
 AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num);
 
+/**
+ * @brief step_counter_ctx_set_hop() for the context behind
+ * step_counter_process(), call it after step_counter_init()
+ */
+AlgoError step_counter_set_hop(uint16_t hop);
+
+/**
+ * @brief initialize a step counter context
+ * @param ctx: the context to initialize
+ */
+AlgoError step_counter_ctx_init(StepCounterCtx *ctx);
+
+/**
+ * @brief obtain step counts for current input data of one stream
+ * @param ctx: the context of the stream
+ * @param acc_input: input data
+ * @param output: the step counting and classification results
+ */
+AlgoError step_counter_ctx_process(StepCounterCtx *ctx, AccInput *acc_input,
+                                   StepCounterOutput *output);
+
+/**
+ * @brief produce a result every hop samples instead of every WIN_LEN. The
+ * first result still needs a full window, later ones reuse the newest
+ * WIN_LEN - hop samples. Each window reports the peaks of the hop samples
+ * in its middle, so steps come (WIN_LEN - hop) / 2 samples late.
+ *
+ * Step totals differ from those of the default hop. Each window rounds its
+ * robust mean down to whole steps; with a short hop the remainder is kept
+ * for the next window, as a hop sees only a step or two, and totals come
+ * out higher. Over IMU_Dataset the totals are 11337 at the default hop,
+ * 12041 at hop ACC_FS and 12042 at 2 * ACC_FS. Keeping the remainder at the
+ * default hop as well gives 11966. Single activities move further and not
+ * all the same way, at hop ACC_FS walk +16% and sit -9%: a peak is judged
+ * against the mean and range of another window, and the class of every
+ * window picks how its steps are counted.
+ * @param hop: multiple of ACC_FS in [ACC_FS, WIN_LEN], WIN_LEN by default
+ */
+AlgoError step_counter_ctx_set_hop(StepCounterCtx *ctx, uint16_t hop);
+
+/**
+ * @brief per stage cycle counters of all contexts since the last reset,
+ * collected only when the build sets ALG_PROFILE to 1
+ * @param profile: receives the counters, all zero without ALG_PROFILE
+ * @return ALGO_ERR_GENERIC when profiling is not built in
+ */
+AlgoError step_counter_get_profile(AlgProfile *profile);
+
+/**
+ * @brief clear the per stage cycle counters, budgets set with
+ * alg_profile_set_budget() are kept
+ */
+void step_counter_reset_profile(void);
+
+/**
+ * @brief point acc_input at packed frames laid out as gyro_x, gyro_y,
+ * gyro_z, x, y, z (int16_t each, e.g. ImuGyroAccelData) so that they are
+ * read in place
+ * @param frames: the first frame
+ * @param frame_num: number of frames
+ * @param frame_size: bytes from one frame to the next, even and at least
+ * 6 * sizeof(int16_t)
+ */
+AlgoError acc_input_from_frames(AccInput *acc_input, int16_t *frames,
+                                uint16_t frame_num, uint16_t frame_size);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,517 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_stream_engine.c
+ * @brief sharded multi-stream step counter. The queue of a worker is a
+ * bounded ring of slots with a sequence number each: producers claim a
+ * slot with a compare and swap on the tail and publish it by advancing its
+ * sequence, the worker alone consumes from the head. A worker with nothing
+ * to do sleeps on a condition variable that producers signal only when it
+ * has said it is asleep.
+ */
+
+#include "alg_stream_engine.h"
+#include "alg_task_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STREAM_HEAD       (ACC_FS - 5 - 2) /* frames of the first chunk */
+#define STREAM_AXES       (6)              /* int16_t per packed frame */
+#define STREAM_TABLE_MIN  (64)             /* device slots at first, 2^n */
+#define STREAM_CACHE_LINE (64)
+
+/**
+ * @brief one submission
+ * @param frame_num: frames in frame, 0 ends the stream of the device
+ * @param submit_ns: when it was submitted, for the latency
+ */
+typedef struct StreamJob {
+    uint64_t device_id;
+    uint64_t submit_ns;
+    uint16_t frame_num;
+    int16_t frame[STREAM_ENGINE_FRAMES * STREAM_AXES];
+} StreamJob;
+
+/* seq is the position the slot is free for, or that position + 1 once the
+ * job in it is published */
+typedef struct StreamSlot {
+    atomic_size_t seq;
+    StreamJob job;
+} StreamSlot;
+
+/**
+ * @brief a device stream, its context must not move once initialized
+ * @param pending: frames in frame not processed yet, less than a chunk
+ * @param frames: frames processed
+ */
+typedef struct StreamDevice {
+    uint64_t id;
+    uint64_t frames;
+    uint16_t pending;
+    int16_t frame[ACC_FS * STREAM_AXES];
+    StepCounterCtx ctx;
+} StreamDevice;
+
+/**
+ * @brief a worker, its queue and the devices it owns. tail is written by
+ * producers and head by the worker only, on separate cache lines.
+ * @param table: open addressing on the device ID hash, linear probing,
+ * table_cap slots, touched by the worker only
+ */
+typedef struct StreamWorker {
+    _Alignas(STREAM_CACHE_LINE) atomic_size_t tail;
+    atomic_uint_fast64_t submitted;
+    atomic_uint_fast64_t rejected;
+    _Alignas(STREAM_CACHE_LINE) size_t head;
+    atomic_uint_fast64_t done;
+    atomic_uint_fast64_t chunks;
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t dropped;
+    atomic_uint device_num;
+    atomic_int sleeping;
+    StreamSlot *slot;
+    StreamDevice **table;
+    uint32_t table_cap;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    uint8_t started;
+    uint16_t id;
+    StreamEngine *engine;
+} StreamWorker;
+
+struct StreamEngine {
+    StreamWorker *worker;
+    uint16_t worker_num;
+    StreamEngineCallback callback;
+    void *user;
+    atomic_int stop;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// splitmix64 finalizer, the high half picks the worker and the low half
+// the table slot
+static uint64_t device_hash(uint64_t id)
+{
+    id = (id ^ (id >> 30)) * 0xBF58476D1CE4E5B9ull;
+    id = (id ^ (id >> 27)) * 0x94D049BB133111EBull;
+    return id ^ (id >> 31);
+}
+
+uint16_t stream_engine_worker(const StreamEngine *engine, uint64_t device_id)
+{
+    return (uint16_t)((device_hash(device_id) >> 32) % engine->worker_num);
+}
+
+/* slot of device_id, or of the empty slot where it would go */
+static uint32_t table_find(const StreamWorker *worker, uint64_t device_id)
+{
+    uint32_t mask = worker->table_cap - 1;
+    uint32_t i    = (uint32_t)device_hash(device_id) & mask;
+
+    while (worker->table[i] && worker->table[i]->id != device_id) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static AlgoError table_grow(StreamWorker *worker)
+{
+    StreamDevice **old = worker->table;
+    uint32_t old_cap   = worker->table_cap, i = 0;
+    uint32_t cap = old_cap > 0 ? 2 * old_cap : STREAM_TABLE_MIN;
+
+    worker->table = calloc(cap, sizeof(StreamDevice *));
+    if (!worker->table) {
+        worker->table = old;
+        return ALGO_ERR_GENERIC;
+    }
+    worker->table_cap = cap;
+    for (i = 0; i < old_cap; i++) {
+        if (old[i]) {
+            worker->table[table_find(worker, old[i]->id)] = old[i];
+        }
+    }
+    free(old);
+    return ALGO_NORMAL;
+}
+
+// the device of device_id, created on its first frames
+static StreamDevice *device_get(StreamWorker *worker, uint64_t device_id)
+{
+    StreamDevice *device = NULL;
+    uint32_t num = atomic_load_explicit(&worker->device_num,
+                                        memory_order_relaxed);
+    uint32_t i   = 0;
+
+    if (worker->table_cap > 0) {
+        i = table_find(worker, device_id);
+        if (worker->table[i]) {
+            return worker->table[i];
+        }
+    }
+    // at most 3/4 full so that probes stay short
+    if ((num + 1) * 4 > worker->table_cap * 3 &&
+        table_grow(worker) != ALGO_NORMAL) {
+        return NULL;
+    }
+    device = malloc(sizeof(StreamDevice));
+    if (!device || step_counter_ctx_init(&device->ctx) != ALGO_NORMAL) {
+        free(device);
+        return NULL;
+    }
+    device->id      = device_id;
+    device->frames  = 0;
+    device->pending = 0;
+    worker->table[table_find(worker, device_id)] = device;
+    atomic_store_explicit(&worker->device_num, num + 1,
+                          memory_order_relaxed);
+    return device;
+}
+
+// free the device of device_id and close the gap it leaves in its probe run
+static void device_end(StreamWorker *worker, uint64_t device_id)
+{
+    uint32_t mask = worker->table_cap - 1, i = 0, j = 0, home = 0;
+
+    if (worker->table_cap == 0) {
+        return;
+    }
+    i = table_find(worker, device_id);
+    if (!worker->table[i]) {
+        return;
+    }
+    free(worker->table[i]);
+    worker->table[i] = NULL;
+    atomic_fetch_sub_explicit(&worker->device_num, 1, memory_order_relaxed);
+    for (j = (i + 1) & mask; worker->table[j]; j = (j + 1) & mask) {
+        home = (uint32_t)device_hash(worker->table[j]->id) & mask;
+        // move back unless its home lies cyclically in (i, j]
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && home <= i && home > j)) {
+            worker->table[i] = worker->table[j];
+            worker->table[j] = NULL;
+            i                = j;
+        }
+    }
+}
+
+static void device_process(StreamWorker *worker, StreamDevice *device,
+                           uint64_t submit_ns)
+{
+    StreamEngine *engine = worker->engine;
+    StepCounterOutput output;
+    StreamResult result;
+    AccInput acc_input = { 0, NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+
+    acc_input_from_frames(&acc_input, device->frame, device->pending,
+                          STREAM_AXES * sizeof(int16_t));
+    if (step_counter_ctx_process(&device->ctx, &acc_input, &output) !=
+        ALGO_NORMAL) {
+        atomic_fetch_add_explicit(&worker->dropped, 1, memory_order_relaxed);
+        device->pending = 0;
+        return;
+    }
+    device->frames += device->pending;
+    atomic_fetch_add_explicit(&worker->chunks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&worker->frames, device->pending,
+                              memory_order_relaxed);
+    device->pending = 0;
+    if (engine->callback) {
+        result.device_id  = device->id;
+        result.frames     = device->frames;
+        result.step_num   = output.step_num;
+        result.class      = output.class;
+        result.latency_ns = now_ns() - submit_ns;
+        engine->callback(engine->user, worker->id, &result);
+    }
+}
+
+// append the frames of job to its device, processing every chunk completed
+static void job_run(StreamWorker *worker, const StreamJob *job)
+{
+    StreamDevice *device = NULL;
+    uint16_t i = 0, take = 0, chunk = 0;
+
+    if (job->frame_num == 0) {
+        device_end(worker, job->device_id);
+        return;
+    }
+    device = device_get(worker, job->device_id);
+    if (!device) {
+        atomic_fetch_add_explicit(&worker->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    while (i < job->frame_num) {
+        chunk = device->frames == 0 ? STREAM_HEAD : ACC_FS;
+        take  = chunk - device->pending;
+        if (take > job->frame_num - i) {
+            take = job->frame_num - i;
+        }
+        memcpy(device->frame + device->pending * STREAM_AXES,
+               job->frame + i * STREAM_AXES,
+               take * STREAM_AXES * sizeof(int16_t));
+        device->pending += take;
+        i += take;
+        if (device->pending == chunk) {
+            device_process(worker, device, job->submit_ns);
+        }
+    }
+}
+
+/* the next published slot of the worker, NULL when there is none yet */
+static StreamSlot *queue_peek(StreamWorker *worker)
+{
+    StreamSlot *slot = &worker->slot[worker->head & (STREAM_ENGINE_QUEUE - 1)];
+
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) ==
+                   worker->head + 1
+               ? slot
+               : NULL;
+}
+
+// claim the tail slot, copy the device ID and frame_num of job and the
+// frames into it and publish it
+static AlgoError queue_push(StreamWorker *worker, const StreamJob *job,
+                            const int16_t *frames, uint16_t frame_size)
+{
+    StreamSlot *slot = NULL;
+    size_t pos = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+    intptr_t diff = 0;
+    uint16_t i    = 0;
+
+    for (;;) {
+        slot = &worker->slot[pos & (STREAM_ENGINE_QUEUE - 1)];
+        diff = (intptr_t)atomic_load_explicit(&slot->seq,
+                                              memory_order_acquire) -
+               (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &worker->tail, &pos, pos + 1, memory_order_relaxed,
+                    memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the worker has not freed this slot yet, the queue is full
+            atomic_fetch_add_explicit(&worker->rejected, 1,
+                                      memory_order_relaxed);
+            return ALGO_ERR_FULL;
+        } else {
+            pos = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+        }
+    }
+    slot->job.device_id = job->device_id;
+    slot->job.frame_num = job->frame_num;
+    for (i = 0; i < job->frame_num; i++) {
+        memcpy(slot->job.frame + i * STREAM_AXES,
+               (const uint8_t *)frames + (size_t)i * frame_size,
+               STREAM_AXES * sizeof(int16_t));
+    }
+    slot->job.submit_ns = now_ns();
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&worker->submitted, 1, memory_order_relaxed);
+
+    // pairs with the fence in worker_sleep(): either the worker sees the
+    // slot or this sees it asleep
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&worker->sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&worker->lock);
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+    }
+    return ALGO_NORMAL;
+}
+
+static void worker_sleep(StreamWorker *worker)
+{
+    pthread_mutex_lock(&worker->lock);
+    atomic_store_explicit(&worker->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!queue_peek(worker) &&
+           !atomic_load_explicit(&worker->engine->stop,
+                                 memory_order_acquire)) {
+        pthread_cond_wait(&worker->wake, &worker->lock);
+    }
+    atomic_store_explicit(&worker->sleeping, 0, memory_order_relaxed);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static void *stream_worker(void *arg)
+{
+    StreamWorker *worker = arg;
+    StreamSlot *slot     = NULL;
+
+    for (;;) {
+        slot = queue_peek(worker);
+        if (!slot) {
+            if (atomic_load_explicit(&worker->engine->stop,
+                                     memory_order_acquire)) {
+                break;
+            }
+            worker_sleep(worker);
+            continue;
+        }
+        job_run(worker, &slot->job);
+        atomic_store_explicit(&slot->seq, worker->head + STREAM_ENGINE_QUEUE,
+                              memory_order_release);
+        worker->head++;
+        atomic_fetch_add_explicit(&worker->done, 1, memory_order_release);
+    }
+    return NULL;
+}
+
+StreamEngine *stream_engine_create(uint16_t worker_num,
+                                   StreamEngineCallback callback, void *user)
+{
+    StreamEngine *engine = calloc(1, sizeof(StreamEngine));
+    StreamWorker *worker = NULL;
+    uint32_t i = 0;
+    uint16_t w = 0;
+
+    if (!engine) {
+        return NULL;
+    }
+    if (worker_num == 0) {
+        worker_num = task_pool_cpu_num();
+    }
+    engine->worker = aligned_alloc(STREAM_CACHE_LINE,
+                                   worker_num * sizeof(StreamWorker));
+    if (!engine->worker) {
+        free(engine);
+        return NULL;
+    }
+    memset(engine->worker, 0, worker_num * sizeof(StreamWorker));
+    engine->callback = callback;
+    engine->user     = user;
+    atomic_init(&engine->stop, 0);
+    for (w = 0; w < worker_num; w++) {
+        worker         = &engine->worker[w];
+        worker->id     = w;
+        worker->engine = engine;
+        worker->slot   = malloc(STREAM_ENGINE_QUEUE * sizeof(StreamSlot));
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->wake, NULL);
+        engine->worker_num = w + 1;
+        if (!worker->slot) {
+            stream_engine_destroy(engine);
+            return NULL;
+        }
+        for (i = 0; i < STREAM_ENGINE_QUEUE; i++) {
+            atomic_init(&worker->slot[i].seq, i);
+        }
+        worker->started =
+            pthread_create(&worker->thread, NULL, stream_worker, worker) == 0;
+        if (!worker->started) {
+            stream_engine_destroy(engine);
+            return NULL;
+        }
+    }
+    return engine;
+}
+
+AlgoError stream_engine_submit(StreamEngine *engine, uint64_t device_id,
+                               const int16_t *frames, uint16_t frame_num,
+                               uint16_t frame_size)
+{
+    StreamJob job;
+
+    if (!engine || !frames || frame_num == 0 ||
+        frame_num > STREAM_ENGINE_FRAMES || frame_size % sizeof(int16_t) ||
+        frame_size < STREAM_AXES * sizeof(int16_t)) {
+        return ALGO_ERR_GENERIC;
+    }
+    job.device_id = device_id;
+    job.frame_num = frame_num;
+    return queue_push(&engine->worker[stream_engine_worker(engine, device_id)],
+                      &job, frames, frame_size);
+}
+
+AlgoError stream_engine_end(StreamEngine *engine, uint64_t device_id)
+{
+    StreamJob job;
+
+    if (!engine) {
+        return ALGO_ERR_GENERIC;
+    }
+    job.device_id = device_id;
+    job.frame_num = 0;
+    return queue_push(&engine->worker[stream_engine_worker(engine, device_id)],
+                      &job, NULL, 0);
+}
+
+void stream_engine_drain(StreamEngine *engine)
+{
+    struct timespec pause = { 0, 50000 };
+    uint64_t target = 0;
+    uint16_t w      = 0;
+
+    for (w = 0; w < engine->worker_num; w++) {
+        target = atomic_load_explicit(&engine->worker[w].submitted,
+                                      memory_order_relaxed);
+        while (atomic_load_explicit(&engine->worker[w].done,
+                                    memory_order_acquire) < target) {
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+void stream_engine_get_stats(const StreamEngine *engine,
+                             StreamEngineStats *stats)
+{
+    StreamWorker *worker = NULL;
+    uint16_t w           = 0;
+
+    memset(stats, 0, sizeof(StreamEngineStats));
+    for (w = 0; w < engine->worker_num; w++) {
+        worker = &engine->worker[w];
+        stats->submitted += atomic_load(&worker->submitted);
+        stats->rejected += atomic_load(&worker->rejected);
+        stats->chunks += atomic_load(&worker->chunks);
+        stats->frames += atomic_load(&worker->frames);
+        stats->dropped += atomic_load(&worker->dropped);
+        stats->devices += atomic_load(&worker->device_num);
+    }
+}
+
+void stream_engine_destroy(StreamEngine *engine)
+{
+    StreamWorker *worker = NULL;
+    uint32_t i           = 0;
+    uint16_t w           = 0;
+
+    if (!engine) {
+        return;
+    }
+    stream_engine_drain(engine);
+    atomic_store_explicit(&engine->stop, 1, memory_order_release);
+    for (w = 0; w < engine->worker_num; w++) {
+        worker = &engine->worker[w];
+        pthread_mutex_lock(&worker->lock);
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+    }
+    for (w = 0; w < engine->worker_num; w++) {
+        worker = &engine->worker[w];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+        }
+        for (i = 0; i < worker->table_cap; i++) {
+            free(worker->table[i]);
+        }
+        free(worker->table);
+        free(worker->slot);
+        pthread_mutex_destroy(&worker->lock);
+        pthread_cond_destroy(&worker->wake);
+    }
+    free(engine->worker);
+    free(engine);
+}
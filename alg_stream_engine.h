@@ -0,0 +1,107 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_stream_engine.h
+ * @brief step counter for many device streams in one process. Every device
+ * has its own StepCounterCtx and is owned by one worker thread, picked from
+ * its ID, so that its frames are processed in order and its context is
+ * never shared. Frames are submitted to the worker through a bounded lock
+ * free queue and results come back through a callback on that worker.
+ *
+ * Frames of a device are fed to step_counter_ctx_process() in main.c's
+ * chunks, ACC_FS - 5 - 2 frames first and then ACC_FS, however they are
+ * split over submissions. networks_init() must have been called.
+ */
+
+#ifndef __ALG_STREAM_ENGINE_H_
+#define __ALG_STREAM_ENGINE_H_
+
+#include <stdint.h>
+#include "alg_step_counter.h"
+
+#define STREAM_ENGINE_FRAMES (ACC_FS) /* frames per submission at most */
+#define STREAM_ENGINE_QUEUE  (1024)   /* submissions a worker queues, 2^n */
+
+/**
+ * @brief result of one chunk of a device
+ * @param frames: frames of the device consumed so far
+ * @param step_num, class: as in StepCounterOutput, class is -1 when the
+ * chunk closed no window
+ * @param latency_ns: from the submission that completed the chunk to the
+ * callback
+ */
+typedef struct StreamResult {
+    uint64_t device_id;
+    uint64_t frames;
+    uint16_t step_num;
+    int16_t class;
+    uint64_t latency_ns;
+} StreamResult;
+
+/**
+ * @brief called on the worker that owns the device, one call at a time per
+ * worker
+ * @param user: as given to stream_engine_create()
+ * @param worker: in [0, worker_num), e.g. to pick per worker counters
+ */
+typedef void (*StreamEngineCallback)(void *user, uint16_t worker,
+                                     const StreamResult *result);
+
+/* counters since stream_engine_create() */
+typedef struct StreamEngineStats {
+    uint64_t submitted; /* submissions queued */
+    uint64_t rejected;  /* submissions refused by a full queue */
+    uint64_t chunks;    /* step_counter_ctx_process() calls */
+    uint64_t frames;    /* frames processed */
+    uint64_t dropped;   /* submissions lost, no memory for the device */
+    uint32_t devices;   /* devices with a context now */
+} StreamEngineStats;
+
+typedef struct StreamEngine StreamEngine;
+
+/**
+ * @brief start worker_num workers
+ * @param worker_num: 0 for task_pool_cpu_num()
+ * @return NULL when the workers or their queues cannot be set up
+ */
+StreamEngine *stream_engine_create(uint16_t worker_num,
+                                   StreamEngineCallback callback, void *user);
+
+/* worker that owns device_id */
+uint16_t stream_engine_worker(const StreamEngine *engine, uint64_t device_id);
+
+/**
+ * @brief queue frames of device_id, which gets a context on its first
+ * frames. Any number of threads may submit; submissions of one device are
+ * processed in the order they were queued.
+ * @param frames: frame_num frames of gyro_x, gyro_y, gyro_z, x, y, z
+ * int16_t each, copied before the call returns
+ * @param frame_num: 1 to STREAM_ENGINE_FRAMES
+ * @param frame_size: bytes from one frame to the next, as for
+ * acc_input_from_frames()
+ * @return ALGO_ERR_GENERIC on bad arguments, ALGO_ERR_FULL when the queue
+ * of the worker is full. Nothing is queued then, only ALGO_ERR_FULL is
+ * worth a retry.
+ */
+AlgoError stream_engine_submit(StreamEngine *engine, uint64_t device_id,
+                               const int16_t *frames, uint16_t frame_num,
+                               uint16_t frame_size);
+
+/**
+ * @brief end the stream of device_id after its queued frames, a later
+ * submission starts a new stream on a fresh context
+ * @return ALGO_ERR_GENERIC without an engine, ALGO_ERR_FULL when the queue
+ * of the worker is full
+ */
+AlgoError stream_engine_end(StreamEngine *engine, uint64_t device_id);
+
+/* wait until every submission queued before the call has been processed */
+void stream_engine_drain(StreamEngine *engine);
+
+void stream_engine_get_stats(const StreamEngine *engine,
+                             StreamEngineStats *stats);
+
+/* drain, stop the workers and free every context */
+void stream_engine_destroy(StreamEngine *engine);
+
+#endif
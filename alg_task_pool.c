@@ -0,0 +1,172 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_task_pool.c
+ * @brief work stealing thread pool
+ */
+
+#include "alg_task_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* tasks [head, tail) not taken yet, the owner pops head and thieves tail */
+typedef struct TaskQueue {
+    pthread_mutex_t lock;
+    uint32_t head;
+    uint32_t tail;
+} TaskQueue;
+
+typedef struct TaskPool {
+    TaskQueue *queue;
+    uint16_t thread_num;
+    TaskPoolRun run;
+    void *ctx;
+} TaskPool;
+
+typedef struct TaskWorker {
+    TaskPool *pool;
+    uint16_t id;
+} TaskWorker;
+
+uint16_t task_pool_cpu_num(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n < 1 ? 1 : n > UINT16_MAX ? UINT16_MAX : (uint16_t)n;
+}
+
+static int queue_pop(TaskQueue *queue, uint32_t *task)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *task = queue->head++;
+        ret   = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+static uint32_t queue_left(TaskQueue *queue)
+{
+    uint32_t left = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    left = queue->tail - queue->head;
+    pthread_mutex_unlock(&queue->lock);
+    return left;
+}
+
+static int queue_steal(TaskQueue *queue, uint32_t *task)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *task = --queue->tail;
+        ret   = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+/* a task from the largest other share, 0 when all are empty */
+static int pool_steal(TaskPool *pool, uint16_t self, uint32_t *task)
+{
+    uint32_t left = 0, most = 0;
+    uint16_t i = 0, victim = 0;
+
+    for (;;) {
+        most = 0;
+        for (i = 0; i < pool->thread_num; i++) {
+            // may change before the steal, queue_steal() decides
+            left = i != self ? queue_left(&pool->queue[i]) : 0;
+            if (left > most) {
+                most   = left;
+                victim = i;
+            }
+        }
+        if (most == 0) {
+            return 0;
+        }
+        if (queue_steal(&pool->queue[victim], task)) {
+            return 1;
+        }
+    }
+}
+
+static void *task_worker(void *arg)
+{
+    TaskWorker *worker = arg;
+    TaskPool *pool     = worker->pool;
+    uint32_t task      = 0;
+
+    while (queue_pop(&pool->queue[worker->id], &task) ||
+           pool_steal(pool, worker->id, &task)) {
+        pool->run(pool->ctx, task, worker->id);
+    }
+    return NULL;
+}
+
+AlgoError task_pool_run(uint32_t task_num, uint16_t thread_num,
+                        TaskPoolRun run, void *ctx)
+{
+    TaskPool pool;
+    TaskWorker *worker = NULL;
+    pthread_t *thread  = NULL;
+    uint8_t *started   = NULL;
+    uint16_t t         = 0;
+
+    if (!run) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (thread_num == 0) {
+        thread_num = task_pool_cpu_num();
+    }
+    if ((uint32_t)thread_num > task_num) {
+        thread_num = task_num > 0 ? (uint16_t)task_num : 1;
+    }
+    pool.thread_num = thread_num;
+    pool.run        = run;
+    pool.ctx        = ctx;
+    pool.queue      = calloc(thread_num, sizeof(TaskQueue));
+    worker          = calloc(thread_num, sizeof(TaskWorker));
+    thread          = calloc(thread_num, sizeof(pthread_t));
+    started         = calloc(thread_num, sizeof(uint8_t));
+    if (!pool.queue || !worker || !thread || !started) {
+        free(pool.queue);
+        free(worker);
+        free(thread);
+        free(started);
+        return ALGO_ERR_GENERIC;
+    }
+    for (t = 0; t < thread_num; t++) {
+        pthread_mutex_init(&pool.queue[t].lock, NULL);
+        pool.queue[t].head = (uint32_t)((uint64_t)task_num * t / thread_num);
+        pool.queue[t].tail =
+            (uint32_t)((uint64_t)task_num * (t + 1) / thread_num);
+        worker[t].pool = &pool;
+        worker[t].id   = t;
+    }
+    // the calling thread is worker 0
+    for (t = 1; t < thread_num; t++) {
+        started[t] =
+            pthread_create(&thread[t], NULL, task_worker, &worker[t]) == 0;
+    }
+    task_worker(&worker[0]);
+    for (t = 1; t < thread_num; t++) {
+        if (started[t]) {
+            pthread_join(thread[t], NULL);
+        }
+    }
+    for (t = 0; t < thread_num; t++) {
+        pthread_mutex_destroy(&pool.queue[t].lock);
+    }
+    free(pool.queue);
+    free(worker);
+    free(thread);
+    free(started);
+    return ALGO_NORMAL;
+}
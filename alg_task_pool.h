@@ -0,0 +1,42 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_task_pool.h
+ * @brief work stealing thread pool for host tools that process many
+ * independent recordings
+ */
+
+#ifndef __ALG_TASK_POOL_H_
+#define __ALG_TASK_POOL_H_
+
+#include <stdint.h>
+#include "alg_step_counter.h"
+
+/**
+ * @brief run one task
+ * @param ctx: as given to task_pool_run()
+ * @param task: index in [0, task_num)
+ * @param worker: index of the thread running it in [0, thread_num), e.g. to
+ * pick per thread scratch memory
+ */
+typedef void (*TaskPoolRun)(void *ctx, uint32_t task, uint16_t worker);
+
+/**
+ * @brief number of online CPUs, at least 1
+ */
+uint16_t task_pool_cpu_num(void);
+
+/**
+ * @brief run tasks 0 .. task_num - 1 on thread_num threads, the calling one
+ * included, and return when all are done. Every thread starts on its own
+ * contiguous share of the tasks in order and then steals one at a time
+ * from the end of the largest share left.
+ * @param thread_num: 0 for task_pool_cpu_num(). The share of a thread that
+ * fails to start is stolen by the others.
+ * @return ALGO_ERR_GENERIC when the pool cannot be allocated, nothing has
+ * run then
+ */
+AlgoError task_pool_run(uint32_t task_num, uint16_t thread_num,
+                        TaskPoolRun run, void *ctx);
+
+#endif
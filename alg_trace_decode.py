@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Decode a trace ring written by alg_trace_save() or dumped from the
+device memory holding alg_trace (see alg_trace.h).
+
+    alg_trace_decode.py alg_trace.bin            one line per record
+    alg_trace_decode.py --summary alg_trace.bin  span timings only
+
+Times are in clock ticks relative to the oldest record, nanoseconds with
+the default host clock. Tensors cut by the ring wrap and spans without
+both ends are dropped.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0x45435254
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IBBBB24s")
+FLOAT, INT, BEGIN, END = range(4)
+
+
+def trace_names(header):
+    """AlgTraceId values -> names, read from alg_trace.h"""
+    with open(header) as fp:
+        text = fp.read()
+    body = re.search(r"enum AlgTraceId\s*{(.*?)}", text, re.S).group(1)
+    names = {}
+    value = 0
+    for line in body.splitlines():
+        m = re.match(r"\s*(\w+)\s*(?:=\s*(\d+))?\s*,", line)
+        if not m:
+            continue
+        if m.group(2):
+            value = int(m.group(2))
+        names[value] = m.group(1)
+        value += 1
+    return names
+
+
+def read_records(path):
+    with open(path, "rb") as fp:
+        data = fp.read()
+    magic, version, size, num, head = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or size != RECORD.size:
+        sys.exit("%s: not a version %d trace" % (path, VERSION))
+    if len(data) < HEADER.size + num * size:
+        sys.exit("%s: truncated" % path)
+    first = head - num if head > num else 0
+    records = []
+    for n in range(first, head):
+        off = HEADER.size + (n % num) * size
+        records.append(RECORD.unpack_from(data, off))
+    return records
+
+
+def events(records):
+    """(time, id, type, values) with the parts of a tensor joined"""
+    out = []
+    for time, tid, kind, part, count, raw in records:
+        fmt = "<%d%s" % (count, "i" if kind == INT else "f")
+        values = list(struct.unpack_from(fmt, raw))
+        if part == 0:
+            out.append([time, tid, kind, values])
+        elif out and out[-1][1] == tid and out[-1][0] == time:
+            out[-1][3] += values
+        # else the head of the tensor was overwritten
+    return out
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace")
+    parser.add_argument("--header", default=os.path.join(here, "alg_trace.h"),
+                        help="alg_trace.h with the trace point names")
+    parser.add_argument("--summary", action="store_true",
+                        help="print span statistics only")
+    args = parser.parse_args()
+
+    names = trace_names(args.header)
+    records = read_records(args.trace)
+    if not records:
+        return
+    base = records[0][0]
+    opened = {}
+    spans = {}
+    for time, tid, kind, values in events(records):
+        name = names.get(tid, "id%d" % tid)
+        rel = (time - base) & 0xFFFFFFFF
+        if kind == BEGIN:
+            opened[tid] = time
+            continue
+        if kind == END:
+            if tid not in opened:
+                continue
+            ticks = (time - opened.pop(tid)) & 0xFFFFFFFF
+            spans.setdefault(name, []).append(ticks)
+            if not args.summary:
+                print("%12u %-20s %u" % (rel, name, ticks))
+            continue
+        if not args.summary:
+            text = " ".join("%d" % v if kind == INT else "%.6g" % v
+                            for v in values)
+            print("%12u %-20s %s" % (rel, name, text))
+
+    if args.summary or spans:
+        print("%-20s %8s %12s %12s %12s" % ("span", "count", "mean", "min",
+                                             "max"))
+        for name, ticks in sorted(spans.items()):
+            print("%-20s %8d %12.1f %12u %12u" %
+                  (name, len(ticks), sum(ticks) / len(ticks), min(ticks),
+                   max(ticks)))
+
+
+if __name__ == "__main__":
+    main()
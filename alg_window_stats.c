@@ -0,0 +1,391 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_window_stats.c
+ * @brief int16 window reductions of the step counter, a portable kernel and
+ * SSE2/AVX2 ones chosen by CPUID when the library is loaded
+ */
+
+#include "alg_window_stats.h"
+#include <stddef.h>
+#include <string.h>
+
+#if ALG_WINDOW_STATS_SIMD && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define WINDOW_STATS_X86 (1)
+#include <immintrin.h>
+#else
+#define WINDOW_STATS_X86 (0)
+#endif
+
+typedef void (*TripleSumsFn)(const int16_t *x, const int16_t *y,
+                             const int16_t *z, uint16_t len, TripleSums *out);
+
+// (v / 2)^2 truncated to int16_t, the energy term of the window features
+static int16_t half_square(int16_t v)
+{
+    return (int16_t)((v / 2) * (v / 2));
+}
+
+static void triple_sums_clear(const int16_t *x, const int16_t *y,
+                              const int16_t *z, TripleSums *out)
+{
+    const int16_t *axis[3] = { x, y, z };
+    uint16_t k             = 0;
+
+    for (k = 0; k < 3; k++) {
+        out->sum[k]   = 0;
+        out->sq[k]    = 0;
+        out->cross[k] = 0;
+        out->max[k]   = axis[k][0];
+        out->min[k]   = axis[k][0];
+    }
+    out->energy = 0;
+}
+
+// add samples [begin, end) to out
+static void triple_sums_range(const int16_t *x, const int16_t *y,
+                              const int16_t *z, uint16_t begin, uint16_t end,
+                              TripleSums *out)
+{
+    const int16_t *axis[3] = { x, y, z };
+    int32_t v[3];
+    uint16_t i = 0, k = 0;
+
+    for (i = begin; i < end; i++) {
+        for (k = 0; k < 3; k++) {
+            v[k] = axis[k][i];
+            out->sum[k] += v[k];
+            out->sq[k] += v[k] * v[k];
+            out->energy += half_square(v[k]);
+            if (v[k] > out->max[k]) {
+                out->max[k] = v[k];
+            }
+            if (v[k] < out->min[k]) {
+                out->min[k] = v[k];
+            }
+        }
+        out->cross[0] += v[0] * v[1];
+        out->cross[1] += v[0] * v[2];
+        out->cross[2] += v[1] * v[2];
+    }
+}
+
+static void triple_sums_scalar(const int16_t *x, const int16_t *y,
+                               const int16_t *z, uint16_t len, TripleSums *out)
+{
+    triple_sums_clear(x, y, z, out);
+    triple_sums_range(x, y, z, 0, len, out);
+}
+
+#if WINDOW_STATS_X86
+/*
+ * The int32 product of two int16 lanes is split into its signed high half
+ * (mulhi) and unsigned low half (mullo), and each half is summed pairwise
+ * with madd. The low half is biased by -0x8000 to fit madd's signed input,
+ * which is undone once per sample at the end. A lane takes at most 2 * 8192
+ * int16 terms of one axis, under 2^30 for any uint16_t length, so the lanes
+ * never overflow. They are only added up across lanes and axes in int64, as
+ * the three axes of a long window overflow int32, and the result is exact.
+ *
+ * Each axis and each axis pair is reduced in its own pass, the window is in
+ * L1 anyway and this keeps the accumulators in registers.
+ */
+enum { ACC_MAX, ACC_MIN, ACC_SUM, ACC_SQ_HI, ACC_SQ_LO, ACC_ENERGY, ACC_NUM };
+
+// the 128 bit helpers are also used by the AVX2 kernel, inlining them there
+// gets them VEX encoded and avoids the SSE/AVX transition penalty
+#define SSE2_HELPER \
+    static inline __attribute__((target("sse2"), always_inline))
+
+SSE2_HELPER int64_t
+lanes_sum_sse2(__m128i acc)
+{
+    int32_t lane[4];
+    _mm_storeu_si128((__m128i *)lane, acc);
+    return (int64_t)lane[0] + lane[1] + lane[2] + lane[3];
+}
+
+// samples [begin, end) of one axis, end - begin a multiple of 8
+SSE2_HELPER void
+axis_acc_sse2(const int16_t *a, uint16_t begin, uint16_t end, __m128i *acc)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i bias = _mm_set1_epi16((int16_t)0x8000);
+    __m128i v, p;
+    uint16_t i = 0;
+
+    for (i = begin; i < end; i += 8) {
+        v               = _mm_loadu_si128((const __m128i *)(a + i));
+        acc[ACC_MAX]    = _mm_max_epi16(acc[ACC_MAX], v);
+        acc[ACC_MIN]    = _mm_min_epi16(acc[ACC_MIN], v);
+        acc[ACC_SUM]    = _mm_add_epi32(acc[ACC_SUM], _mm_madd_epi16(v, ones));
+        p               = _mm_mulhi_epi16(v, v);
+        acc[ACC_SQ_HI]  = _mm_add_epi32(acc[ACC_SQ_HI], _mm_madd_epi16(p, ones));
+        p               = _mm_xor_si128(_mm_mullo_epi16(v, v), bias);
+        acc[ACC_SQ_LO]  = _mm_add_epi32(acc[ACC_SQ_LO], _mm_madd_epi16(p, ones));
+        // v / 2 rounded toward zero, squared with int16 wrap around
+        p = _mm_srai_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 15)), 1);
+        p = _mm_mullo_epi16(p, p);
+        acc[ACC_ENERGY] =
+            _mm_add_epi32(acc[ACC_ENERGY], _mm_madd_epi16(p, ones));
+    }
+}
+
+// cross products of samples [begin, end), acc[0] high and acc[1] low halves
+SSE2_HELPER void
+pair_acc_sse2(const int16_t *a, const int16_t *b, uint16_t begin, uint16_t end,
+              __m128i *acc)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i bias = _mm_set1_epi16((int16_t)0x8000);
+    __m128i va, vb, p;
+    uint16_t i = 0;
+
+    for (i = begin; i < end; i += 8) {
+        va     = _mm_loadu_si128((const __m128i *)(a + i));
+        vb     = _mm_loadu_si128((const __m128i *)(b + i));
+        p      = _mm_mulhi_epi16(va, vb);
+        acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(p, ones));
+        p      = _mm_xor_si128(_mm_mullo_epi16(va, vb), bias);
+        acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(p, ones));
+    }
+}
+
+SSE2_HELPER void
+axis_acc_init_sse2(int16_t first, __m128i *acc)
+{
+    uint16_t k = 0;
+    for (k = 0; k < ACC_NUM; k++) {
+        acc[k] = _mm_setzero_si128();
+    }
+    acc[ACC_MAX] = _mm_set1_epi16(first);
+    acc[ACC_MIN] = acc[ACC_MAX];
+}
+
+// fold the accumulators of axis k over n vector processed samples into out
+SSE2_HELPER void
+axis_acc_store_sse2(const __m128i *acc, uint16_t n, uint16_t k,
+                    TripleSums *out)
+{
+    int16_t lane[8];
+    uint16_t i = 0;
+
+    _mm_storeu_si128((__m128i *)lane, acc[ACC_MAX]);
+    for (i = 0; i < 8; i++) {
+        out->max[k] = lane[i] > out->max[k] ? lane[i] : out->max[k];
+    }
+    _mm_storeu_si128((__m128i *)lane, acc[ACC_MIN]);
+    for (i = 0; i < 8; i++) {
+        out->min[k] = lane[i] < out->min[k] ? lane[i] : out->min[k];
+    }
+    out->sum[k] = (int32_t)lanes_sum_sse2(acc[ACC_SUM]);
+    out->sq[k]  = lanes_sum_sse2(acc[ACC_SQ_HI]) * 65536 +
+                 lanes_sum_sse2(acc[ACC_SQ_LO]) + (int64_t)n * 0x8000;
+    out->energy += lanes_sum_sse2(acc[ACC_ENERGY]);
+}
+
+SSE2_HELPER int64_t
+pair_acc_value_sse2(const __m128i *acc, uint16_t n)
+{
+    return lanes_sum_sse2(acc[0]) * 65536 + lanes_sum_sse2(acc[1]) +
+           (int64_t)n * 0x8000;
+}
+
+__attribute__((target("sse2"))) static void
+triple_sums_sse2(const int16_t *x, const int16_t *y, const int16_t *z,
+                 uint16_t len, TripleSums *out)
+{
+    static const uint8_t pair[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    const int16_t *axis[3] = { x, y, z };
+    uint16_t n             = len & ~7u;
+    __m128i acc[ACC_NUM];
+    uint16_t k = 0;
+
+    triple_sums_clear(x, y, z, out);
+    for (k = 0; k < 3; k++) {
+        axis_acc_init_sse2(axis[k][0], acc);
+        axis_acc_sse2(axis[k], 0, n, acc);
+        axis_acc_store_sse2(acc, n, k, out);
+    }
+    for (k = 0; k < 3; k++) {
+        acc[0] = _mm_setzero_si128();
+        acc[1] = _mm_setzero_si128();
+        pair_acc_sse2(axis[pair[k][0]], axis[pair[k][1]], 0, n, acc);
+        out->cross[k] = pair_acc_value_sse2(acc, n);
+    }
+    triple_sums_range(x, y, z, n, len, out);
+}
+
+__attribute__((target("avx2"))) static __m128i fold256_add(__m256i v)
+{
+    return _mm_add_epi32(_mm256_castsi256_si128(v),
+                         _mm256_extracti128_si256(v, 1));
+}
+
+// samples [0, end) of one axis, end a multiple of 16, folded into 128 bits
+__attribute__((target("avx2"))) static void
+axis_acc_avx2(const int16_t *a, uint16_t end, __m128i *acc)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i bias = _mm256_set1_epi16((int16_t)0x8000);
+    __m256i v, p;
+    __m256i max = _mm256_set1_epi16(a[0]), min = max;
+    __m256i sum = _mm256_setzero_si256(), sq_hi = sum, sq_lo = sum,
+            energy = sum;
+    uint16_t i = 0;
+
+    for (i = 0; i < end; i += 16) {
+        v      = _mm256_loadu_si256((const __m256i *)(a + i));
+        max    = _mm256_max_epi16(max, v);
+        min    = _mm256_min_epi16(min, v);
+        sum    = _mm256_add_epi32(sum, _mm256_madd_epi16(v, ones));
+        p      = _mm256_mulhi_epi16(v, v);
+        sq_hi  = _mm256_add_epi32(sq_hi, _mm256_madd_epi16(p, ones));
+        p      = _mm256_xor_si256(_mm256_mullo_epi16(v, v), bias);
+        sq_lo  = _mm256_add_epi32(sq_lo, _mm256_madd_epi16(p, ones));
+        p      = _mm256_srai_epi16(
+            _mm256_add_epi16(v, _mm256_srli_epi16(v, 15)), 1);
+        p      = _mm256_mullo_epi16(p, p);
+        energy = _mm256_add_epi32(energy, _mm256_madd_epi16(p, ones));
+    }
+
+    acc[ACC_MAX]    = _mm_max_epi16(_mm256_castsi256_si128(max),
+                                    _mm256_extracti128_si256(max, 1));
+    acc[ACC_MIN]    = _mm_min_epi16(_mm256_castsi256_si128(min),
+                                    _mm256_extracti128_si256(min, 1));
+    acc[ACC_SUM]    = fold256_add(sum);
+    acc[ACC_SQ_HI]  = fold256_add(sq_hi);
+    acc[ACC_SQ_LO]  = fold256_add(sq_lo);
+    acc[ACC_ENERGY] = fold256_add(energy);
+}
+
+__attribute__((target("avx2"))) static void
+pair_acc_avx2(const int16_t *a, const int16_t *b, uint16_t end, __m128i *acc)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i bias = _mm256_set1_epi16((int16_t)0x8000);
+    __m256i va, vb, p;
+    __m256i hi = _mm256_setzero_si256(), lo = hi;
+    uint16_t i = 0;
+
+    for (i = 0; i < end; i += 16) {
+        va = _mm256_loadu_si256((const __m256i *)(a + i));
+        vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        p  = _mm256_mulhi_epi16(va, vb);
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16(p, ones));
+        p  = _mm256_xor_si256(_mm256_mullo_epi16(va, vb), bias);
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16(p, ones));
+    }
+    acc[0] = fold256_add(hi);
+    acc[1] = fold256_add(lo);
+}
+
+__attribute__((target("avx2"))) static void
+triple_sums_avx2(const int16_t *x, const int16_t *y, const int16_t *z,
+                 uint16_t len, TripleSums *out)
+{
+    static const uint8_t pair[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    const int16_t *axis[3] = { x, y, z };
+    uint16_t n16           = len & ~15u;
+    uint16_t n             = len & ~7u;
+    __m128i acc[ACC_NUM];
+    uint16_t k = 0;
+
+    // 16 samples per step, then at most one 8 sample step before the tail
+    triple_sums_clear(x, y, z, out);
+    for (k = 0; k < 3; k++) {
+        axis_acc_avx2(axis[k], n16, acc);
+        axis_acc_sse2(axis[k], n16, n, acc);
+        axis_acc_store_sse2(acc, n, k, out);
+    }
+    for (k = 0; k < 3; k++) {
+        pair_acc_avx2(axis[pair[k][0]], axis[pair[k][1]], n16, acc);
+        pair_acc_sse2(axis[pair[k][0]], axis[pair[k][1]], n16, n, acc);
+        out->cross[k] = pair_acc_value_sse2(acc, n);
+    }
+    triple_sums_range(x, y, z, n, len, out);
+}
+#endif
+
+static TripleSumsFn triple_sums_fn = triple_sums_scalar;
+static const char *triple_sums_fn_name = "scalar";
+
+int window_stats_select(WindowStatsImpl impl)
+{
+    switch (impl) {
+    case WINDOW_STATS_AUTO:
+        if (window_stats_select(WINDOW_STATS_AVX2) == 0 ||
+            window_stats_select(WINDOW_STATS_SSE2) == 0) {
+            return 0;
+        }
+        return window_stats_select(WINDOW_STATS_SCALAR);
+    case WINDOW_STATS_SCALAR:
+        triple_sums_fn      = triple_sums_scalar;
+        triple_sums_fn_name = "scalar";
+        return 0;
+#if WINDOW_STATS_X86
+    case WINDOW_STATS_SSE2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("sse2")) {
+            return -1;
+        }
+        triple_sums_fn      = triple_sums_sse2;
+        triple_sums_fn_name = "sse2";
+        return 0;
+    case WINDOW_STATS_AVX2:
+        // also checks that the OS saves the ymm registers
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2")) {
+            return -1;
+        }
+        triple_sums_fn      = triple_sums_avx2;
+        triple_sums_fn_name = "avx2";
+        return 0;
+#endif
+    default:
+        return -1;
+    }
+}
+
+#if WINDOW_STATS_X86
+// resolved before main() so that contexts processed on several threads
+// never race on the kernel pointer
+__attribute__((constructor)) static void window_stats_auto_select(void)
+{
+    window_stats_select(WINDOW_STATS_AUTO);
+}
+#endif
+
+const char *window_stats_name(void)
+{
+    return triple_sums_fn_name;
+}
+
+void triple_sums(const int16_t *x, const int16_t *y, const int16_t *z,
+                 uint16_t len, TripleSums *out)
+{
+    if (!out) {
+        return;
+    }
+    if (!x || !y || !z || len == 0) {
+        memset(out, 0, sizeof(TripleSums));
+        return;
+    }
+    triple_sums_fn(x, y, z, len, out);
+}
+
+void triple_sums_accumulate(TripleSums *acc, const TripleSums *s, int sign)
+{
+    uint16_t k = 0;
+
+    if (!acc || !s || (sign != 1 && sign != -1)) {
+        return;
+    }
+    for (k = 0; k < 3; k++) {
+        acc->sum[k]   += sign * s->sum[k];
+        acc->sq[k]    += sign * s->sq[k];
+        acc->cross[k] += sign * s->cross[k];
+    }
+    acc->energy += sign * s->energy;
+}
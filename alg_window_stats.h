@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_window_stats.h
+ * @brief int16 window reductions of the step counter with SIMD kernels
+ * picked at runtime
+ */
+
+#ifndef __ALG_WINDOW_STATS_H_
+#define __ALG_WINDOW_STATS_H_
+
+#include <stdint.h>
+
+/**
+ * @brief 0 builds the portable kernel only
+ */
+#ifndef ALG_WINDOW_STATS_SIMD
+#define ALG_WINDOW_STATS_SIMD (1)
+#endif
+
+/**
+ * @brief exact integer sums of one sensor triple over a window, every kernel
+ * returns the same values as the scalar one
+ * @param sum: sum of x, y, z
+ * @param sq: sum of squares of x, y, z
+ * @param cross: sum of x * y, x * z, y * z
+ * @param energy: sum of the int16_t (v / 2)^2 terms of all three axes
+ * @param max: maximum of x, y, z
+ * @param min: minimum of x, y, z
+ */
+typedef struct TripleSums {
+    int32_t sum[3];
+    int64_t sq[3];
+    int64_t cross[3];
+    int64_t energy;
+    int16_t max[3];
+    int16_t min[3];
+} TripleSums;
+
+/**
+ * @brief kernel choice, WINDOW_STATS_AUTO is the fastest one the CPU supports
+ */
+typedef enum WindowStatsImpl {
+    WINDOW_STATS_AUTO = 0,
+    WINDOW_STATS_SCALAR,
+    WINDOW_STATS_SSE2,
+    WINDOW_STATS_AVX2,
+} WindowStatsImpl;
+
+/**
+ * @brief force a kernel, mainly for benchmarks and cross checks
+ * @param impl: the kernel to use
+ * @return 0 on success, -1 if it is not built in or the CPU lacks it
+ */
+int window_stats_select(WindowStatsImpl impl);
+
+/**
+ * @brief name of the kernel in use, e.g. "avx2"
+ */
+const char *window_stats_name(void);
+
+/**
+ * @brief reduce one window of a sensor triple
+ * @param x, y, z: the three axes, len samples each
+ * @param len: number of samples, 0 gives all zero sums
+ * @param out: the sums
+ */
+void triple_sums(const int16_t *x, const int16_t *y, const int16_t *z,
+                 uint16_t len, TripleSums *out);
+
+/**
+ * @brief acc += s (sign 1) or acc -= s (sign -1), for windows that slide by
+ * whole blocks. Only the additive sums are updated, max and min cannot be
+ * taken back out of a window and are left untouched.
+ */
+void triple_sums_accumulate(TripleSums *acc, const TripleSums *s, int sign);
+
+#endif
@@ -0,0 +1,274 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file feature_extract.c
+ * @brief classifier training set from IMU recordings, computed by the step
+ * counter itself so that training and deployment features are the same
+ * bits. Replaces the feature loop of python.ipynb.
+ *
+ *   feature_extract [-j threads] [-c 5|11] [-s hop] [-f feature.csv]
+ *                   [-l label.csv] IMU_Dataset
+ *
+ * Inputs are directories (searched for recordings), recording files or
+ * archives from imu_archive, one recording per task of a work stealing
+ * pool. The label of a recording is the activity directory it is in. Rows
+ * come out in sorted path order whatever the thread count. The window is
+ * WIN_LEN samples, set at build time with WIN_SEC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "alg_step_counter.h"
+#include "alg_imu_dataset.h"
+#include "alg_task_pool.h"
+#include "MyNN/alg_mlp_network.h"
+
+#define FEATURE_GROW_MIN (64) /* rows */
+
+/**
+ * @brief feature rows of recording i of the dataset after its task
+ */
+typedef struct FeatureTask {
+    int class;
+    uint32_t frames;
+    uint32_t rows;
+    uint32_t cap;
+    FeatureValue *feature;
+    AlgoError ret;
+} FeatureTask;
+
+/* the dataset is kept open until the rows are written */
+typedef struct FeatureJob {
+    ImuDataset set;
+    FeatureTask *task;
+    uint16_t hop;
+} FeatureJob;
+
+static AlgoError task_row(FeatureTask *task, const FeatureValue *feature)
+{
+    FeatureValue *grown = NULL;
+    uint32_t cap        = 0;
+
+    if (task->rows == task->cap) {
+        cap   = task->cap > 0 ? 2 * task->cap : FEATURE_GROW_MIN;
+        grown = realloc(task->feature,
+                        (size_t)cap * STEP_FEATURE_NUM * sizeof(FeatureValue));
+        if (!grown) {
+            return ALGO_ERR_GENERIC;
+        }
+        task->feature = grown;
+        task->cap     = cap;
+    }
+    memcpy(task->feature + (size_t)task->rows * STEP_FEATURE_NUM, feature,
+           STEP_FEATURE_NUM * sizeof(FeatureValue));
+    task->rows++;
+    return ALGO_NORMAL;
+}
+
+/* replay one recording the way step_counter does and keep every window */
+static AlgoError task_features(FeatureTask *task, const ImuRecording *rec,
+                               uint16_t hop)
+{
+    StepCounterCtx ctx;
+    StepCounterOutput output;
+    AccInput win;
+    uint16_t delay_point = ACC_FS - 5 - 2;
+    uint16_t chunk       = 0;
+    uint32_t i           = 0;
+
+    if (step_counter_ctx_init(&ctx) != ALGO_NORMAL ||
+        step_counter_ctx_set_hop(&ctx, hop) != ALGO_NORMAL) {
+        return ALGO_ERR_GENERIC;
+    }
+    task->frames = rec->len;
+    for (i = 0; i < rec->len; i += chunk) {
+        chunk = i == 0 ? delay_point : ACC_FS;
+        if (rec->len - i < chunk) {
+            break;
+        }
+        imu_recording_window(rec, i, chunk, &win);
+        if (step_counter_ctx_process(&ctx, &win, &output) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+        if (output.class >= 0 &&
+            task_row(task, output.feature) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    return ALGO_NORMAL;
+}
+
+static void feature_task(void *ctx, uint32_t index, uint16_t worker)
+{
+    FeatureJob *job   = ctx;
+    FeatureTask *task = &job->task[index];
+    ImuRecording store, rec;
+
+    (void)worker;
+    imu_recording_init(&store, NULL, 0);
+    task->ret = imu_dataset_recording(&job->set, index, &store, &rec, NULL);
+    if (task->ret == ALGO_NORMAL) {
+        task->ret = task_features(task, &rec, job->hop);
+    }
+    imu_recording_free(&store);
+}
+
+static void print_feature(FILE *fp, const FeatureValue *feature)
+{
+    uint16_t i = 0;
+
+    for (i = 0; i < STEP_FEATURE_NUM; i++) {
+#if ALG_FIXED_POINT
+        fprintf(fp, i ? ",%d" : "%d", (int)feature[i]);
+#else
+        // 9 digits read back as the same float
+        fprintf(fp, i ? ",%.9g" : "%.9g", (double)feature[i]);
+#endif
+    }
+    fputc('\n', fp);
+}
+
+static int write_rows(const FeatureJob *job, const char *feature_path,
+                      const char *label_path, uint64_t *rows)
+{
+    FILE *feature_fp = fopen(feature_path, "w");
+    FILE *label_fp   = fopen(label_path, "w");
+    const FeatureTask *task = NULL;
+    uint32_t t = 0, r = 0;
+    int ret = 0;
+
+    *rows = 0;
+    if (!feature_fp || !label_fp) {
+        ret = -1;
+    }
+    for (t = 0; t < job->set.num && ret == 0; t++) {
+        task = &job->task[t];
+        for (r = 0; r < task->rows; r++) {
+            print_feature(feature_fp,
+                          task->feature + (size_t)r * STEP_FEATURE_NUM);
+            fprintf(label_fp, "%d\n", task->class);
+        }
+        *rows += task->rows;
+    }
+    if (feature_fp && fclose(feature_fp) != 0) {
+        ret = -1;
+    }
+    if (label_fp && fclose(label_fp) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-j threads] [-c 5|11] [-s hop] [-f feature.csv] "
+           "[-l label.csv] DATASET...\n"
+           "  DATASET   directory of recordings, recording or imu_archive "
+           "archive\n"
+           "  -j        threads, all CPUs by default\n"
+           "  -c        classes of the labels, 5 by default\n"
+           "  -s        samples between windows, a multiple of %d up to "
+           "the %d sample window, %d by default\n",
+           name, ACC_FS, WIN_LEN, WIN_LEN);
+}
+
+int main(int argc, char **argv)
+{
+    FeatureJob job;
+    const char *feature_path = "feature.csv";
+    const char *label_path   = "label.csv";
+    struct timespec start, end;
+    uint64_t rows = 0, frames = 0;
+    uint16_t threads = 0;
+    uint32_t t       = 0;
+    int classes = 5, opt = 0, ret = 0;
+
+    memset(&job, 0, sizeof(job));
+    imu_dataset_init(&job.set);
+    job.hop = WIN_LEN;
+    while ((opt = getopt(argc, argv, "j:c:s:f:l:h")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = (uint16_t)atoi(optarg);
+            break;
+        case 'c':
+            classes = atoi(optarg);
+            break;
+        case 's':
+            job.hop = (uint16_t)atoi(optarg);
+            break;
+        case 'f':
+            feature_path = optarg;
+            break;
+        case 'l':
+            label_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc || (classes != 5 && classes != 11) ||
+        job.hop < ACC_FS || job.hop > WIN_LEN || job.hop % ACC_FS != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (; optind < argc && ret == 0; optind++) {
+        if (imu_dataset_add(&job.set, argv[optind]) != ALGO_NORMAL) {
+            printf("Fail to add %s\n", argv[optind]);
+            ret = -1;
+        }
+    }
+    for (t = 0; t < job.set.num && ret == 0; t++) {
+        if (imu_activity_class(job.set.entry[t].label, classes) < 0) {
+            printf("Unknown activity \"%s\"\n", job.set.entry[t].label);
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        job.task = calloc(job.set.num, sizeof(FeatureTask));
+    }
+    if (ret != 0 || (job.set.num > 0 && !job.task) ||
+        networks_init() != ALGO_NORMAL) {
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (task_pool_run(job.set.num, threads, feature_task, &job) !=
+        ALGO_NORMAL) {
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (t = 0; t < job.set.num; t++) {
+        if (job.task[t].ret != ALGO_NORMAL) {
+            printf("Fail to process %s/%s\n", job.set.entry[t].label,
+                   job.set.entry[t].name);
+            ret = 1;
+        }
+        job.task[t].class = imu_activity_class(job.set.entry[t].label,
+                                               classes);
+        frames += job.task[t].frames;
+    }
+    if (ret == 0 && write_rows(&job, feature_path, label_path, &rows) != 0) {
+        printf("Fail to write %s or %s\n", feature_path, label_path);
+        ret = 1;
+    }
+    if (ret == 0) {
+        printf("%u recordings, %llu frames, %llu windows in %.3f s\n",
+               job.set.num, (unsigned long long)frames,
+               (unsigned long long)rows,
+               (double)(end.tv_sec - start.tv_sec) +
+                   (end.tv_nsec - start.tv_nsec) / 1e9);
+    }
+
+    for (t = 0; t < job.set.num; t++) {
+        free(job.task[t].feature);
+    }
+    free(job.task);
+    imu_dataset_free(&job.set);
+    return ret;
+}
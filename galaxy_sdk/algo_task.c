@@ -21,20 +21,18 @@
 #include "vpi_fifo.h"
 #include "common_struct_def.h"
 #include "algorithm/alg_mlp_networks.h"
+#include "algorithm/alg_trace.h"
 void *algo_task;
 static ImuGyroAccelData *gyro_accel_data;
 static OsalSemaphore sem;
-#define data_len 25
-typedef struct GA_Input {
-    int16_t x[data_len];
-    int16_t y[data_len];
-    int16_t z[data_len];
-    int16_t gyro_x[data_len];
-    int16_t gyro_y[data_len];
-    int16_t gyro_z[data_len];
-} GA_Input;
-
-GA_Input *ga_input;
+// frames stay packed as they come out of the FIFO, the algorithm reads
+// gx..az in place with a stride instead of six de-interleaved arrays.
+// ImuGyroAccelData is packed (alignment 1), so the frames are read through
+// the int16_t view, which keeps every field of a 16 byte frame aligned
+static union {
+    ImuGyroAccelData frame[ALG_PACKET_SIZE];
+    int16_t data[ALG_PACKET_SIZE * sizeof(ImuGyroAccelData) / sizeof(int16_t)];
+} algo_frames;
 uint16_t step_num = 0, step_total = 0, i;
 AccInput acc_xyz_win;
 uint32_t time = 0;
@@ -66,10 +64,16 @@ int algoEventHandler(void *cobj, uint32_t event_id, void *param)
 
     return 0;
 }
+#if ALG_TRACE
+static uint32_t algo_trace_clock(void)
+{
+    return (uint32_t)__get_rv_cycle();
+}
+#endif
+
 // handle IMU data
 void task_algo(void *param)
 {
-    ga_input           = (GA_Input *)malloc(sizeof(GA_Input));
     void *pAlgoManager = vpi_event_new_manager(COBJ_ALGO_MGR, algoEventHandler);
 
     int ret = vpi_event_register(EVENT_SYS_TEST, pAlgoManager);
@@ -89,6 +93,9 @@ void task_algo(void *param)
         uart_printf("MLP:networks_init error\r\n");
         return;
     }
+#if ALG_TRACE
+    alg_trace_set_clock(algo_trace_clock);
+#endif
     //	init sem
     ret = osal_init_sem(&sem);
     if (ret != OSAL_TRUE) {
@@ -108,23 +115,23 @@ void task_algo(void *param)
             gyro_accel_data = msg_verify_packet_test.gyro_accel_data;
             for (int i = 0; i < VERIFY_PACKET_SIZE; ++i) {
                 if (algo_data_len >= ALG_PACKET_SIZE) {
-                    algo_data_len      = 0;
-                    acc_xyz_win.len    = ALG_PACKET_SIZE;
-                    acc_xyz_win.gyro_x = ga_input->gyro_x;
-                    acc_xyz_win.gyro_y = ga_input->gyro_y;
-                    acc_xyz_win.gyro_z = ga_input->gyro_z;
-                    acc_xyz_win.x      = ga_input->x;
-                    acc_xyz_win.y      = ga_input->y;
-                    acc_xyz_win.z      = ga_input->z;
+                    algo_data_len = 0;
+                    acc_input_from_frames(&acc_xyz_win, algo_frames.data,
+                                          ALG_PACKET_SIZE,
+                                          sizeof(ImuGyroAccelData));
 #if 1
                     step_counter_process(&acc_xyz_win, &step_num, &class);
                     step_total += step_num;
+                    // per window detail goes to the trace, the console
+                    // only gets the running total every 5 windows
                     if (time++ % 5 == 0) {
                         uart_printf("[%lu]              Total counts = %3d\n",
                                     time, step_total);
-                    } else {
-                        uart_printf("[%lu]\n", time);
                     }
+#if ALG_TRACE
+                    int32_t result[2] = { step_num, class };
+                    ALG_TRACE_INTS(TRACE_STEP_RESULT, result, 2);
+#endif
 #endif
                     if (ble_get_connect_state() == BLE_STATE_CONNECTED) {
                         action_data.type         = VITAL_SIGN_IMU_ACTION;
@@ -142,13 +149,7 @@ void task_algo(void *param)
                         uart_printf("ble disconnected");
                     }
                 }
-                ga_input->gyro_x[algo_data_len] = gyro_accel_data[i].gx;
-                ga_input->gyro_y[algo_data_len] = gyro_accel_data[i].gy;
-                ga_input->gyro_z[algo_data_len] = gyro_accel_data[i].gz;
-                ga_input->x[algo_data_len]      = gyro_accel_data[i].ax;
-                ga_input->y[algo_data_len]      = gyro_accel_data[i].ay;
-                ga_input->z[algo_data_len]      = gyro_accel_data[i].az;
-                algo_data_len++;
+                algo_frames.frame[algo_data_len++] = gyro_accel_data[i];
             }
         }
     }
@@ -1,4 +1,6 @@
 #include "alg_mlp_networks.h"
+#include "alg_trace.h"
+#include "alg_profile.h"
 
 /* define the BP networks*/
 #define NETWORKS_INPUT_SIZE         (20) /* input data feature dimension */
@@ -406,43 +408,29 @@ static int relu(LayerData *input_data)
     return NET_NORMAL;
 }
 
+/* batch norm as one affine map per channel, y = x * scale + shift, derived
+ * from the running statistics once in networks_init() */
+static float batch_normal_scale[NETWORKS_BATCHNORMAL1D_SIZE];
+static float batch_normal_shift[NETWORKS_BATCHNORMAL1D_SIZE];
+
 static int batch_normal1d(LayerData *input_data)
 {
     uint16_t i = 0;
-    for (i = 0; i < input_data->size; i += 4) {
-        input_data->data[i] =
-            ((input_data->data[i] - batch_normal_running_mean[i]) /
-             sqrt(batch_normal_running_var[i] + EPS)) *
-                batch_normal_weight[i] +
-            batch_normal_bias[i];
-        input_data->data[i + 1] =
-            ((input_data->data[i + 1] - batch_normal_running_mean[i + 1]) /
-             sqrt(batch_normal_running_var[i + 1] + EPS)) *
-                batch_normal_weight[i + 1] +
-            batch_normal_bias[i + 1];
-        input_data->data[i + 2] =
-            ((input_data->data[i + 2] - batch_normal_running_mean[i + 2]) /
-             sqrt(batch_normal_running_var[i + 2] + EPS)) *
-                batch_normal_weight[i + 2] +
-            batch_normal_bias[i + 2];
-        input_data->data[i + 3] =
-            ((input_data->data[i + 3] - batch_normal_running_mean[i + 3]) /
-             sqrt(batch_normal_running_var[i + 3] + EPS)) *
-                batch_normal_weight[i + 3] +
-            batch_normal_bias[i + 3];
+    if (!input_data || input_data->size > NETWORKS_BATCHNORMAL1D_SIZE) {
+        return NET_ERR_GENERIC;
     }
-    for (; i < input_data->size; ++i) {
+    for (i = 0; i < input_data->size; i++) {
         input_data->data[i] =
-            ((input_data->data[i] - batch_normal_running_mean[i]) /
-             sqrt(batch_normal_running_var[i] + EPS)) *
-                batch_normal_weight[i] +
-            batch_normal_bias[i];
+            input_data->data[i] * batch_normal_scale[i] + batch_normal_shift[i];
     }
     return NET_NORMAL;
 }
 
 int networks_init(void)
 {
+    uint16_t i = 0;
+    double scale = 0;
+
     memset(&bp_networks, 0, sizeof(BpNetworks));
 
     bp_networks.linner_layer1.row_num    = NETWORKS_INPUT_SIZE;
@@ -455,6 +443,16 @@ int networks_init(void)
     bp_networks.linner_layer2.weight     = linner_layer2_weight;
     bp_networks.linner_layer2.bias       = linner_layer2_bias;
 
+    // the sqrt and divide of the running variance are per model, not per
+    // inference
+    for (i = 0; i < NETWORKS_BATCHNORMAL1D_SIZE; i++) {
+        scale = batch_normal_weight[i] /
+                sqrt(batch_normal_running_var[i] + EPS);
+        batch_normal_scale[i] = (float)scale;
+        batch_normal_shift[i] = (float)(batch_normal_bias[i] -
+                                        batch_normal_running_mean[i] * scale);
+    }
+
     return NET_NORMAL;
 }
 
@@ -469,14 +467,6 @@ static ClassResult result_classification(LayerData *hidden_layer_output)
     return (ClassResult)j;
 }
 
-void dump_layer(LayerData *input_data)
-{
-    for (int i = 0; i < input_data->size; ++i) {
-        printf("%f ", input_data->data[i]);
-    }
-    printf("\n\n");
-}
-
 int foward_process(LayerData *input_data, int16_t *class)
 {
     float linner_layer1_output_data[NETWORKS_LINNER1_SIZE] = { 0.0f };
@@ -498,35 +488,44 @@ int foward_process(LayerData *input_data, int16_t *class)
 
     int ret;
 
+    ALG_TRACE_BEGIN(TRACE_NET_FORWARD);
+    ALG_TRACE_FLOATS(TRACE_NET_INPUT, input_data->data, input_data->size);
+    ALG_PROFILE_BEGIN(layer1_mark);
     ret = linear_calculation(&bp_networks.linner_layer1, input_data,
                              &linner_layer1_output);
-
-    if (ret != NET_NORMAL) {
-        printf("linnear1 wrong!\n");
-        return ret;
+    if (ret == NET_NORMAL) {
+        ret = batch_normal1d(&linner_layer1_output);
     }
-    ret = batch_normal1d(&linner_layer1_output);
-
-    if (ret != NET_NORMAL) {
-        printf("batch_normal1d wrong!\n");
-        return ret;
+    if (ret == NET_NORMAL) {
+        ret = relu(&linner_layer1_output);
     }
-    ret = relu(&linner_layer1_output);
-
+    ALG_PROFILE_END(PROFILE_NET_LAYER1, layer1_mark);
     if (ret != NET_NORMAL) {
-        printf("relu wrong!\n");
+        // the span is closed on every return, the trace stays balanced
+        ALG_TRACE_END(TRACE_NET_FORWARD);
         return ret;
     }
+    ALG_TRACE_FLOATS(TRACE_NET_HIDDEN, linner_layer1_output_data,
+                     NETWORKS_LINNER1_SIZE);
 
+    ALG_PROFILE_BEGIN(layer2_mark);
     ret = linear_calculation(&bp_networks.linner_layer2, &linner_layer1_output,
                              &linner_layer2_output);
-
+    ALG_PROFILE_END(PROFILE_NET_LAYER2, layer2_mark);
     if (ret != NET_NORMAL) {
-        printf("linnear2 wrong!\n");
+        ALG_TRACE_END(TRACE_NET_FORWARD);
         return ret;
     }
+    ALG_TRACE_FLOATS(TRACE_NET_OUTPUT, linner_layer2_output_data,
+                     NETWORKS_LINNER2_SIZE);
 
+    ALG_PROFILE_BEGIN(pool_mark);
     *class = result_classification(&hidden_layer_output);
-    printf("action:%s\n", action_list[*class]);
+    ALG_PROFILE_END(PROFILE_NET_POOL, pool_mark);
+#if ALG_TRACE
+    int32_t class_value = *class;
+    ALG_TRACE_INTS(TRACE_NET_CLASS, &class_value, 1);
+#endif
+    ALG_TRACE_END(TRACE_NET_FORWARD);
     return ret;
 }
@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_profile.c
+ * @brief per stage cycle counters
+ */
+
+#include "alg_profile.h"
+#include <string.h>
+
+static const char *const stage_name[PROFILE_STAGE_NUM] = {
+    "window",      "preprocess",  "statistics",  "peak_gx",
+    "peak_gy",     "peak_gz",     "peak_ax",     "peak_ay",
+    "peak_az",     "network",     "net_layer1",  "net_layer2",
+    "net_pool",    "step_select",
+};
+
+const char *alg_profile_name(AlgProfileStage stage)
+{
+    if ((unsigned)stage >= PROFILE_STAGE_NUM) {
+        return "unknown";
+    }
+    return stage_name[stage];
+}
+
+#if ALG_PROFILE
+
+static AlgProfile alg_profile;
+
+void alg_profile_add(AlgProfileStage stage, const AlgProfileMark *begin)
+{
+    AlgProfileMark end   = alg_profile_now();
+    AlgProfileStat *stat = &alg_profile.stage[stage];
+    uint64_t cycles      = end.cycle - begin->cycle;
+    uint32_t run         = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)cycles;
+
+    if (stat->count == 0 || run < stat->min) {
+        stat->min = run;
+    }
+    if (run > stat->max) {
+        stat->max = run;
+    }
+    if (stat->budget && run > stat->budget) {
+        stat->over++;
+    }
+    stat->count++;
+    stat->cycles += cycles;
+    stat->instret += end.instret - begin->instret;
+}
+
+int alg_profile_get(AlgProfile *profile)
+{
+    if (!profile) {
+        return -1;
+    }
+    memcpy(profile, &alg_profile, sizeof(AlgProfile));
+    return 0;
+}
+
+void alg_profile_reset(void)
+{
+    uint16_t i = 0;
+
+    for (i = 0; i < PROFILE_STAGE_NUM; i++) {
+        uint32_t budget = alg_profile.stage[i].budget;
+        memset(&alg_profile.stage[i], 0, sizeof(AlgProfileStat));
+        alg_profile.stage[i].budget = budget;
+    }
+}
+
+int alg_profile_set_budget(AlgProfileStage stage, uint32_t cycles)
+{
+    if ((unsigned)stage >= PROFILE_STAGE_NUM) {
+        return -1;
+    }
+    alg_profile.stage[stage].budget = cycles;
+    return 0;
+}
+
+#else
+
+int alg_profile_get(AlgProfile *profile)
+{
+    if (profile) {
+        memset(profile, 0, sizeof(AlgProfile));
+    }
+    return -1;
+}
+
+void alg_profile_reset(void)
+{
+}
+
+int alg_profile_set_budget(AlgProfileStage stage, uint32_t cycles)
+{
+    (void)stage;
+    (void)cycles;
+    return -1;
+}
+
+#endif
@@ -10,6 +10,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include "alg_mlp_networks.h"
+#include "alg_profile.h"
+
+#if STEP_COUNTER_ZERO_HEAP
+// all memory is static, the heap is off limits
+#pragma GCC poison malloc calloc realloc free
+#endif
 
 #define ABS(a) (((a) >= 0) ? (a) : (-(a)))
 
@@ -26,7 +32,9 @@
 #define MEAN_LEN2               (5)
 #define ACC_SENSOR_GRAVITY      (4096)
 #define STEP_ACC_DIFF_THRESHOLD (ACC_SENSOR_GRAVITY / 10) // 0.1g = 4096/10
-#define PEAK_VALLEY_NUM         (50)
+// two peaks (or valleys) are never adjacent samples, so a buffer shorter than
+// BUF_WIN_LEN never holds more than this many of either
+#define PEAK_VALLEY_NUM         (BUF_WIN_LEN / 2)
 #define PEAK_VALLEY_DIFFERENCE  (ACC_SENSOR_GRAVITY / 14) // 1g/14 = 4096/14
 // 4 steps max per second, points number between peak & valley is FS/4/2
 #define TIME_THRESHOLD1 (4)
@@ -35,19 +43,55 @@
 #define LEFT_DATA_NUM   (2)
 
 /**
- * @brief for store the peaks/valleys number and locations
+ * @brief for store the peaks/valleys number, locations and values
  * @param p_cnt: peak number
  * @param v_cnt: valley number
  * @param p_loc: peak locations
  * @param v_loc: valley locations
+ * @param p_val: sample value at each peak
+ * @param v_val: sample value at each valley
  */
 typedef struct PeakValley {
     uint16_t p_cnt;
     uint16_t v_cnt;
     uint16_t *p_loc;
     uint16_t *v_loc;
+    int16_t *p_val;
+    int16_t *v_val;
 } PeakValley;
 
+/**
+ * @brief incremental peak/valley detector of one axis. Samples are pushed one
+ * at a time and every local extremum is recorded with its value, so closing
+ * a window prunes these candidates without touching the samples again. Only
+ * the part after the last valid valley is carried into the next buffer.
+ * The candidates are pruned and counted at window close, which needs the
+ * mean and range of the whole buffer, so steps still come once per window.
+ * @param cnt: samples in the current buffer, carried tail plus new samples
+ * @param sum: sum of those samples
+ * @param first: first sample of the buffer
+ * @param last: the newest LEFT_DATA_NUM + 2 samples, newest last
+ * @param p_cnt, p_loc, p_val: raw peaks of the buffer
+ * @param v_cnt, v_loc, v_val: raw valleys of the buffer
+ * @param v_head_sum: sum of the samples before v_loc - LEFT_DATA_NUM, i.e.
+ * what is dropped when the next buffer starts there
+ * @param v_head_val: sample at v_loc - LEFT_DATA_NUM
+ */
+typedef struct PeakValleyStream {
+    uint16_t cnt;
+    int32_t sum;
+    int16_t first;
+    int16_t last[LEFT_DATA_NUM + 2];
+    uint16_t p_cnt;
+    uint16_t v_cnt;
+    uint16_t p_loc[PEAK_VALLEY_NUM];
+    int16_t p_val[PEAK_VALLEY_NUM];
+    uint16_t v_loc[PEAK_VALLEY_NUM];
+    int16_t v_val[PEAK_VALLEY_NUM];
+    int32_t v_head_sum[PEAK_VALLEY_NUM];
+    int16_t v_head_val[PEAK_VALLEY_NUM];
+} PeakValleyStream;
+
 /**
  * @brief struct for storing the features of a complete waveform,
  * including a peak and it's left valley and right valley
@@ -83,17 +127,18 @@ typedef struct AccData {
 
 typedef struct AccDataHub {
     AccData win;
-    AccData buf;
 } AccDataHub;
 
 /**
  * @brief struct for storing mean filter parameters and data
+ * @param sum: running sum of the samples currently held in buf
  */
 typedef struct MeanFilter {
     uint16_t len;
     uint16_t index;
     int16_t *buf;
     uint16_t buf_full;
+    int32_t sum;
 } MeanFilter;
 
 typedef struct MeanFilterGroup {
@@ -118,16 +163,38 @@ typedef struct MeanOutput {
     int16_t filt;
 } MeanOutput;
 
+/**
+ * @brief struct for storing the window statistics of one sensor triple
+ * @param max: maximum of x, y, z
+ * @param min: minimum of x, y, z
+ * @param mean: mean of x, y, z
+ * @param var: variance of x, y, z
+ * @param energy: mean of the (v/2)^2 terms of all three axes, same as
+ * calculateMeanFeature()
+ * @param cov_xy, cov_xz, cov_yz: absolute covariance between two axes
+ */
+typedef struct TripleStats {
+    int16_t max[3];
+    int16_t min[3];
+    float mean[3];
+    float var[3];
+    float energy;
+    float cov_xy;
+    float cov_xz;
+    float cov_yz;
+} TripleStats;
+
 uint16_t peak_loc[PEAK_VALLEY_NUM]   = { 0 };
 uint16_t valley_loc[PEAK_VALLEY_NUM] = { 0 };
-PeakValley peak_valley               = { 0, 0, NULL, NULL };
+int16_t peak_val[PEAK_VALLEY_NUM]    = { 0 };
+int16_t valley_val[PEAK_VALLEY_NUM]  = { 0 };
+PeakValley peak_valley               = { 0, 0, NULL, NULL, NULL, NULL };
+// axis order: gyro_x, gyro_y, gyro_z, x, y, z
+static PeakValleyStream peak_stream[6];
 
 int16_t x_win[WIN_LEN] = { 0 }, y_win[WIN_LEN] = { 0 }, z_win[WIN_LEN] = { 0 };
-int16_t x_buf[WIN_LEN] = { 0 }, y_buf[WIN_LEN] = { 0 }, z_buf[WIN_LEN] = { 0 };
 int16_t x_gyro_win[WIN_LEN] = { 0 }, y_gyro_win[WIN_LEN] = { 0 },
         z_gyro_win[WIN_LEN] = { 0 };
-int16_t x_gyro_buf[WIN_LEN] = { 0 }, y_gyro_buf[WIN_LEN] = { 0 },
-        z_gyro_buf[WIN_LEN] = { 0 };
 AccDataHub acc_data_hub;
 
 int16_t xmean_filter1_buf[MEAN_LEN1] = { 0 },
@@ -160,20 +227,6 @@ static AlgoError array_max_min(int16_t *a, uint16_t a_len, int16_t direction,
     return ALGO_NORMAL;
 }
 
-static AlgoError array_mean(int16_t *a, uint16_t a_len, int16_t *a_mean)
-{
-    int32_t sum = 0;
-    uint16_t i  = 0;
-    if (!a || !a_mean || a_len == 0) {
-        return ALGO_ERR_GENERIC;
-    }
-    for (i = 0; i < a_len; i++) {
-        sum += (int32_t)(a[i]);
-    }
-    *a_mean = (int16_t)(sum / a_len);
-    return ALGO_NORMAL;
-}
-
 static AlgoError mean_filtering(int16_t input_data, MeanFilter *filter,
                                 MeanOutput *output)
 {
@@ -190,11 +243,12 @@ static AlgoError mean_filtering(int16_t input_data, MeanFilter *filter,
     if (filter->buf_full == 0) {
         if (filter->index < filter->len) {
             filter->buf[filter->index++] = input_data;
+            filter->sum += input_data;
             if (filter->index % 2 == 1) {
-                j = (filter->index - 1) >> 1;
-                array_mean(filter->buf, filter->index, &(output->filt));
-                output->raw = filter->buf[j];
-                ret         = ALGO_NORMAL;
+                j            = (filter->index - 1) >> 1;
+                output->filt = (int16_t)(filter->sum / filter->index);
+                output->raw  = filter->buf[j];
+                ret          = ALGO_NORMAL;
             }
             if (filter->index >= filter->len) {
                 filter->buf_full = 1;
@@ -203,116 +257,183 @@ static AlgoError mean_filtering(int16_t input_data, MeanFilter *filter,
         }
     } else {
         if (filter->index < filter->len) {
+            // replace the oldest sample, keep the sum of the window updated
+            filter->sum += input_data - filter->buf[filter->index];
             filter->buf[filter->index++] = input_data;
             if (filter->index >= filter->len) {
                 filter->index = 0;
             }
         }
-        j = (filter->index + half_len) % (filter->len);
-        array_mean(filter->buf, filter->len, &(output->filt));
-        output->raw = filter->buf[j];
-        ret         = ALGO_NORMAL;
+        j = filter->index + half_len;
+        if (j >= filter->len) {
+            j -= filter->len;
+        }
+        output->filt = (int16_t)(filter->sum / filter->len);
+        output->raw  = filter->buf[j];
+        ret          = ALGO_NORMAL;
     }
     return ret;
 }
 
-static AlgoError if_a_in_A(uint16_t a, uint16_t *A, uint16_t A_len,
-                           int16_t *in_flag)
+static AlgoError delete_ith_A(uint16_t *A, uint16_t A_len, uint16_t i)
 {
-    uint16_t i = 0;
-    if (!A || !in_flag || A_len == 0) {
+    uint16_t j = 0;
+    if (!A || A_len == 0 || i >= A_len) {
         return ALGO_ERR_GENERIC;
     }
-    *in_flag = 0;
-    while (i < A_len) {
-        if (*(A + i) == a) {
-            *in_flag = 1;
-            break;
-        }
-        i++;
+    for (j = i + 1; j < A_len; j++) {
+        A[j - 1] = A[j];
     }
+    A[A_len - 1] = 0;
     return ALGO_NORMAL;
 }
 
-static AlgoError delete_ith_A(uint16_t *A, uint16_t A_len, uint16_t i)
+// delete the ith pole from both its location and its value list
+static AlgoError delete_ith_pole(uint16_t *loc, int16_t *val, uint16_t len,
+                                 uint16_t i)
 {
     uint16_t j = 0;
-    if (!A || A_len == 0 || i >= A_len) {
+    if (!val || delete_ith_A(loc, len, i) != ALGO_NORMAL) {
         return ALGO_ERR_GENERIC;
     }
-    for (j = i + 1; j < A_len; j++) {
-        A[j - 1] = A[j];
+    for (j = i + 1; j < len; j++) {
+        val[j - 1] = val[j];
     }
-    A[A_len - 1] = 0;
+    val[len - 1] = 0;
     return ALGO_NORMAL;
 }
 
-static AlgoError find_possible_peak_valley(int16_t *a, uint16_t a_len,
-                                           PeakValley *peak_valley)
+static void peak_valley_stream_reset(PeakValleyStream *stream)
 {
-    uint16_t i = 0;
-    if (!a || !peak_valley || a_len == 0) {
-        return ALGO_ERR_GENERIC;
+    stream->cnt   = 0;
+    stream->sum   = 0;
+    stream->p_cnt = 0;
+    stream->v_cnt = 0;
+}
+
+/**
+ * @brief feed one filtered sample, the sample before it is classified as
+ * soon as both of its neighbours are known, with the same tests as the
+ * former whole buffer scan (a[i] >= a[i-1] && a[i] > a[i+1] for a peak)
+ */
+static void peak_valley_stream_push(PeakValleyStream *stream, int16_t data)
+{
+    int16_t *last = stream->last;
+    uint16_t loc  = stream->cnt - 1;
+    uint16_t i    = 0;
+    int32_t head  = stream->sum + data;
+
+    if (stream->cnt == 0) {
+        stream->first = data;
     }
-    for (i = 1; i < a_len - 1; i++) {
-        if (peak_valley->p_cnt < PEAK_VALLEY_NUM) {
-            if ((*(a + i) >= *(a + i - 1)) && (*(a + i) > *(a + i + 1))) {
-                peak_valley->p_loc[peak_valley->p_cnt++] = i;
-            }
+
+    for (i = 0; i < LEFT_DATA_NUM + 1; i++) {
+        last[i] = last[i + 1];
+        head -= last[i];
+    }
+    last[LEFT_DATA_NUM + 1] = data;
+    head -= data;
+
+    stream->sum += data;
+    stream->cnt++;
+    if (stream->cnt < 3) {
+        // a[loc] has no left neighbour yet
+        return;
+    }
+
+    if (last[LEFT_DATA_NUM] >= last[LEFT_DATA_NUM - 1] &&
+        last[LEFT_DATA_NUM] > data && stream->p_cnt < PEAK_VALLEY_NUM) {
+        stream->p_loc[stream->p_cnt]   = loc;
+        stream->p_val[stream->p_cnt++] = last[LEFT_DATA_NUM];
+    }
+    if (last[LEFT_DATA_NUM] <= last[LEFT_DATA_NUM - 1] &&
+        last[LEFT_DATA_NUM] < data && stream->v_cnt < PEAK_VALLEY_NUM) {
+        // last[0] is a[loc - LEFT_DATA_NUM] once loc >= LEFT_DATA_NUM
+        stream->v_loc[stream->v_cnt]      = loc;
+        stream->v_val[stream->v_cnt]      = last[LEFT_DATA_NUM];
+        stream->v_head_sum[stream->v_cnt] = head;
+        stream->v_head_val[stream->v_cnt] = last[0];
+        stream->v_cnt++;
+    }
+}
+
+/**
+ * @brief make the buffer start at v_loc[k] - LEFT_DATA_NUM, the extrema
+ * before it are dropped and the rest are relocated
+ */
+static void peak_valley_stream_rebase(PeakValleyStream *stream, uint16_t k)
+{
+    uint16_t start   = stream->v_loc[k] - LEFT_DATA_NUM;
+    int32_t head_sum = stream->v_head_sum[k];
+    uint16_t i = 0, n = 0;
+
+    stream->cnt -= start;
+    stream->sum -= head_sum;
+    stream->first = stream->v_head_val[k];
+
+    for (i = 0, n = 0; i < stream->p_cnt; i++) {
+        if (stream->p_loc[i] > start) {
+            stream->p_loc[n]   = stream->p_loc[i] - start;
+            stream->p_val[n++] = stream->p_val[i];
         }
-        if (peak_valley->v_cnt < PEAK_VALLEY_NUM) {
-            if ((*(a + i) <= *(a + i - 1)) && (*(a + i) < *(a + i + 1))) {
-                peak_valley->v_loc[peak_valley->v_cnt++] = i;
-            }
+    }
+    stream->p_cnt = n;
+    for (i = 0, n = 0; i < stream->v_cnt; i++) {
+        if (stream->v_loc[i] > start) {
+            stream->v_loc[n]      = stream->v_loc[i] - start;
+            stream->v_val[n]      = stream->v_val[i];
+            stream->v_head_sum[n] = stream->v_head_sum[i] - head_sum;
+            stream->v_head_val[n] = stream->v_head_val[i];
+            n++;
         }
     }
-    return ALGO_NORMAL;
+    stream->v_cnt = n;
 }
 
-static AlgoError merge_close_pole(int16_t *a, PeakValley *peak_valley,
-                                  int16_t direction)
+/**
+ * @brief merge neighbouring poles with no opposite pole between them into the
+ * higher (peak) or lower (valley) one. Both lists are sorted, so one pointer
+ * over the opposite list and one compaction pass over the poles are enough.
+ */
+static AlgoError merge_close_pole(PeakValley *peak_valley, int16_t direction)
 {
     uint16_t *pole_loc = NULL;
+    int16_t *pole_val  = NULL;
     uint16_t *v_loc    = NULL;
     uint16_t pole_cnt = 0, v_cnt = 0;
-    uint16_t i = 0, j = 0;
-    int16_t in_flag = 0;
-    if (!a || !peak_valley || (direction != 1 && direction != -1)) {
+    uint16_t i = 0, j = 0, n = 0;
+    if (!peak_valley || (direction != 1 && direction != -1)) {
         return ALGO_ERR_GENERIC;
     }
     if (direction == 1) {
         pole_loc = peak_valley->p_loc;
+        pole_val = peak_valley->p_val;
         pole_cnt = peak_valley->p_cnt;
         v_loc    = peak_valley->v_loc;
         v_cnt    = peak_valley->v_cnt;
     } else if (direction == -1) {
         pole_loc = peak_valley->v_loc;
+        pole_val = peak_valley->v_val;
         pole_cnt = peak_valley->v_cnt;
         v_loc    = peak_valley->p_loc;
         v_cnt    = peak_valley->p_cnt;
     }
     if (pole_cnt > 1) {
-        i = 1;
-        while (i < pole_cnt) {
-            j = pole_loc[i - 1];
-            while (j < pole_loc[i]) {
-                if_a_in_A(j, v_loc, v_cnt, &in_flag);
-                if (in_flag) {
-                    break;
-                }
+        // pole n is the survivor compared with the next pole i
+        for (i = 1; i < pole_cnt; i++) {
+            while (j < v_cnt && v_loc[j] < pole_loc[n]) {
                 j++;
             }
-            if (!in_flag) {
-                if (a[pole_loc[i - 1]] * direction >
-                    a[pole_loc[i]] * direction) {
-                    delete_ith_A(pole_loc, pole_cnt--, i);
-                } else {
-                    delete_ith_A(pole_loc, pole_cnt--, i - 1);
-                }
-            } else {
-                i++;
+            if (j < v_cnt && v_loc[j] < pole_loc[i]) {
+                n++;
+                pole_loc[n] = pole_loc[i];
+                pole_val[n] = pole_val[i];
+            } else if (pole_val[n] * direction <= pole_val[i] * direction) {
+                pole_loc[n] = pole_loc[i];
+                pole_val[n] = pole_val[i];
             }
         }
+        pole_cnt = n + 1;
     }
     if (direction == 1) {
         peak_valley->p_cnt = pole_cnt;
@@ -322,75 +443,79 @@ static AlgoError merge_close_pole(int16_t *a, PeakValley *peak_valley,
     return ALGO_NORMAL;
 }
 
-static AlgoError merge_close_peak_valley(int16_t *a, PeakValley *peak_valley)
+static AlgoError merge_close_peak_valley(PeakValley *peak_valley)
 {
-    if (!a || !peak_valley) {
+    if (!peak_valley) {
         return ALGO_ERR_GENERIC;
     }
     if (peak_valley->p_cnt > 1) {
-        merge_close_pole(a, peak_valley, 1);
+        merge_close_pole(peak_valley, 1);
     }
     if (peak_valley->v_cnt > 1) {
-        merge_close_pole(a, peak_valley, -1);
+        merge_close_pole(peak_valley, -1);
     }
     // make sure the first valley is before the first peak
     if (peak_valley->p_cnt > 0 &&
         ((peak_valley->v_cnt == 0) ||
          (peak_valley->v_cnt > 0 &&
           *(peak_valley->p_loc) < *(peak_valley->v_loc)))) {
-        delete_ith_A(peak_valley->p_loc, peak_valley->p_cnt--, 0);
+        delete_ith_pole(peak_valley->p_loc, peak_valley->p_val,
+                        peak_valley->p_cnt--, 0);
     }
     return ALGO_NORMAL;
 }
 
-static AlgoError remove_false_pole(int16_t *a, int16_t a_mean,
-                                   uint16_t *pole_loc, uint16_t *pole_cnt,
+static AlgoError remove_false_pole(int16_t a_mean, uint16_t *pole_loc,
+                                   int16_t *pole_val, uint16_t *pole_cnt,
                                    int16_t direction)
 {
-    uint16_t i = 0, cur_loc = 0;
+    uint16_t i = 0, n = 0;
 
-    if (!a || !pole_loc || !pole_cnt || (direction != 1 && direction != -1)) {
+    if (!pole_loc || !pole_val || !pole_cnt ||
+        (direction != 1 && direction != -1)) {
         return ALGO_ERR_GENERIC;
     }
 
-    while (i < *pole_cnt) {
-        cur_loc = *(pole_loc + i);
-        if (*(a + cur_loc) * direction < a_mean * direction) {
-            delete_ith_A(pole_loc, *pole_cnt, i);
-            (*pole_cnt)--;
-        } else {
-            i++;
+    for (i = 0; i < *pole_cnt; i++) {
+        if (pole_val[i] * direction >= a_mean * direction) {
+            pole_loc[n]   = pole_loc[i];
+            pole_val[n++] = pole_val[i];
         }
     }
+    *pole_cnt = n;
     return ALGO_NORMAL;
 }
 
-static AlgoError remove_false_peak_valley(int16_t *a, uint16_t a_len,
+static AlgoError remove_false_peak_valley(int16_t a_mean,
                                           PeakValley *peak_valley)
 {
-    int16_t a_mean = 0;
-    if (!a || !peak_valley || a_len == 0) {
+    if (!peak_valley) {
         return ALGO_ERR_GENERIC;
     }
-    array_mean(a, a_len, &a_mean);
-    remove_false_pole(a, a_mean, peak_valley->p_loc, &(peak_valley->p_cnt), 1);
-    remove_false_pole(a, a_mean, peak_valley->v_loc, &(peak_valley->v_cnt), -1);
+    remove_false_pole(a_mean, peak_valley->p_loc, peak_valley->p_val,
+                      &(peak_valley->p_cnt), 1);
+    remove_false_pole(a_mean, peak_valley->v_loc, peak_valley->v_val,
+                      &(peak_valley->v_cnt), -1);
     return ALGO_NORMAL;
 }
 
-static AlgoError calculate_waveform_feature(int16_t *a, uint16_t a_len,
+/**
+ * @param p, lv, rv: sample values at the peak and its two valleys
+ */
+static AlgoError calculate_waveform_feature(int16_t p, int16_t lv, int16_t rv,
+                                            uint16_t a_len,
                                             WaveFormFeature *waveform)
 {
     int16_t lh = 0, rh = 0;
-    if (!a || !waveform || waveform->peak >= a_len ||
+    if (!waveform || waveform->peak >= a_len ||
         waveform->left_valley >= a_len || waveform->right_valley >= a_len ||
         waveform->left_valley >= waveform->right_valley ||
         waveform->peak <= waveform->left_valley ||
         waveform->peak >= waveform->right_valley) {
         return ALGO_ERR_GENERIC;
     }
-    lh = *(a + waveform->peak) - *(a + waveform->left_valley);
-    rh = *(a + waveform->peak) - *(a + waveform->right_valley);
+    lh = p - lv;
+    rh = p - rv;
     if (lh < 0 || rh < 0) {
         return ALGO_ERR_GENERIC;
     }
@@ -401,68 +526,158 @@ static AlgoError calculate_waveform_feature(int16_t *a, uint16_t a_len,
     return ALGO_NORMAL;
 }
 
-static AlgoError remove_asymmetric_peaks(int16_t *a, uint16_t a_len,
+/**
+ * @brief keep the peaks whose two surrounding valleys give a symmetric wave.
+ * Peaks are visited in order while the valleys before the current peak are
+ * kept as a stack, so the left valley of an invalid peak is dropped by a pop
+ * and each list is walked once.
+ */
+static AlgoError remove_asymmetric_peaks(uint16_t a_len,
                                          PeakValley *peak_valley)
 {
-    uint16_t i = 0, j = 0, r1 = 0, r2 = 0;
+    uint16_t i = 0, j = 0, p_n = 0, v_n = 0;
     uint16_t *p_loc, *v_loc;
+    int16_t *p_val, *v_val;
     WaveFormFeature waveform = { 0, 0, 0, 0, 0, 0, 0 };
     uint16_t last_valley_loc = 0;
     AlgoError ret            = ALGO_ERR_GENERIC;
 
-    if (!a || !peak_valley) {
+    if (!peak_valley) {
         return ALGO_ERR_GENERIC;
     }
 
     p_loc = peak_valley->p_loc;
     v_loc = peak_valley->v_loc;
+    p_val = peak_valley->p_val;
+    v_val = peak_valley->v_val;
 
     if (peak_valley->v_cnt > 1) {
-        i = 0;
-        while (i < peak_valley->p_cnt) {
-            r1 = 0;
-            r2 = 0;
-            j  = 1;
-            while (j < peak_valley->v_cnt) {
-                if (v_loc[j - 1] < p_loc[i] && v_loc[j] > p_loc[i]) {
-                    // find the valid peak with two valid valleys
-                    r1                    = 1;
-                    waveform.peak         = p_loc[i];
-                    waveform.left_valley  = v_loc[j - 1];
-                    waveform.right_valley = v_loc[j];
-                    ret = calculate_waveform_feature(a, a_len, &waveform);
-                    if (ret == ALGO_NORMAL) {
-                        if (waveform.left_height > PEAK_VALLEY_DIFFERENCE &&
-                            waveform.rignt_height > PEAK_VALLEY_DIFFERENCE &&
-                            waveform.left_height > waveform.rignt_height / 2 &&
-                            waveform.left_height < waveform.rignt_height * 2) {
-                            last_valley_loc = v_loc[j];
-                        } else {
-                            // the peak is invalid
-                            r2 = 1;
-                            delete_ith_A(p_loc, peak_valley->p_cnt, i);
-                            peak_valley->p_cnt--;
-                            if (v_loc[j - 1] != last_valley_loc) {
-                                delete_ith_A(v_loc, peak_valley->v_cnt, j - 1);
-                                peak_valley->v_cnt--;
-                            }
-                        }
-                    } else {
-                        return ret;
-                    }
-                    break;
-                }
-                j++;
+        // v_loc[0, v_n) are the kept valleys before p_loc[i], v_loc[j, v_cnt)
+        // the ones not visited yet
+        for (i = 0; i < peak_valley->p_cnt; i++) {
+            while (j < peak_valley->v_cnt && v_loc[j] < p_loc[i]) {
+                v_loc[v_n]   = v_loc[j];
+                v_val[v_n++] = v_val[j++];
             }
-            if (r1 == 0) {
+            if (v_n == 0 || j == peak_valley->v_cnt) {
                 // there is no valid valleys for the peak
-                delete_ith_A(p_loc, peak_valley->p_cnt, i);
-                peak_valley->p_cnt--;
-            } else if (r2 == 0) {
-                i++;
+                continue;
+            }
+
+            // find the valid peak with two valid valleys
+            waveform.peak         = p_loc[i];
+            waveform.left_valley  = v_loc[v_n - 1];
+            waveform.right_valley = v_loc[j];
+            ret = calculate_waveform_feature(p_val[i], v_val[v_n - 1],
+                                             v_val[j], a_len, &waveform);
+            if (ret != ALGO_NORMAL) {
+                return ret;
+            }
+            if (waveform.left_height > PEAK_VALLEY_DIFFERENCE &&
+                waveform.rignt_height > PEAK_VALLEY_DIFFERENCE &&
+                waveform.left_height > waveform.rignt_height / 2 &&
+                waveform.left_height < waveform.rignt_height * 2) {
+                last_valley_loc = v_loc[j];
+                p_loc[p_n]      = p_loc[i];
+                p_val[p_n++]    = p_val[i];
+            } else if (v_loc[v_n - 1] != last_valley_loc) {
+                // the peak is invalid, so is its left valley
+                v_n--;
+            }
+        }
+        while (j < peak_valley->v_cnt) {
+            v_loc[v_n]   = v_loc[j];
+            v_val[v_n++] = v_val[j++];
+        }
+        peak_valley->p_cnt = p_n;
+        peak_valley->v_cnt = v_n;
+    }
+    return ALGO_NORMAL;
+}
+
+/**
+ * @brief end of a window for one axis: prune the raw extrema of the buffer
+ * into peak_valley, then keep only the tail after the last valid valley
+ * @param active: set when the buffer swings more than
+ * STEP_ACC_DIFF_THRESHOLD, peak_valley stays empty otherwise
+ */
+static AlgoError peak_valley_stream_close(PeakValleyStream *stream,
+                                          PeakValley *peak_valley,
+                                          uint8_t *active)
+{
+    int16_t buf_win_max = 0, buf_win_min = 0, max_min_diff = 0;
+    uint16_t i = 0, last_v_loc = 0, left_len = 0;
+    AlgoError ret = ALGO_ERR_GENERIC;
+
+    if (!stream || !peak_valley || !active || stream->cnt == 0) {
+        return ALGO_ERR_GENERIC;
+    }
+    peak_valley->p_cnt = 0;
+    peak_valley->v_cnt = 0;
+    *active            = 0;
+
+    // the extremes of a buffer are at its ends or at one of its extrema
+    buf_win_max = stream->first;
+    buf_win_min = stream->first;
+    if (stream->last[LEFT_DATA_NUM + 1] > buf_win_max) {
+        buf_win_max = stream->last[LEFT_DATA_NUM + 1];
+    }
+    if (stream->last[LEFT_DATA_NUM + 1] < buf_win_min) {
+        buf_win_min = stream->last[LEFT_DATA_NUM + 1];
+    }
+    for (i = 0; i < stream->p_cnt; i++) {
+        if (stream->p_val[i] > buf_win_max) {
+            buf_win_max = stream->p_val[i];
+        }
+    }
+    for (i = 0; i < stream->v_cnt; i++) {
+        if (stream->v_val[i] < buf_win_min) {
+            buf_win_min = stream->v_val[i];
+        }
+    }
+
+    max_min_diff = buf_win_max - buf_win_min;
+    if (max_min_diff <= STEP_ACC_DIFF_THRESHOLD) {
+        peak_valley_stream_reset(stream);
+        return ALGO_NORMAL;
+    }
+    *active = 1;
+
+    peak_valley->p_cnt = stream->p_cnt;
+    peak_valley->v_cnt = stream->v_cnt;
+    memcpy(peak_valley->p_loc, stream->p_loc, stream->p_cnt * sizeof(uint16_t));
+    memcpy(peak_valley->p_val, stream->p_val, stream->p_cnt * sizeof(int16_t));
+    memcpy(peak_valley->v_loc, stream->v_loc, stream->v_cnt * sizeof(uint16_t));
+    memcpy(peak_valley->v_val, stream->v_val, stream->v_cnt * sizeof(int16_t));
+
+    ret = remove_false_peak_valley((int16_t)(stream->sum / stream->cnt),
+                                   peak_valley);
+    if (ret == ALGO_NORMAL) {
+        ret = merge_close_peak_valley(peak_valley);
+    }
+    if (ret == ALGO_NORMAL) {
+        ret = remove_asymmetric_peaks(stream->cnt, peak_valley);
+    }
+    if (ret != ALGO_NORMAL) {
+        peak_valley_stream_reset(stream);
+        return ret;
+    }
+
+    if (peak_valley->v_cnt >= 1) {
+        last_v_loc = peak_valley->v_loc[peak_valley->v_cnt - 1];
+        left_len   = stream->cnt - last_v_loc + LEFT_DATA_NUM;
+        if (left_len < BUF_LEN && last_v_loc >= LEFT_DATA_NUM) {
+            i = stream->v_cnt;
+            while (i > 0 && stream->v_loc[i - 1] != last_v_loc) {
+                i--;
+            }
+            if (i > 0) {
+                peak_valley_stream_rebase(stream, i - 1);
+                return ALGO_NORMAL;
             }
         }
     }
+    peak_valley_stream_reset(stream);
     return ALGO_NORMAL;
 }
 
@@ -486,59 +701,42 @@ AlgoError group_mean_filtering(int16_t data, MeanFilterGroup *filter_group,
     return ret;
 }
 
-static AlgoError load_data(int16_t *input, uint16_t len, int16_t *buf,
-                           uint16_t buf_len, uint16_t *buf_cnt)
+// append one sample to a window, the oldest one is dropped when it is full
+static void window_append(int16_t *win, uint16_t win_len, uint16_t *win_cnt,
+                          int16_t data)
 {
-    uint16_t i = 0, j = 0;
-    if (!input || !buf || !buf_cnt || buf_len == 0) {
-        return ALGO_ERR_GENERIC;
-    }
-    if (*buf_cnt + len <= buf_len) {
-        for (i = 0; i < len; i++) {
-            buf[(*buf_cnt)++] = input[i];
-        }
-    } else {
-        if (len >= buf_len) {
-            for (i = 0; i < buf_len; i++) {
-                buf[i] = input[len - buf_len + i];
-            }
-        } else {
-            j = len + (*buf_cnt) - buf_len;
-            for (i = j; i < (*buf_cnt); i++) {
-                buf[i - j] = buf[i];
-            }
-            for (i = 0; i < len; i++) {
-                buf[buf_len - len + i] = input[i];
-            }
-        }
-        *buf_cnt = buf_len;
+    if (*win_cnt >= win_len) {
+        memmove(win, win + 1, (win_len - 1) * sizeof(int16_t));
+        *win_cnt = win_len - 1;
     }
-    return ALGO_NORMAL;
+    win[(*win_cnt)++] = data;
 }
 
 static AlgoError acc_data_preprocess(AccInput *acc_input,
                                      MeanFilterHub *filter_hub,
                                      AccDataHub *acc_data_hub)
 {
-    AlgoError ret = ALGO_ERR_GENERIC;
-    int16_t data  = 0;
-    uint16_t i = 0, j = 0, array_cnt = 0;
+    AlgoError ret   = ALGO_ERR_GENERIC;
+    uint16_t stride = 0;
+    uint16_t i = 0, j = 0;
     MeanOutput mean_output;
-    int16_t array[WIN_LEN] = { 0 };
+    const int16_t *data = NULL;
 
     if (!acc_input || !filter_hub || !acc_data_hub ||
         acc_input->len > WIN_LEN) {
         return ALGO_ERR_GENERIC;
     }
+    stride = acc_input->stride > 1 ? acc_input->stride : 1;
 
     int16_t *arr_p[6] = { acc_input->gyro_x, acc_input->gyro_y,
                           acc_input->gyro_z, acc_input->x,
                           acc_input->y,      acc_input->z };
 
-    MeanFilterGroup *filt_p[6] = { &(filter_hub->gyro_x), &(filter_hub->gyro_y),
-                                   &(filter_hub->gyro_z), &(filter_hub->x),
-                                   &(filter_hub->y),      &(filter_hub->z) };
-    int16_t *acc_win_p[6]      = {
+    MeanFilterGroup *filt_p[6] = {
+        &(filter_hub->gyro_x), &(filter_hub->gyro_y), &(filter_hub->gyro_z),
+        &(filter_hub->x),      &(filter_hub->y),      &(filter_hub->z)
+    };
+    int16_t *acc_win_p[6] = {
         acc_data_hub->win.gyro_x, acc_data_hub->win.gyro_y,
         acc_data_hub->win.gyro_z, acc_data_hub->win.x,
         acc_data_hub->win.y,      acc_data_hub->win.z
@@ -550,16 +748,19 @@ static AlgoError acc_data_preprocess(AccInput *acc_input,
     };
 
     for (i = 0; i < 6; i++) {
-        array_cnt = 0;
-        for (j = 0; j < acc_input->len; j++) {
-            data = *(arr_p[i] + j);
-            ret  = group_mean_filtering(data, filt_p[i], &mean_output);
+        if (!arr_p[i]) {
+            return ALGO_ERR_GENERIC;
+        }
+        // filter outputs go straight into the window, the input may be
+        // interleaved with the other axes
+        data = arr_p[i];
+        for (j = 0; j < acc_input->len; j++, data += stride) {
+            ret = group_mean_filtering(*data, filt_p[i], &mean_output);
             if (ret == ALGO_NORMAL) {
-                array[array_cnt++] = mean_output.filt;
+                window_append(acc_win_p[i], acc_data_hub->win.len,
+                              acc_win_cnt[i], mean_output.filt);
             }
         }
-        load_data(array, array_cnt, acc_win_p[i], acc_data_hub->win.len,
-                  acc_win_cnt[i]);
     }
     if (*acc_win_cnt[0] != *acc_win_cnt[1] ||
         *acc_win_cnt[0] != *acc_win_cnt[2]) {
@@ -568,6 +769,24 @@ static AlgoError acc_data_preprocess(AccInput *acc_input,
     return ALGO_NORMAL;
 }
 
+AlgoError acc_input_from_frames(AccInput *acc_input, int16_t *frames,
+                                uint16_t frame_num, uint16_t frame_size)
+{
+    if (!acc_input || !frames || frame_size % sizeof(int16_t) != 0 ||
+        frame_size < 6 * sizeof(int16_t)) {
+        return ALGO_ERR_GENERIC;
+    }
+    acc_input->len    = frame_num;
+    acc_input->gyro_x = frames;
+    acc_input->gyro_y = frames + 1;
+    acc_input->gyro_z = frames + 2;
+    acc_input->x      = frames + 3;
+    acc_input->y      = frames + 4;
+    acc_input->z      = frames + 5;
+    acc_input->stride = frame_size / sizeof(int16_t);
+    return ALGO_NORMAL;
+}
+
 AlgoError step_counter_init(void)
 {
     peak_valley.p_loc = peak_loc;
@@ -575,80 +794,82 @@ AlgoError step_counter_init(void)
 
     peak_valley.v_loc = valley_loc;
     peak_valley.v_cnt = 0;
+    peak_valley.p_val = peak_val;
+    peak_valley.v_val = valley_val;
 
     mean_filter_hub.x.f1.buf      = xmean_filter1_buf;
     mean_filter_hub.x.f1.buf_full = 0;
     mean_filter_hub.x.f1.index    = 0;
     mean_filter_hub.x.f1.len      = MEAN_LEN1;
+    mean_filter_hub.x.f1.sum      = 0;
 
     mean_filter_hub.x.f2.buf      = xmean_filter2_buf;
     mean_filter_hub.x.f2.buf_full = 0;
     mean_filter_hub.x.f2.index    = 0;
     mean_filter_hub.x.f2.len      = MEAN_LEN2;
+    mean_filter_hub.x.f2.sum      = 0;
 
     mean_filter_hub.y.f1.buf      = ymean_filter1_buf;
     mean_filter_hub.y.f1.buf_full = 0;
     mean_filter_hub.y.f1.index    = 0;
     mean_filter_hub.y.f1.len      = MEAN_LEN1;
+    mean_filter_hub.y.f1.sum      = 0;
 
     mean_filter_hub.y.f2.buf      = ymean_filter2_buf;
     mean_filter_hub.y.f2.buf_full = 0;
     mean_filter_hub.y.f2.index    = 0;
     mean_filter_hub.y.f2.len      = MEAN_LEN2;
+    mean_filter_hub.y.f2.sum      = 0;
 
     mean_filter_hub.z.f1.buf      = zmean_filter1_buf;
     mean_filter_hub.z.f1.buf_full = 0;
     mean_filter_hub.z.f1.index    = 0;
     mean_filter_hub.z.f1.len      = MEAN_LEN1;
+    mean_filter_hub.z.f1.sum      = 0;
 
     mean_filter_hub.z.f2.buf      = zmean_filter2_buf;
     mean_filter_hub.z.f2.buf_full = 0;
     mean_filter_hub.z.f2.index    = 0;
     mean_filter_hub.z.f2.len      = MEAN_LEN2;
+    mean_filter_hub.z.f2.sum      = 0;
 
     mean_filter_hub.gyro_x.f1.buf      = x_gyro_mean_filter1_buf;
     mean_filter_hub.gyro_x.f1.buf_full = 0;
     mean_filter_hub.gyro_x.f1.index    = 0;
     mean_filter_hub.gyro_x.f1.len      = MEAN_LEN1;
+    mean_filter_hub.gyro_x.f1.sum      = 0;
 
     mean_filter_hub.gyro_x.f2.buf      = x_gyro_mean_filter2_buf;
     mean_filter_hub.gyro_x.f2.buf_full = 0;
     mean_filter_hub.gyro_x.f2.index    = 0;
     mean_filter_hub.gyro_x.f2.len      = MEAN_LEN2;
+    mean_filter_hub.gyro_x.f2.sum      = 0;
 
     mean_filter_hub.gyro_y.f1.buf      = y_gyro_mean_filter1_buf;
     mean_filter_hub.gyro_y.f1.buf_full = 0;
     mean_filter_hub.gyro_y.f1.index    = 0;
     mean_filter_hub.gyro_y.f1.len      = MEAN_LEN1;
+    mean_filter_hub.gyro_y.f1.sum      = 0;
 
     mean_filter_hub.gyro_y.f2.buf      = y_gyro_mean_filter2_buf;
     mean_filter_hub.gyro_y.f2.buf_full = 0;
     mean_filter_hub.gyro_y.f2.index    = 0;
     mean_filter_hub.gyro_y.f2.len      = MEAN_LEN2;
+    mean_filter_hub.gyro_y.f2.sum      = 0;
 
     mean_filter_hub.gyro_z.f1.buf      = z_gyro_mean_filter1_buf;
     mean_filter_hub.gyro_z.f1.buf_full = 0;
     mean_filter_hub.gyro_z.f1.index    = 0;
     mean_filter_hub.gyro_z.f1.len      = MEAN_LEN1;
+    mean_filter_hub.gyro_z.f1.sum      = 0;
 
     mean_filter_hub.gyro_z.f2.buf      = z_gyro_mean_filter2_buf;
     mean_filter_hub.gyro_z.f2.buf_full = 0;
     mean_filter_hub.gyro_z.f2.index    = 0;
     mean_filter_hub.gyro_z.f2.len      = MEAN_LEN2;
+    mean_filter_hub.gyro_z.f2.sum      = 0;
 
-    acc_data_hub.buf.x          = x_buf;
-    acc_data_hub.buf.x_cnt      = 0;
-    acc_data_hub.buf.y          = y_buf;
-    acc_data_hub.buf.y_cnt      = 0;
-    acc_data_hub.buf.z          = z_buf;
-    acc_data_hub.buf.z_cnt      = 0;
-    acc_data_hub.buf.gyro_x     = x_gyro_buf;
-    acc_data_hub.buf.x_gyro_cnt = 0;
-    acc_data_hub.buf.gyro_y     = y_gyro_buf;
-    acc_data_hub.buf.y_gyro_cnt = 0;
-    acc_data_hub.buf.gyro_z     = z_gyro_buf;
-    acc_data_hub.buf.z_gyro_cnt = 0;
-    acc_data_hub.buf.len        = WIN_LEN;
+    memset(peak_stream, 0, sizeof(peak_stream));
 
     acc_data_hub.win.x          = x_win;
     acc_data_hub.win.x_cnt      = 0;
@@ -710,15 +931,15 @@ float calculateMeanFeature(AccData *arr, int size, int type)
     return sum / size;
 }
 
-// calculate cov matrix
-void calculateCovarianceMatrix(float **arr, int rows, int cols,
-                               float **covMatrix)
+// calculate cov matrix, arr is rows x cols and covMatrix is cols x cols,
+// both row-major, means is caller provided scratch of cols floats
+void calculateCovarianceMatrix(const float *arr, int rows, int cols,
+                               float *means, float *covMatrix)
 {
-    float *means = (float *)malloc(cols * sizeof(float));
     for (int j = 0; j < cols; j++) {
         float sum = 0;
         for (int i = 0; i < rows; i++) {
-            sum += arr[i][j];
+            sum += arr[i * cols + j];
         }
         means[j] = sum / rows;
     }
@@ -727,13 +948,89 @@ void calculateCovarianceMatrix(float **arr, int rows, int cols,
         for (int j = 0; j < cols; j++) {
             float sum = 0;
             for (int k = 0; k < rows; k++) {
-                sum += (arr[k][i] - means[i]) * (arr[k][j] - means[j]);
+                sum += (arr[k * cols + i] - means[i]) *
+                       (arr[k * cols + j] - means[j]);
+            }
+            covMatrix[i * cols + j] = sum / (rows - 1);
+        }
+    }
+}
+
+/**
+ * @brief single pass over the window for both the accel and the gyro triple,
+ * all sums are exact integers and only converted to float at the end
+ */
+static AlgoError window_statistics(AccData *win, uint16_t len,
+                                   TripleStats *acc, TripleStats *gyro)
+{
+    int16_t *axis[6];
+    TripleStats *stats[2] = { acc, gyro };
+    int16_t max[6], min[6];
+    int32_t v[6];
+    int32_t sum[6] = { 0 };
+    int64_t sq[6] = { 0 }, cross[6] = { 0 }, energy[2] = { 0 };
+    int64_t n = len;
+    uint16_t i = 0, k = 0;
+
+    if (!win || !acc || !gyro || len < 2) {
+        return ALGO_ERR_GENERIC;
+    }
+
+    axis[0] = win->x;
+    axis[1] = win->y;
+    axis[2] = win->z;
+    axis[3] = win->gyro_x;
+    axis[4] = win->gyro_y;
+    axis[5] = win->gyro_z;
+    for (k = 0; k < 6; k++) {
+        max[k] = axis[k][0];
+        min[k] = axis[k][0];
+    }
+
+    for (i = 0; i < len; i++) {
+        for (k = 0; k < 6; k++) {
+            v[k] = axis[k][i];
+            sum[k] += v[k];
+            sq[k] += v[k] * v[k];
+            energy[k / 3] += right_shift_square(v[k], 2);
+            if (v[k] > max[k]) {
+                max[k] = v[k];
+            }
+            if (v[k] < min[k]) {
+                min[k] = v[k];
             }
-            covMatrix[i][j] = sum / (rows - 1);
         }
+        cross[0] += v[0] * v[1];
+        cross[1] += v[0] * v[2];
+        cross[2] += v[1] * v[2];
+        cross[3] += v[3] * v[4];
+        cross[4] += v[3] * v[5];
+        cross[5] += v[4] * v[5];
     }
 
-    free(means);
+    for (i = 0; i < 2; i++) {
+        for (k = 0; k < 3; k++) {
+            stats[i]->max[k]  = max[i * 3 + k];
+            stats[i]->min[k]  = min[i * 3 + k];
+            stats[i]->mean[k] = (float)sum[i * 3 + k] / len;
+            stats[i]->var[k] =
+                (float)(n * sq[i * 3 + k] -
+                        (int64_t)sum[i * 3 + k] * sum[i * 3 + k]) /
+                (float)(n * n);
+        }
+        stats[i]->energy = (float)energy[i] / len;
+        stats[i]->cov_xy = fabsf(
+            (float)(n * cross[i * 3] - (int64_t)sum[i * 3] * sum[i * 3 + 1]) /
+            (float)(n * (n - 1)));
+        stats[i]->cov_xz = fabsf((float)(n * cross[i * 3 + 1] -
+                                         (int64_t)sum[i * 3] * sum[i * 3 + 2]) /
+                                 (float)(n * (n - 1)));
+        stats[i]->cov_yz =
+            fabsf((float)(n * cross[i * 3 + 2] -
+                          (int64_t)sum[i * 3 + 1] * sum[i * 3 + 2]) /
+                  (float)(n * (n - 1)));
+    }
+    return ALGO_NORMAL;
 }
 
 float make_peak_sub_mean(uint16_t *p_loc, uint16_t p_cnt)
@@ -760,21 +1057,14 @@ AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
                                int16_t *class)
 {
     uint16_t i = 0, j = 0;
-    int16_t buf_win[BUF_WIN_LEN] = { 0 }; // buffer window len = history buffer
-                                          // + new data buffer
-    uint16_t buf_win_cnt = 0, last_v_loc = 0, left_len = 0;
-    AccData *win = &(acc_data_hub.win), *buf = &(acc_data_hub.buf);
-    int16_t *buf_axis_p[6] = { buf->gyro_x, buf->gyro_y, buf->gyro_z,
-                               buf->x,      buf->y,      buf->z };
+    AccData *win           = &(acc_data_hub.win);
     int16_t *win_axis_p[6] = { win->gyro_x, win->gyro_y, win->gyro_z,
                                win->x,      win->y,      win->z };
-    uint16_t *buf_cnt_p[6] = { &(buf->x_gyro_cnt), &(buf->y_gyro_cnt),
-                               &(buf->z_gyro_cnt), &(buf->x_cnt),
-                               &(buf->y_cnt),      &(buf->z_cnt) };
     uint16_t *win_cnt_p[6] = { &(win->x_gyro_cnt), &(win->y_gyro_cnt),
                                &(win->z_gyro_cnt), &(win->x_cnt),
                                &(win->y_cnt),      &(win->z_cnt) };
-    int16_t buf_win_max = 0, buf_win_min = 0, max_min_diff = 0;
+    int16_t steps_max = 0, steps_min = 0;
+    uint8_t active       = 0;
     int16_t xyz_steps[6] = { 0 };
     AlgoError ret        = ALGO_ERR_GENERIC;
     uint16_t mean_step   = 0;
@@ -784,8 +1074,11 @@ AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
         return ALGO_ERR_GENERIC;
     }
 
+    ALG_PROFILE_BEGIN(window_mark);
     *step_num = 0;
-    ret       = acc_data_preprocess(acc_input, &mean_filter_hub, &acc_data_hub);
+    ALG_PROFILE_BEGIN(preprocess_mark);
+    ret = acc_data_preprocess(acc_input, &mean_filter_hub, &acc_data_hub);
+    ALG_PROFILE_END(PROFILE_PREPROCESS, preprocess_mark);
     if (ret != ALGO_NORMAL) {
         return ret;
     }
@@ -797,6 +1090,7 @@ AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
         acc_data_hub.win.x_gyro_cnt = 0;
         acc_data_hub.win.y_gyro_cnt = 0;
         acc_data_hub.win.z_gyro_cnt = 0;
+        ALG_PROFILE_END(PROFILE_WINDOW, window_mark);
         return ret;
     }
 
@@ -805,125 +1099,39 @@ AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
         // float lambda[6];
         float freq[6];
 
-        int16_t sec_max_x = 0, sec_min_x = 0, sec_max_y = 0, sec_min_y = 0,
-                sec_max_z = 0, sec_min_z = 0;
-        int16_t sec_max_gyro_x = 0, sec_min_gyro_x = 0, sec_max_gyro_y = 0,
-                sec_min_gyro_y = 0, sec_max_gyro_z = 0, sec_min_gyro_z = 0;
-
-        array_max_min(win->x, win->x_cnt, 1, &sec_max_x);
-        array_max_min(win->x, win->x_cnt, -1, &sec_min_x);
-        array_max_min(win->y, win->y_cnt, 1, &sec_max_y);
-        array_max_min(win->y, win->y_cnt, -1, &sec_min_y);
-        array_max_min(win->z, win->z_cnt, 1, &sec_max_z);
-        array_max_min(win->z, win->z_cnt, -1, &sec_min_z);
-        array_max_min(win->gyro_x, win->x_gyro_cnt, 1, &sec_max_gyro_x);
-        array_max_min(win->gyro_x, win->x_gyro_cnt, -1, &sec_min_gyro_x);
-        array_max_min(win->gyro_y, win->y_gyro_cnt, 1, &sec_max_gyro_y);
-        array_max_min(win->gyro_y, win->y_gyro_cnt, -1, &sec_min_gyro_y);
-        array_max_min(win->gyro_z, win->z_gyro_cnt, 1, &sec_max_gyro_z);
-        array_max_min(win->gyro_z, win->z_gyro_cnt, -1, &sec_min_gyro_z);
-        float var_x       = calculateVariance(win->x, win->x_cnt);
-        float var_y       = calculateVariance(win->y, win->y_cnt);
-        float var_z       = calculateVariance(win->z, win->z_cnt);
-        float var_gyro_x  = calculateVariance(win->gyro_x, win->x_gyro_cnt);
-        float var_gyro_y  = calculateVariance(win->gyro_y, win->y_gyro_cnt);
-        float var_gyro_z  = calculateVariance(win->gyro_z, win->z_gyro_cnt);
-        float **cov_input = (float **)malloc((win->x_cnt) * sizeof(float *));
-        mean_acc          = calculateMeanFeature(win, win->x_cnt, 0);
-        mean_gyro         = calculateMeanFeature(win, win->x_cnt, 1);
-        for (int i = 0; i < win->x_cnt; ++i) {
-            cov_input[i] = (float *)malloc(3 * sizeof(float));
-        }
-        for (int j = 0; j < win->x_cnt; ++j) {
-            cov_input[j][0] = win->x[j];
-            cov_input[j][1] = win->y[j];
-            cov_input[j][2] = win->z[j];
-        }
-        float **covariance_matrix = (float **)malloc(3 * sizeof(float *));
-        for (int i = 0; i < 3; i++) {
-            covariance_matrix[i] = (float *)malloc(3 * sizeof(float));
-        }
-        calculateCovarianceMatrix(cov_input, acc_data_hub.win.x_cnt, 3,
-                                  covariance_matrix);
-        float covariance_xy = fabs(covariance_matrix[0][1]);
-        float covariance_xz = fabs(covariance_matrix[0][2]);
-        float covariance_yz = fabs(covariance_matrix[1][2]);
-
-        // gyro
-        for (int j = 0; j < win->x_gyro_cnt; ++j) {
-            cov_input[j][0] = win->gyro_x[j];
-            cov_input[j][1] = win->gyro_y[j];
-            cov_input[j][2] = win->gyro_z[j];
-        }
-        calculateCovarianceMatrix(cov_input, win->x_gyro_cnt, 3,
-                                  covariance_matrix);
-        float covariance_gyro_xy = fabs(covariance_matrix[0][1]);
-        float covariance_gyro_xz = fabs(covariance_matrix[0][2]);
-        float covariance_gyro_yz = fabs(covariance_matrix[1][2]);
-        // free memory
-        for (int i = 0; i < acc_data_hub.win.x_cnt; i++) {
-            free(cov_input[i]);
-        }
-        free(cov_input);
-        for (int i = 0; i < 3; i++) {
-            free(covariance_matrix[i]);
+        TripleStats acc_stats, gyro_stats;
+
+        ALG_PROFILE_BEGIN(statistics_mark);
+        ret = window_statistics(win, win->x_cnt, &acc_stats, &gyro_stats);
+        if (ret != ALGO_NORMAL) {
+            return ret;
         }
-        free(covariance_matrix);
+        ALG_PROFILE_END(PROFILE_STATISTICS, statistics_mark);
+        mean_acc  = gyro_stats.energy;
+        mean_gyro = acc_stats.energy;
 
         for (i = 0; i < 6; i++) {
-            peak_valley.p_cnt = 0;
-            peak_valley.v_cnt = 0;
-
-            buf_win_cnt = 0;
-            if (*buf_cnt_p[i] > 0) {
-                load_data(buf_axis_p[i], *buf_cnt_p[i], buf_win, BUF_WIN_LEN,
-                          &buf_win_cnt);
-                *buf_cnt_p[i] = 0;
+            ALG_PROFILE_BEGIN(peak_mark);
+            // only the new window is scanned, the carried tail is already
+            // summarized in the stream
+            for (j = 0; j < *win_cnt_p[i]; j++) {
+                peak_valley_stream_push(&peak_stream[i], win_axis_p[i][j]);
             }
-            load_data(win_axis_p[i], *win_cnt_p[i], buf_win, BUF_WIN_LEN,
-                      &buf_win_cnt);
             *win_cnt_p[i] = 0;
 
-            array_max_min(buf_win, buf_win_cnt, 1, &buf_win_max);
-            array_max_min(buf_win, buf_win_cnt, -1, &buf_win_min);
-
-            max_min_diff = buf_win_max - buf_win_min;
-            if (max_min_diff > STEP_ACC_DIFF_THRESHOLD) {
-                ret = find_possible_peak_valley(buf_win, buf_win_cnt,
-                                                &peak_valley);
-                if (ret != ALGO_NORMAL) {
-                    break;
-                }
-
-                ret = remove_false_peak_valley(buf_win, buf_win_cnt,
-                                               &peak_valley);
-                if (ret != ALGO_NORMAL) {
-                    break;
-                }
-
-                ret = merge_close_peak_valley(buf_win, &peak_valley);
-                if (ret != ALGO_NORMAL) {
-                    break;
-                }
-
-                ret =
-                    remove_asymmetric_peaks(buf_win, buf_win_cnt, &peak_valley);
-                if (ret != ALGO_NORMAL) {
-                    break;
-                }
-
-                if (peak_valley.v_cnt >= 1) {
-                    last_v_loc = peak_valley.v_loc[peak_valley.v_cnt - 1];
-                    left_len   = buf_win_cnt - last_v_loc + LEFT_DATA_NUM;
-                    if (left_len < BUF_LEN) {
-                        for (j = 0; j < left_len; j++) {
-                            *(buf_axis_p[i] + j) =
-                                buf_win[buf_win_cnt - left_len + j];
-                            (*buf_cnt_p[i])++;
-                        }
-                    }
-                }
+            if (ret == ALGO_NORMAL) {
+                ret = peak_valley_stream_close(&peak_stream[i], &peak_valley,
+                                               &active);
+            }
+            if (ret != ALGO_NORMAL) {
+                // the other axes still take their samples, so that every
+                // stream has seen the same ones
+                ALG_PROFILE_END((AlgProfileStage)(PROFILE_PEAK_GX + i),
+                                peak_mark);
+                continue;
+            }
 
+            if (active) {
                 if (is_p_loc_lt_6 || peak_valley.p_cnt == 0) {
                     is_p_loc_lt_6 = 1;
                     freq[i]       = 0;
@@ -933,26 +1141,37 @@ AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
 
                 xyz_steps[i] = ((peak_valley.p_cnt));
             }
+            ALG_PROFILE_END((AlgProfileStage)(PROFILE_PEAK_GX + i), peak_mark);
+        }
+
+        if (ret != ALGO_NORMAL) {
+            // the window is consumed without a result, every axis starts
+            // over from the next sample
+            for (i = 0; i < 6; i++) {
+                peak_valley_stream_reset(&peak_stream[i]);
+            }
+            ALG_PROFILE_END(PROFILE_WINDOW, window_mark);
+            return ret;
         }
 
         float input_data[20] = {
             mean_gyro,
-            var_gyro_x,
-            var_gyro_y,
-            var_gyro_z,
-            covariance_gyro_xy,
-            covariance_gyro_xz,
-            covariance_gyro_yz,
+            gyro_stats.var[0],
+            gyro_stats.var[1],
+            gyro_stats.var[2],
+            gyro_stats.cov_xy,
+            gyro_stats.cov_xz,
+            gyro_stats.cov_yz,
             freq[0],
             freq[1],
             freq[2],
             mean_acc,
-            var_x,
-            var_y,
-            var_z,
-            covariance_xy,
-            covariance_xz,
-            covariance_yz,
+            acc_stats.var[0],
+            acc_stats.var[1],
+            acc_stats.var[2],
+            acc_stats.cov_xy,
+            acc_stats.cov_xz,
+            acc_stats.cov_yz,
             freq[3],
             freq[4],
             freq[5],
@@ -962,16 +1181,31 @@ AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
         input_layer_data.data = input_data;
         input_layer_data.size = 20;
 
+        ALG_PROFILE_BEGIN(network_mark);
         foward_process(&input_layer_data, class);
+        ALG_PROFILE_END(PROFILE_NETWORK, network_mark);
     }
 
     if (ret == ALGO_NORMAL) {
-        array_max_min(xyz_steps, 6, 1, &buf_win_max);
-        array_max_min(xyz_steps, 6, -1, &buf_win_min);
+        ALG_PROFILE_BEGIN(select_mark);
+        array_max_min(xyz_steps, 6, 1, &steps_max);
+        array_max_min(xyz_steps, 6, -1, &steps_min);
         mean_step = (xyz_steps[0] + xyz_steps[1] + xyz_steps[2] + xyz_steps[3] +
-                     xyz_steps[4] + xyz_steps[5] - buf_win_max - buf_win_min) /
+                     xyz_steps[4] + xyz_steps[5] - steps_max - steps_min) /
                     4;
         *step_num = mean_step;
+        ALG_PROFILE_END(PROFILE_STEP_SELECT, select_mark);
     }
+    ALG_PROFILE_END(PROFILE_WINDOW, window_mark);
     return ret;
 }
+
+AlgoError step_counter_get_profile(AlgProfile *profile)
+{
+    return alg_profile_get(profile) == 0 ? ALGO_NORMAL : ALGO_ERR_GENERIC;
+}
+
+void step_counter_reset_profile(void)
+{
+    alg_profile_reset();
+}
@@ -4,10 +4,22 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <math.h>
+#include "alg_profile.h"
 #define ACC_FS (25)
 
+/**
+ * @brief when set, the algorithm never calls malloc()/free(); any use in
+ * alg_step_counter.c is rejected at compile time
+ */
+#ifndef STEP_COUNTER_ZERO_HEAP
+#define STEP_COUNTER_ZERO_HEAP (1)
+#endif
+
 /**
  * @brief the struct of input data
+ * @param stride: distance between two samples of one axis in int16_t, 0 and 1
+ * both mean six separate arrays; use acc_input_from_frames() to read packed
+ * frames in place
  */
 typedef struct AccInput {
     uint16_t len;
@@ -17,6 +29,7 @@ typedef struct AccInput {
     int16_t *gyro_x;
     int16_t *gyro_y;
     int16_t *gyro_z;
+    uint16_t stride;
 } AccInput;
 
 /**
@@ -37,4 +50,30 @@ AlgoError step_counter_init(void);
 AlgoError step_counter_process(AccInput *acc_input, uint16_t *step_num,
                                int16_t *class);
 
+/**
+ * @brief per stage cycle counters since the last reset, collected only when
+ * the build sets ALG_PROFILE to 1
+ * @param profile: receives the counters, all zero without ALG_PROFILE
+ * @return ALGO_ERR_GENERIC when profiling is not built in
+ */
+AlgoError step_counter_get_profile(AlgProfile *profile);
+
+/**
+ * @brief clear the per stage cycle counters, budgets set with
+ * alg_profile_set_budget() are kept
+ */
+void step_counter_reset_profile(void);
+
+/**
+ * @brief point acc_input at packed frames laid out as gyro_x, gyro_y,
+ * gyro_z, x, y, z (int16_t each, e.g. ImuGyroAccelData) so that they are
+ * read in place
+ * @param frames: the first frame
+ * @param frame_num: number of frames
+ * @param frame_size: bytes from one frame to the next, even and at least
+ * 6 * sizeof(int16_t)
+ */
+AlgoError acc_input_from_frames(AccInput *acc_input, int16_t *frames,
+                                uint16_t frame_num, uint16_t frame_size);
+
 #endif
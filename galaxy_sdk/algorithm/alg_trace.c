@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_trace.c
+ * @brief binary trace ring buffer
+ */
+
+#include "alg_trace.h"
+
+#if ALG_TRACE
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+
+static uint32_t host_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+
+static uint32_t (*trace_clock)(void) = host_clock;
+#else
+static uint32_t (*trace_clock)(void) = NULL;
+#endif
+
+static AlgTrace alg_trace = {
+    ALG_TRACE_MAGIC,
+    ALG_TRACE_VERSION,
+    sizeof(AlgTraceRecord),
+    ALG_TRACE_RECORDS,
+    0,
+    { { 0 } },
+};
+
+void alg_trace_values(uint8_t id, uint8_t type, const void *data, uint16_t n)
+{
+    const uint32_t *value  = data;
+    uint32_t time          = trace_clock ? trace_clock() : 0;
+    AlgTraceRecord *record = NULL;
+    uint16_t done = 0, count = 0;
+    uint8_t part = 0;
+
+    // a span mark is a single record without values
+    do {
+        count  = n - done > ALG_TRACE_VALUES ? ALG_TRACE_VALUES : n - done;
+        record = &alg_trace.record[alg_trace.head % ALG_TRACE_RECORDS];
+        record->time  = time;
+        record->id    = id;
+        record->type  = type;
+        record->part  = part++;
+        record->count = (uint8_t)count;
+        if (count > 0) {
+            memcpy(record->value, value + done, count * sizeof(uint32_t));
+        }
+        alg_trace.head++;
+        done += count;
+    } while (done < n);
+}
+
+void alg_trace_set_clock(uint32_t (*clock)(void))
+{
+    trace_clock = clock;
+}
+
+void alg_trace_reset(void)
+{
+    alg_trace.head = 0;
+}
+
+const AlgTrace *alg_trace_get(void)
+{
+    return &alg_trace;
+}
+
+int alg_trace_save(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    int ret  = 0;
+
+    if (!fp) {
+        return -1;
+    }
+    if (fwrite(&alg_trace, sizeof(alg_trace), 1, fp) != 1) {
+        ret = -1;
+    }
+    if (fclose(fp) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+#endif
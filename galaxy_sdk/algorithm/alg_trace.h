@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file alg_trace.h
+ * @brief binary trace of intermediate tensors and timings, decoded offline by
+ * alg_trace_decode.py. Everything compiles to nothing unless ALG_TRACE is 1.
+ */
+
+#ifndef __ALG_TRACE_H_
+#define __ALG_TRACE_H_
+
+#include <stdint.h>
+
+#ifndef ALG_TRACE
+#define ALG_TRACE (0)
+#endif
+
+#define ALG_TRACE_MAGIC   (0x45435254u) /* "TRCE" */
+#define ALG_TRACE_VERSION (1)
+#define ALG_TRACE_VALUES  (6) /* values per record */
+
+/* ring size in records of 32 bytes */
+#ifndef ALG_TRACE_RECORDS
+#define ALG_TRACE_RECORDS (512)
+#endif
+
+/* ids of the trace points, alg_trace_decode.py reads the names from here */
+typedef enum AlgTraceId {
+    TRACE_STEP_PROCESS = 1, /* span of step_counter_ctx_process() */
+    TRACE_STEP_FEATURE,     /* the 20 classifier inputs of a window */
+    TRACE_STEP_RESULT,      /* step_num, class */
+    TRACE_NET_FORWARD,      /* span of foward_process() */
+    TRACE_NET_INPUT,        /* network input after any in place scaling */
+    TRACE_NET_HIDDEN,       /* hidden layer after the ReLU */
+    TRACE_NET_OUTPUT,       /* last linear layer, before max_pool */
+    TRACE_NET_CLASS,        /* the class */
+} AlgTraceId;
+
+typedef enum AlgTraceType {
+    TRACE_TYPE_FLOAT = 0,
+    TRACE_TYPE_INT,
+    TRACE_TYPE_BEGIN, /* start of a span, no values */
+    TRACE_TYPE_END,   /* end of a span, no values */
+} AlgTraceType;
+
+/**
+ * @brief one record, a tensor longer than ALG_TRACE_VALUES takes several
+ * records with part 0, 1, ...
+ * @param time: clock at the trace point, see alg_trace_set_clock()
+ */
+typedef struct AlgTraceRecord {
+    uint32_t time;
+    uint8_t id;
+    uint8_t type;
+    uint8_t part;
+    uint8_t count;
+    union {
+        float f;
+        int32_t i;
+    } value[ALG_TRACE_VALUES];
+} AlgTraceRecord;
+
+/**
+ * @brief the ring as the decoder reads it, a raw memory dump of it is a
+ * valid trace file
+ * @param head: records written so far, the next one goes to
+ * head % record_num
+ */
+typedef struct AlgTrace {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t record_num;
+    uint32_t head;
+    AlgTraceRecord record[ALG_TRACE_RECORDS];
+} AlgTrace;
+
+#if ALG_TRACE
+
+#define ALG_TRACE_FLOATS(id, data, n) \
+    alg_trace_values((id), TRACE_TYPE_FLOAT, (data), (n))
+#define ALG_TRACE_INTS(id, data, n) \
+    alg_trace_values((id), TRACE_TYPE_INT, (data), (n))
+#define ALG_TRACE_BEGIN(id) alg_trace_values((id), TRACE_TYPE_BEGIN, 0, 0)
+#define ALG_TRACE_END(id)   alg_trace_values((id), TRACE_TYPE_END, 0, 0)
+
+/**
+ * @brief append n 32-bit values of data (float or int32_t by type), the
+ * oldest records are overwritten when the ring is full. Not reentrant.
+ */
+void alg_trace_values(uint8_t id, uint8_t type, const void *data, uint16_t n);
+
+/**
+ * @brief timestamp source, e.g. the low word of a cycle counter. Hosts
+ * default to a nanosecond clock, other targets to 0 until one is set.
+ */
+void alg_trace_set_clock(uint32_t (*clock)(void));
+
+/**
+ * @brief drop all records
+ */
+void alg_trace_reset(void);
+
+/**
+ * @brief the ring, e.g. to send it off the device
+ */
+const AlgTrace *alg_trace_get(void);
+
+/**
+ * @brief write the ring to path for alg_trace_decode.py
+ * @return 0 on success, -1 otherwise
+ */
+int alg_trace_save(const char *path);
+
+#else
+
+#define ALG_TRACE_FLOATS(id, data, n) ((void)0)
+#define ALG_TRACE_INTS(id, data, n)   ((void)0)
+#define ALG_TRACE_BEGIN(id)           ((void)0)
+#define ALG_TRACE_END(id)             ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file host_sim.c
+ * @brief runs task_sensor and task_algo of the firmware on Linux, fed from
+ * IMU_Dataset, and reports the sample to result latency, the occupancy of
+ * the queues between them and what they dropped:
+ *
+ *   host_sim [-x speed] [-f frames] [-b] [-v] [RECORDING...]
+ *
+ * RECORDING is an IMU_Dataset directory or recording, or an imu_archive
+ * archive, a walk recording by default. The latency of a result is from
+ * the moment the newest frame of its window was sampled to the return of
+ * step_counter_process(), which the Makefile wraps at link time
+ * (-Wl,--wrap), in device milliseconds.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "osal_task_api.h"
+#include "osal_semaphore_api.h"
+#include "hal_imu.h"
+#include "sensor_task.h"
+#include "algo_task.h"
+#include "algorithm/alg_step_counter.h"
+#include "host_sim.h"
+
+#define HOST_SIM_CLASSES (11)   /* classes of the network in algorithm/ */
+#define HOST_SIM_SETTLE  (2000) /* device ms without a result to stop */
+
+/* the change of work mode task is not run, its semaphore is never given */
+OsalSemaphore sem_mode;
+
+/* results seen by __wrap_step_counter_process() */
+static struct {
+    uint64_t *latency; /* host ns */
+    uint64_t num;
+    uint64_t cap;
+    uint64_t untimed; /* calls whose newest frame is no longer stamped */
+    uint64_t steps;
+    uint64_t class_num[HOST_SIM_CLASSES + 1]; /* the last for bad ones */
+    uint64_t busy_ns;
+    uint64_t last_ns;
+} host_result;
+
+static const char *default_recording =
+    "IMU_Dataset/walk/IMU-2023-05-15-16_34_51_walk.txt";
+
+AlgoError __real_step_counter_process(AccInput *acc_input, uint16_t *step_num,
+                                      int16_t *class);
+
+// the newest frame of the window was packed by the driver, its sensortime
+// is the frame number the IMU gave it
+AlgoError __wrap_step_counter_process(AccInput *acc_input, uint16_t *step_num,
+                                      int16_t *class)
+{
+    const uint8_t *frame = NULL;
+    uint64_t start = host_sim_now_ns(), end = 0, sampled = 0, *grown = NULL;
+    uint32_t seq  = 0;
+    int16_t kept  = class ? *class : 0;
+    AlgoError ret = ALGO_NORMAL;
+
+    // class is only written when a window is classified, tell those apart
+    // and leave the caller's value as it was otherwise
+    if (class) {
+        *class = INT16_MIN;
+    }
+    ret = __real_step_counter_process(acc_input, step_num, class);
+
+    end = host_sim_now_ns();
+    if (acc_input && acc_input->len > 0 && acc_input->stride > 1) {
+        frame = (const uint8_t *)acc_input->gyro_x +
+                (size_t)(acc_input->len - 1) * acc_input->stride *
+                    sizeof(int16_t);
+        memcpy(&seq, frame + offsetof(ImuGyroAccelData, sensortime),
+               sizeof(seq));
+        sampled = host_imu_sample_ns(seq);
+    }
+
+    host_sim_lock();
+    host_result.busy_ns += end - start;
+    host_result.last_ns = end;
+    if (ret == ALGO_NORMAL && step_num) {
+        host_result.steps += *step_num;
+    }
+    if (class && *class == INT16_MIN) {
+        *class = kept;
+    } else if (ret == ALGO_NORMAL && class) {
+        host_result.class_num[*class >= 0 && *class < HOST_SIM_CLASSES
+                                  ? *class
+                                  : HOST_SIM_CLASSES]++;
+    }
+    if (sampled == 0) {
+        host_result.untimed++;
+    } else {
+        if (host_result.num == host_result.cap) {
+            host_result.cap = host_result.cap > 0 ? 2 * host_result.cap : 4096;
+            grown = realloc(host_result.latency,
+                            host_result.cap * sizeof(uint64_t));
+            if (grown) {
+                host_result.latency = grown;
+            } else {
+                host_result.cap = host_result.num;
+            }
+        }
+        if (host_result.num < host_result.cap) {
+            host_result.latency[host_result.num++] = end - sampled;
+        }
+    }
+    host_sim_unlock();
+    return ret;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// host ns as device ms
+static double device_ms(uint64_t ns)
+{
+    return ns * host_sim_config.speed * 1e-6;
+}
+
+static void print_report(uint64_t wall_ns)
+{
+    HostSimStats *s = &host_sim_stats;
+    uint64_t calls = host_result.num + host_result.untimed, windows = 0;
+    uint16_t c     = 0;
+
+    for (c = 0; c <= HOST_SIM_CLASSES; c++) {
+        windows += host_result.class_num[c];
+    }
+
+    printf("%u recordings, %llu frames at %d Hz x%g in %.3f s\n",
+           host_imu_recordings(), (unsigned long long)s->frames, HOST_SIM_FS,
+           host_sim_config.speed, wall_ns * 1e-9);
+    printf("imu        fifo peak %u / %u frames, overflow %llu frames, "
+           "%llu interrupts\n",
+           s->imu_max, host_sim_config.imu_fifo,
+           (unsigned long long)s->imu_overflow,
+           (unsigned long long)s->imu_irq);
+    printf("sensor     %llu reads, %llu short (frames discarded), "
+           "%llu packets\n",
+           (unsigned long long)s->imu_reads,
+           (unsigned long long)s->short_reads,
+           (unsigned long long)s->fifo_writes);
+    printf("fc_verify  peak %u / %u packets, mean %.2f at write, "
+           "%llu dropped full, %llu read\n",
+           s->fifo_max, s->fifo_size,
+           s->fifo_writes > 0 ? (double)s->fifo_sum / s->fifo_writes : 0.0,
+           (unsigned long long)s->fifo_full,
+           (unsigned long long)s->fifo_reads);
+    printf("events     %llu delivered, %llu dropped, queue peak %u / %d\n",
+           (unsigned long long)s->events, (unsigned long long)s->event_drops,
+           s->event_max, HOST_SIM_EVENT_QUEUE);
+    printf("algo       %llu calls, %llu windows classified, %llu steps, "
+           "%.1f us per call, %llu BLE packets\n",
+           (unsigned long long)calls, (unsigned long long)windows,
+           (unsigned long long)host_result.steps,
+           calls > 0 ? host_result.busy_ns * 1e-3 / calls : 0.0,
+           (unsigned long long)s->ble_packets);
+    printf("classes   ");
+    for (c = 0; c <= HOST_SIM_CLASSES; c++) {
+        if (host_result.class_num[c] > 0) {
+            printf(" %s%u:%llu", c == HOST_SIM_CLASSES ? "bad" : "", c,
+                   (unsigned long long)host_result.class_num[c]);
+        }
+    }
+    printf("\n");
+    if (host_result.num > 0) {
+        qsort(host_result.latency, host_result.num, sizeof(uint64_t),
+              compare_u64);
+        printf("latency    sample to result p50 %.1f ms, p99 %.1f ms, "
+               "max %.1f ms (device time)\n",
+               device_ms(host_result.latency[(host_result.num - 1) / 2]),
+               device_ms(
+                   host_result.latency[(host_result.num - 1) * 99 / 100]),
+               device_ms(host_result.latency[host_result.num - 1]));
+    }
+    if (s->task_exits > 0) {
+        printf("%u task(s) returned, see -v for why\n", s->task_exits);
+    }
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-x speed] [-f frames] [-b] [-v] [RECORDING...]\n"
+           "  RECORDING  IMU_Dataset directory or recording, or imu_archive "
+           "archive, %s by default\n"
+           "  -x         device time per host time, 1 (real time) by "
+           "default\n"
+           "  -f         IMU FIFO depth in frames, %d by default\n"
+           "  -b         BLE connected, the tasks send their packets\n"
+           "  -v         print uart_printf() output\n",
+           name, default_recording, HOST_SIM_IMU_FIFO);
+}
+
+int main(int argc, char **argv)
+{
+    char *fallback = (char *)default_recording;
+    uint64_t start = 0, idle = 0;
+    uint32_t exits = 0;
+    int opt = 0, fifo = HOST_SIM_IMU_FIFO;
+
+    while ((opt = getopt(argc, argv, "x:f:bvh")) != -1) {
+        switch (opt) {
+        case 'x':
+            host_sim_config.speed = atof(optarg);
+            break;
+        case 'f':
+            fifo = atoi(optarg);
+            break;
+        case 'b':
+            host_sim_config.ble_connected = 1;
+            break;
+        case 'v':
+            host_sim_config.verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (host_sim_config.speed <= 0 || fifo < HOST_SIM_WATERMARK ||
+        fifo > HOST_SIM_IMU_FIFO) {
+        usage(argv[0]);
+        return 1;
+    }
+    host_sim_config.imu_fifo = (uint16_t)fifo;
+    if (optind == argc ? host_imu_open(&fallback, 1) != 0
+                       : host_imu_open(argv + optind, argc - optind) != 0) {
+        printf("Fail to add the recordings\n");
+        return 1;
+    }
+
+    // as task_init_app() creates them, the IMU starts in task_sensor
+    start = host_sim_now_ns();
+    if (!osal_create_task(task_sensor, "task_sensor", 512, 4, NULL) ||
+        !osal_create_task(task_algo, "task_algo", 512, 3, NULL)) {
+        printf("Fail to create the tasks\n");
+        return 1;
+    }
+
+    // stop once every frame is sampled, or a task returned, and no result
+    // came for a while
+    while (1) {
+        host_sim_sleep_ms(HOST_SIM_SETTLE / 10);
+        host_sim_lock();
+        idle  = host_sim_now_ns() -
+               (host_result.last_ns > 0 ? host_result.last_ns : start);
+        exits = host_sim_stats.task_exits;
+        host_sim_unlock();
+        if ((host_imu_done() || exits > 0) &&
+            device_ms(idle) >= HOST_SIM_SETTLE) {
+            break;
+        }
+    }
+
+    print_report(host_sim_now_ns() - start);
+    // the tasks never return, leave them blocked
+    fflush(stdout);
+    _exit(exits > 0 ? 1 : 0);
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file host_sim.h
+ * @brief Linux host simulation of the firmware task pipeline: task_sensor
+ * and task_algo run unchanged on pthread based OSAL, vpi_fifo and
+ * vpi_event stand-ins, fed by an ImuDevice that plays IMU_Dataset
+ * recordings at their sample rate, optionally sped up. Time is kept on the
+ * device scale: osal_sleep() and the sample period are divided by the
+ * speed up and the reported latencies multiplied by it.
+ */
+
+#ifndef _HOST_SIM_H_
+#define _HOST_SIM_H_
+
+#include <stdint.h>
+
+#define HOST_SIM_FS          (25)    /* Hz, as SAMPLE_RATE */
+#define HOST_SIM_IMU_FIFO    (64)    /* frames the IMU FIFO holds */
+#define HOST_SIM_WATERMARK   (6)     /* frames that raise the data pin */
+#define HOST_SIM_EVENT_QUEUE (16)    /* pending events per manager */
+#define HOST_SIM_STAMPS      (65536) /* sample times kept, power of 2 */
+
+/**
+ * @brief run time options
+ * @param speed: device time per host time, 1 for real time
+ * @param imu_fifo: IMU FIFO depth in frames, at most HOST_SIM_IMU_FIFO
+ * @param ble_connected: ble_get_connect_state() result, so that the BLE
+ * paths of both tasks run
+ * @param verbose: forward uart_printf() to stdout
+ */
+typedef struct HostSimConfig {
+    double speed;
+    uint16_t imu_fifo;
+    uint8_t ble_connected;
+    uint8_t verbose;
+} HostSimConfig;
+
+/* counters, written by the stand-ins and read by host_sim.c */
+typedef struct HostSimStats {
+    uint64_t frames;        /* sampled by the IMU */
+    uint64_t imu_overflow;  /* frames lost to a full IMU FIFO */
+    uint16_t imu_max;       /* IMU FIFO peak, frames */
+    uint64_t imu_irq;       /* data pin interrupts */
+    uint64_t imu_reads;     /* hal_imu_read_gyro_accel() calls */
+    uint64_t short_reads;   /* of them with fewer frames than asked */
+    uint64_t fifo_writes;   /* vpi_fifo packets in */
+    uint64_t fifo_reads;    /* vpi_fifo packets out */
+    uint64_t fifo_full;     /* vpi_fifo_is_full() true, packet dropped */
+    uint64_t fifo_sum;      /* vpi_fifo occupancy summed at every write */
+    uint16_t fifo_max;      /* vpi_fifo peak, packets */
+    uint16_t fifo_size;     /* vpi_fifo depth, packets */
+    uint64_t events;        /* vpi_event_notify() deliveries */
+    uint64_t event_drops;   /* deliveries to a full manager queue */
+    uint16_t event_max;     /* event queue peak */
+    uint64_t ble_packets;   /* raw data and result packets sent */
+    uint64_t uart_lines;    /* uart_printf() calls */
+    uint32_t task_exits;    /* tasks that returned */
+} HostSimStats;
+
+extern HostSimConfig host_sim_config;
+extern HostSimStats host_sim_stats;
+
+/* host monotonic time */
+uint64_t host_sim_now_ns(void);
+
+/* sleep ms of device time */
+void host_sim_sleep_ms(double ms);
+
+/* sleep until host time ns */
+void host_sim_sleep_until(uint64_t ns);
+
+/* the locks of the stand-ins and of the counters */
+void host_sim_lock(void);
+void host_sim_unlock(void);
+
+/**
+ * @brief prepare the IMU of the board with the recordings at paths, as
+ * imu_dataset_add() takes them. Sampling starts at imu_init(), a frame
+ * every 1000 / HOST_SIM_FS ms of device time.
+ * @return 0 on success, -1 when a path cannot be added
+ */
+int host_imu_open(char **paths, int path_num);
+
+/* 1 when every frame has been sampled */
+int host_imu_done(void);
+
+/* recordings host_imu_open() found */
+uint32_t host_imu_recordings(void);
+
+/* host time frame seq was sampled at, 0 when no longer known */
+uint64_t host_imu_sample_ns(uint32_t seq);
+
+void host_imu_close(void);
+
+#endif
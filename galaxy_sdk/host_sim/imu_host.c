@@ -0,0 +1,244 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file imu_host.c
+ * @brief the IMU of the board for the Linux host simulation: a thread plays
+ * IMU_Dataset recordings back to back into a FIFO at the sample rate and
+ * raises the data pin when HOST_SIM_WATERMARK frames are waiting. A full
+ * FIFO drops its oldest frame, as the IMU does in stream mode. Every frame
+ * carries its number in sensortime so that a result can be traced back to
+ * when its newest frame was sampled.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alg_imu_dataset.h"
+#include "hal_imu.h"
+#include "board.h"
+#include "imu/imu_init.h"
+#include "vpi_error.h"
+#include "host_sim.h"
+
+struct ImuDevice {
+    ImuDataset set;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    uint8_t started;
+    uint8_t done;
+    uint8_t armed;
+    ImuDataReadyHandler data_ready;
+    ImuGyroAccelData fifo[HOST_SIM_IMU_FIFO];
+    uint16_t head;
+    uint16_t num;
+    uint32_t seq; /* frames sampled */
+    uint64_t stamp[HOST_SIM_STAMPS];
+    uint32_t stamp_seq[HOST_SIM_STAMPS];
+};
+
+static ImuDevice imu_host;
+
+// the handler to call when the armed data pin sees the watermark, the pin
+// fires once until it is armed again; called with the lock held
+static ImuDataReadyHandler imu_fire(ImuDevice *dev)
+{
+    if (!dev->armed || !dev->data_ready || dev->num < HOST_SIM_WATERMARK) {
+        return NULL;
+    }
+    dev->armed = 0;
+    host_sim_lock();
+    host_sim_stats.imu_irq++;
+    host_sim_unlock();
+    return dev->data_ready;
+}
+
+static void imu_push(ImuDevice *dev, const ImuRecording *rec, uint32_t i)
+{
+    ImuGyroAccelData *frame = NULL;
+    ImuDataReadyHandler fire = NULL;
+    uint32_t slot = dev->seq & (HOST_SIM_STAMPS - 1);
+
+    pthread_mutex_lock(&dev->lock);
+    if (dev->num == host_sim_config.imu_fifo) {
+        dev->head = (uint16_t)((dev->head + 1) % host_sim_config.imu_fifo);
+        dev->num--;
+        host_sim_lock();
+        host_sim_stats.imu_overflow++;
+        host_sim_unlock();
+    }
+    frame = &dev->fifo[(dev->head + dev->num) % host_sim_config.imu_fifo];
+    frame->gx         = rec->gyro_x[i];
+    frame->gy         = rec->gyro_y[i];
+    frame->gz         = rec->gyro_z[i];
+    frame->ax         = rec->x[i];
+    frame->ay         = rec->y[i];
+    frame->az         = rec->z[i];
+    frame->sensortime = dev->seq;
+    dev->num++;
+    dev->stamp[slot]     = host_sim_now_ns();
+    dev->stamp_seq[slot] = dev->seq++;
+    host_sim_lock();
+    host_sim_stats.frames++;
+    if (dev->num > host_sim_stats.imu_max) {
+        host_sim_stats.imu_max = dev->num;
+    }
+    host_sim_unlock();
+    fire = imu_fire(dev);
+    pthread_mutex_unlock(&dev->lock);
+    if (fire) {
+        fire();
+    }
+}
+
+static void *imu_thread(void *arg)
+{
+    ImuDevice *dev = arg;
+    ImuRecording store, rec;
+    uint64_t start = host_sim_now_ns(), n = 0;
+    double period  = 1e9 / HOST_SIM_FS / host_sim_config.speed; /* host ns */
+    uint32_t t = 0, i = 0;
+
+    imu_recording_init(&store, NULL, 0);
+    for (t = 0; t < dev->set.num; t++) {
+        if (imu_dataset_recording(&dev->set, t, &store, &rec, NULL) !=
+            ALGO_NORMAL) {
+            printf("Fail to load %s/%s\n", dev->set.entry[t].label,
+                   dev->set.entry[t].name);
+            continue;
+        }
+        // on a fixed schedule, a late frame does not delay the next ones
+        for (i = 0; i < rec.len; i++) {
+            host_sim_sleep_until(start + (uint64_t)(++n * period));
+            imu_push(dev, &rec, i);
+        }
+    }
+    imu_recording_free(&store);
+    pthread_mutex_lock(&dev->lock);
+    dev->done = 1;
+    pthread_mutex_unlock(&dev->lock);
+    return NULL;
+}
+
+int host_imu_open(char **paths, int path_num)
+{
+    int i = 0;
+
+    memset(&imu_host, 0, sizeof(imu_host));
+    pthread_mutex_init(&imu_host.lock, NULL);
+    imu_dataset_init(&imu_host.set);
+    for (i = 0; i < path_num; i++) {
+        if (imu_dataset_add(&imu_host.set, paths[i]) != ALGO_NORMAL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int host_imu_start(void)
+{
+    if (imu_host.started ||
+        pthread_create(&imu_host.thread, NULL, imu_thread, &imu_host) != 0) {
+        return -1;
+    }
+    imu_host.started = 1;
+    return 0;
+}
+
+int host_imu_done(void)
+{
+    int done = 0;
+
+    pthread_mutex_lock(&imu_host.lock);
+    done = imu_host.done;
+    pthread_mutex_unlock(&imu_host.lock);
+    return done;
+}
+
+uint32_t host_imu_recordings(void)
+{
+    return imu_host.set.num;
+}
+
+uint64_t host_imu_sample_ns(uint32_t seq)
+{
+    uint32_t slot = seq & (HOST_SIM_STAMPS - 1);
+    uint64_t ns   = 0;
+
+    pthread_mutex_lock(&imu_host.lock);
+    if (imu_host.stamp_seq[slot] == seq) {
+        ns = imu_host.stamp[slot];
+    }
+    pthread_mutex_unlock(&imu_host.lock);
+    return ns;
+}
+
+void host_imu_close(void)
+{
+    if (imu_host.started) {
+        pthread_join(imu_host.thread, NULL);
+        imu_host.started = 0;
+    }
+    imu_dataset_free(&imu_host.set);
+}
+
+void *board_find_device_by_id(uint8_t device_id)
+{
+    return device_id == IMU_SENSOR_ID ? &imu_host : NULL;
+}
+
+// powers the IMU up, sampling starts here
+int imu_init(ImuDevice *imu_dev)
+{
+    if (imu_dev != &imu_host) {
+        return VPI_ERR_NODEVICE;
+    }
+    return host_imu_start() == 0 ? VPI_SUCCESS : VPI_ERR_GENERIC;
+}
+
+int hal_imu_read_gyro_accel(ImuDevice *dev, ImuGyroAccelData *gyro_accel_data,
+                            uint16_t frame_request, uint16_t *available_frame)
+{
+    uint16_t n = 0, i = 0;
+
+    if (!dev || !gyro_accel_data || !available_frame) {
+        return VPI_ERR_INVALID;
+    }
+    pthread_mutex_lock(&dev->lock);
+    n = dev->num < frame_request ? dev->num : frame_request;
+    for (i = 0; i < n; i++) {
+        gyro_accel_data[i] = dev->fifo[dev->head];
+        dev->head = (uint16_t)((dev->head + 1) % host_sim_config.imu_fifo);
+    }
+    dev->num -= n;
+    pthread_mutex_unlock(&dev->lock);
+    *available_frame = n;
+    host_sim_lock();
+    host_sim_stats.imu_reads++;
+    host_sim_stats.short_reads += n < frame_request;
+    host_sim_unlock();
+    return VPI_SUCCESS;
+}
+
+int hal_imu_enable_interrupt(ImuDevice *dev, uint8_t pin, bool enable,
+                             ImuDataReadyHandler data_ready_callback)
+{
+    ImuDataReadyHandler fire = NULL;
+
+    if (!dev) {
+        return VPI_ERR_INVALID;
+    }
+    // the wake pin never fires, the recordings have no motion detection
+    if (pin != IMU_DATA_PIN) {
+        return VPI_SUCCESS;
+    }
+    pthread_mutex_lock(&dev->lock);
+    dev->armed      = enable;
+    dev->data_ready = data_ready_callback;
+    fire            = imu_fire(dev);
+    pthread_mutex_unlock(&dev->lock);
+    if (fire) {
+        fire();
+    }
+    return VPI_SUCCESS;
+}
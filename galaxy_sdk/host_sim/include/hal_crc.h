@@ -0,0 +1,41 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file hal_crc.h
+ * @brief the part of drivers/inc/hal_crc.h crc_calculate.c uses, for the
+ * Linux host simulation, computed in software
+ */
+
+#ifndef _HAL_CRC_H_
+#define _HAL_CRC_H_
+
+#include <stdint.h>
+#include "vsd_error.h"
+
+typedef enum {
+    CRC_POLYNOMIAL_CRC_8 = 1, /**< 8-bit CRC-8 */
+} CrcPolynomial;
+
+typedef enum {
+    CRC_LMS_LSB, /**<Generates CRC for LSB first */
+    CRC_LMS_MSB, /**<Generates CRC for MSB first */
+} CrcCalSwitch;
+
+typedef struct CrcInput {
+    void *p_buffer;
+    uint32_t buffer_length; /* bytes */
+    uint8_t poly;
+    uint8_t cal_switch;
+} CrcInput;
+
+typedef struct CrcDevice {
+    uint32_t capability;
+} CrcDevice;
+
+CrcDevice *hal_crc_get_device(void);
+
+int hal_crc_init(void);
+
+int hal_crc_calculate(CrcInput *crc_input, uint32_t *crc_result);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file hal_imu.h
+ * @brief the part of drivers/inc/hal_imu.h the tasks use, for the Linux
+ * host simulation. ImuDevice is a recording player, see host_sim/imu_host.c.
+ */
+
+#ifndef _HALIMU_H_
+#define _HALIMU_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal_gpio.h"
+
+typedef void (*ImuDataReadyHandler)(void);
+
+/**
+ * @brief IMU pin type
+ */
+enum ImuPinType {
+    IMU_DATA_PIN = 1, /**< data pin */
+    IMU_WAKE_PIN, /**< wake pin */
+    IMU_POWER_PIN, /**< power pin */
+};
+
+/**
+ * @brief Structure of IMU gyro and accel data, as the driver packs it
+ */
+typedef struct _ImuGyroAccelData {
+    int16_t gx;
+    int16_t gy;
+    int16_t gz;
+    int16_t ax;
+    int16_t ay;
+    int16_t az;
+    /** sensor time or data set index, the frame number in the simulation */
+    union {
+        uint32_t sensortime;
+        uint32_t data_set_idx;
+    };
+} __attribute((__packed__)) ImuGyroAccelData;
+
+typedef struct ImuDevice ImuDevice;
+
+/**
+ * @brief read up to frame_request frames from the FIFO of the IMU
+ * @param available_frame: frames read, fewer when the FIFO holds fewer
+ */
+int hal_imu_read_gyro_accel(ImuDevice *dev, ImuGyroAccelData *gyro_accel_data,
+                            uint16_t frame_request, uint16_t *available_frame);
+
+/**
+ * @brief arm the interrupt of pin, it fires once and is armed again by the
+ * next call
+ */
+int hal_imu_enable_interrupt(ImuDevice *dev, uint8_t pin, bool enable,
+                             ImuDataReadyHandler data_ready_callback);
+
+#endif
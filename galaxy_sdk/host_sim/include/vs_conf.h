@@ -0,0 +1,19 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file vs_conf.h
+ * @brief configuration of the Linux host simulation, in place of
+ * config/inc/vs_conf.h. The OSAL types come from the bare metal adapter and
+ * are backed by pthreads in host_sim/osal_host.c.
+ */
+
+#ifndef _VS_CONF_HOST_SIM_H_
+#define _VS_CONF_HOST_SIM_H_
+
+#define CONFIG_HOST_SIM 1
+#define CONFIG_BAREMETAL 1
+#define CONFIG_LOG_LEVEL 2
+#define CONFIG_MANUFACTURER_NAME "VeriSilicon"
+#define CONFIG_MANUFACTURER_MODEL "CocopalmR"
+
+#endif
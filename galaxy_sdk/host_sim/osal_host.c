@@ -0,0 +1,245 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file osal_host.c
+ * @brief OSAL tasks, semaphores, sleep and heap on pthreads for the Linux
+ * host simulation. Task priorities and stack sizes are ignored, every task
+ * is a thread the host schedules. Semaphores are binary, as the tasks use
+ * them for interrupt handshakes.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "osal_task_api.h"
+#include "osal_semaphore_api.h"
+#include "osal_heap_api.h"
+#include "host_sim.h"
+
+typedef struct HostTask {
+    pthread_t thread;
+    void (*func)(void *param);
+    void *param;
+    char name[24];
+} HostTask;
+
+typedef struct HostSem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t given;
+} HostSem;
+
+HostSimConfig host_sim_config = { 1.0, HOST_SIM_IMU_FIFO, 0, 0 };
+HostSimStats host_sim_stats;
+
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t host_sim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void host_deadline(struct timespec *ts, double ms)
+{
+    uint64_t ns = (uint64_t)(ms * 1e6 / host_sim_config.speed);
+
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000u);
+    ts->tv_nsec = (long)(ns % 1000000000u);
+}
+
+void host_sim_sleep_ms(double ms)
+{
+    struct timespec ts;
+
+    host_deadline(&ts, ms);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+}
+
+void host_sim_sleep_until(uint64_t ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = (time_t)(ns / 1000000000u);
+    ts.tv_nsec = (long)(ns % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+}
+
+void host_sim_lock(void)
+{
+    pthread_mutex_lock(&host_lock);
+}
+
+void host_sim_unlock(void)
+{
+    pthread_mutex_unlock(&host_lock);
+}
+
+static void *host_task_main(void *arg)
+{
+    HostTask *task = arg;
+
+    task->func(task->param);
+    host_sim_lock();
+    host_sim_stats.task_exits++;
+    host_sim_unlock();
+    return NULL;
+}
+
+void *osal_create_task(void *func, char *name, uint32_t stack_size,
+                       uint32_t task_priority, void *param)
+{
+    HostTask *task = calloc(1, sizeof(HostTask));
+
+    (void)stack_size;
+    (void)task_priority;
+    if (!task) {
+        return NULL;
+    }
+    task->func  = (void (*)(void *))func;
+    task->param = param;
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    if (pthread_create(&task->thread, NULL, host_task_main, task) != 0) {
+        free(task);
+        return NULL;
+    }
+    pthread_detach(task->thread);
+    return task;
+}
+
+// NULL or the calling task ends it, as vTaskDelete(NULL); other tasks
+// cannot be stopped from outside a pthread and keep running
+void osal_delete_task(void *task)
+{
+    HostTask *host = task;
+
+    if (!host || pthread_equal(host->thread, pthread_self())) {
+        host_sim_lock();
+        host_sim_stats.task_exits++;
+        host_sim_unlock();
+        pthread_exit(NULL);
+    }
+}
+
+void osal_suspend_all(void)
+{
+    host_sim_lock();
+}
+
+void osal_resume_all(void)
+{
+    host_sim_unlock();
+}
+
+void osal_sleep(int32_t ms)
+{
+    host_sim_sleep_ms(ms);
+}
+
+void osal_start_scheduler(void)
+{
+}
+
+void osal_end_scheduler(void)
+{
+}
+
+bool osal_started(void)
+{
+    return true;
+}
+
+int osal_init_sem(OsalSemaphore *sem)
+{
+    HostSem *host = calloc(1, sizeof(HostSem));
+    pthread_condattr_t attr;
+
+    if (!sem || !host) {
+        free(host);
+        return OSAL_FALSE;
+    }
+    // timed waits count on the clock of host_deadline()
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&host->lock, NULL);
+    pthread_cond_init(&host->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    sem->semaphore = host;
+    return OSAL_TRUE;
+}
+
+int osal_delete_sem(OsalSemaphore *sem)
+{
+    HostSem *host = sem ? sem->semaphore : NULL;
+
+    if (!host) {
+        return OSAL_FALSE;
+    }
+    pthread_cond_destroy(&host->cond);
+    pthread_mutex_destroy(&host->lock);
+    free(host);
+    sem->semaphore = NULL;
+    return OSAL_TRUE;
+}
+
+int osal_sem_wait(OsalSemaphore *sem, uint32_t timeout)
+{
+    HostSem *host = sem ? sem->semaphore : NULL;
+    struct timespec ts;
+    int ret = 0;
+
+    if (!host) {
+        return OSAL_FALSE;
+    }
+    if (timeout != OSAL_WAIT_FOREVER) {
+        host_deadline(&ts, timeout);
+    }
+    pthread_mutex_lock(&host->lock);
+    while (!host->given && ret != ETIMEDOUT) {
+        ret = timeout == OSAL_WAIT_FOREVER
+                  ? pthread_cond_wait(&host->cond, &host->lock)
+                  : pthread_cond_timedwait(&host->cond, &host->lock, &ts);
+    }
+    ret          = host->given ? OSAL_TRUE : OSAL_FALSE;
+    host->given  = 0;
+    pthread_mutex_unlock(&host->lock);
+    return ret;
+}
+
+int osal_sem_post(OsalSemaphore *sem)
+{
+    HostSem *host = sem ? sem->semaphore : NULL;
+
+    if (!host) {
+        return OSAL_FALSE;
+    }
+    pthread_mutex_lock(&host->lock);
+    host->given = 1;
+    pthread_cond_signal(&host->cond);
+    pthread_mutex_unlock(&host->lock);
+    return OSAL_TRUE;
+}
+
+int osal_sem_post_isr(OsalSemaphore *sem)
+{
+    return osal_sem_post(sem);
+}
+
+void *osal_malloc(size_t len)
+{
+    return malloc(len);
+}
+
+void osal_free(void *pmem)
+{
+    free(pmem);
+}
@@ -0,0 +1,349 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file vpi_host.c
+ * @brief vpi_fifo, vpi_event and the board services the tasks touch (UART,
+ * BLE, packet statistics, GPIO, CRC, RTC) for the Linux host simulation.
+ * The FIFO and the event queues count what host_sim.c reports.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vpi_error.h"
+#include "vpi_fifo.h"
+#include "vpi_event.h"
+#include "vpi_packet_statistics.h"
+#include "sensor_service.h"
+#include "hal_crc.h"
+#include "hal_rtc.h"
+#include "gpio.h"
+#include "uart_printf.h"
+#include "host_sim.h"
+
+/* an event waiting in the queue of a manager */
+typedef struct HostEvent {
+    uint32_t event_id;
+    void *param;
+} HostEvent;
+
+typedef struct HostManager {
+    uint32_t id;
+    EventHandler handler;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    HostEvent queue[HOST_SIM_EVENT_QUEUE];
+    uint16_t head;
+    uint16_t num;
+    struct HostManager *next; /* next listener of the same event */
+} HostManager;
+
+/* listeners of every event, a manager listens to one event at most */
+static HostManager *event_listener[EVENT_SDK_END];
+
+static CrcDevice crc_device_host = { 1u << CRC_POLYNOMIAL_CRC_8 };
+
+GpioPort led_blue_port;
+GpioPort led_green_port;
+
+FifoCtrl *vpi_fifo_init(uint8_t *buf, uint16_t itemsize, uint16_t itemtotal)
+{
+    FifoCtrl *fifo = NULL;
+
+    if (!buf || itemsize == 0 || itemtotal == 0 ||
+        (fifo = calloc(1, sizeof(FifoCtrl))) == NULL) {
+        return NULL;
+    }
+    fifo->buffer      = buf;
+    fifo->item_size   = itemsize;
+    fifo->item_total  = itemtotal;
+    fifo->buffer_size = (uint16_t)(itemsize * itemtotal);
+    host_sim_lock();
+    host_sim_stats.fifo_size = itemtotal;
+    host_sim_unlock();
+    return fifo;
+}
+
+int vpi_fifo_write(FifoCtrl *fifo, void *data)
+{
+    int ret = VPI_SUCCESS;
+
+    if (!fifo || !data) {
+        return VPI_ERR_INVALID;
+    }
+    host_sim_lock();
+    if (fifo->item_stored == fifo->item_total) {
+        ret = VPI_ERR_FULL;
+    } else {
+        memcpy(fifo->buffer + fifo->wt_idx * fifo->item_size, data,
+               fifo->item_size);
+        fifo->wt_idx = (uint16_t)((fifo->wt_idx + 1) % fifo->item_total);
+        fifo->item_stored++;
+        host_sim_stats.fifo_writes++;
+        host_sim_stats.fifo_sum += fifo->item_stored;
+        if (fifo->item_stored > host_sim_stats.fifo_max) {
+            host_sim_stats.fifo_max = fifo->item_stored;
+        }
+    }
+    host_sim_unlock();
+    return ret;
+}
+
+int vpi_fifo_read(FifoCtrl *fifo, void *data)
+{
+    int ret = VPI_SUCCESS;
+
+    if (!fifo || !data) {
+        return VPI_ERR_INVALID;
+    }
+    host_sim_lock();
+    if (fifo->item_stored == 0) {
+        ret = VPI_ERR_EMPTY;
+    } else {
+        memcpy(data, fifo->buffer + fifo->rd_idx * fifo->item_size,
+               fifo->item_size);
+        fifo->rd_idx = (uint16_t)((fifo->rd_idx + 1) % fifo->item_total);
+        fifo->item_stored--;
+        host_sim_stats.fifo_reads++;
+    }
+    host_sim_unlock();
+    return ret;
+}
+
+uint16_t vpi_fifo_get_stored_item(FifoCtrl *fifo)
+{
+    uint16_t stored = 0;
+
+    host_sim_lock();
+    stored = fifo ? fifo->item_stored : 0;
+    host_sim_unlock();
+    return stored;
+}
+
+int vpi_fifo_flush(FifoCtrl *fifo)
+{
+    if (!fifo) {
+        return VPI_ERR_INVALID;
+    }
+    host_sim_lock();
+    fifo->item_stored = 0;
+    fifo->wt_idx      = 0;
+    fifo->rd_idx      = 0;
+    host_sim_unlock();
+    return VPI_SUCCESS;
+}
+
+bool vpi_fifo_is_full(FifoCtrl *fifo)
+{
+    bool full = false;
+
+    host_sim_lock();
+    full = fifo && fifo->item_stored == fifo->item_total;
+    host_sim_stats.fifo_full += full;
+    host_sim_unlock();
+    return full;
+}
+
+bool vpi_fifo_is_empty(FifoCtrl *fifo)
+{
+    return vpi_fifo_get_stored_item(fifo) == 0;
+}
+
+void *vpi_event_new_manager(uint32_t manager_id, EventHandler handler)
+{
+    HostManager *manager = calloc(1, sizeof(HostManager));
+
+    if (!manager) {
+        return NULL;
+    }
+    manager->id      = manager_id;
+    manager->handler = handler;
+    pthread_mutex_init(&manager->lock, NULL);
+    pthread_cond_init(&manager->cond, NULL);
+    return manager;
+}
+
+uint32_t vpi_get_manager_id(void *manager)
+{
+    return manager ? ((HostManager *)manager)->id : COBJ_NULL;
+}
+
+int vpi_event_register(uint32_t event_id, void *listener)
+{
+    HostManager *manager = listener;
+
+    if (!manager || event_id >= EVENT_SDK_END) {
+        return EVENT_ERROR;
+    }
+    host_sim_lock();
+    manager->next            = event_listener[event_id];
+    event_listener[event_id] = manager;
+    host_sim_unlock();
+    return EVENT_OK;
+}
+
+// queue the event on every listener, an event that finds a queue full is
+// lost for that listener and fails the call
+int vpi_event_notify(uint32_t event_id, void *param)
+{
+    HostManager *manager = NULL;
+    int ret              = EVENT_OK;
+
+    if (event_id >= EVENT_SDK_END) {
+        return EVENT_ERROR;
+    }
+    host_sim_lock();
+    manager = event_listener[event_id];
+    host_sim_unlock();
+    for (; manager; manager = manager->next) {
+        pthread_mutex_lock(&manager->lock);
+        if (manager->num == HOST_SIM_EVENT_QUEUE) {
+            ret = EVENT_ERROR;
+        } else {
+            manager->queue[(manager->head + manager->num) %
+                           HOST_SIM_EVENT_QUEUE] =
+                (HostEvent){ event_id, param };
+            manager->num++;
+            pthread_cond_signal(&manager->cond);
+        }
+        host_sim_lock();
+        if (ret == EVENT_OK) {
+            host_sim_stats.events++;
+        } else {
+            host_sim_stats.event_drops++;
+        }
+        if (manager->num > host_sim_stats.event_max) {
+            host_sim_stats.event_max = manager->num;
+        }
+        host_sim_unlock();
+        pthread_mutex_unlock(&manager->lock);
+    }
+    return ret;
+}
+
+// wait for one event and hand it to the manager
+int vpi_event_listen(void *listener)
+{
+    HostManager *manager = listener;
+    HostEvent event;
+
+    if (!manager) {
+        return EVENT_ERROR;
+    }
+    pthread_mutex_lock(&manager->lock);
+    while (manager->num == 0) {
+        pthread_cond_wait(&manager->cond, &manager->lock);
+    }
+    event         = manager->queue[manager->head];
+    manager->head = (uint16_t)((manager->head + 1) % HOST_SIM_EVENT_QUEUE);
+    manager->num--;
+    pthread_mutex_unlock(&manager->lock);
+    if (manager->handler) {
+        manager->handler(manager, event.event_id, event.param);
+    }
+    return EVENT_OK;
+}
+
+int uart_printf(const char *format, ...)
+{
+    va_list args;
+    int ret = 0;
+
+    host_sim_lock();
+    host_sim_stats.uart_lines++;
+    host_sim_unlock();
+    if (!host_sim_config.verbose) {
+        return 0;
+    }
+    va_start(args, format);
+    ret = vprintf(format, args);
+    va_end(args);
+    return ret;
+}
+
+uint8_t ble_get_connect_state(void)
+{
+    return host_sim_config.ble_connected ? BLE_STATE_CONNECTED
+                                         : BLE_STATE_DISCONNECTED;
+}
+
+uint8_t ble_sensor_packet_send(BleTransmitData *sen_data)
+{
+    (void)sen_data;
+    host_sim_lock();
+    host_sim_stats.ble_packets++;
+    host_sim_unlock();
+    return 0;
+}
+
+struct PackStatisticsCtrl *vpi_packet_statistics_init(void)
+{
+    static uint8_t ctrl;
+
+    return (struct PackStatisticsCtrl *)&ctrl;
+}
+
+int vpi_packet_statistics_proc(struct PackStatisticsCtrl *ctrl,
+                               BleTransmitData *data)
+{
+    (void)ctrl;
+    return ble_sensor_packet_send(data) == 0 ? VPI_SUCCESS : VPI_ERR_GENERIC;
+}
+
+int gpio_init(GpioPort *gpio)
+{
+    (void)gpio;
+    return VSD_SUCCESS;
+}
+
+CrcDevice *hal_crc_get_device(void)
+{
+    return &crc_device_host;
+}
+
+int hal_crc_init(void)
+{
+    return VSD_SUCCESS;
+}
+
+// CRC-8, polynomial 0x07, MSB first
+int hal_crc_calculate(CrcInput *crc_input, uint32_t *crc_result)
+{
+    const uint8_t *p = NULL;
+    uint8_t crc      = 0;
+    uint32_t i = 0, bit = 0;
+
+    if (!crc_input || !crc_result || !crc_input->p_buffer ||
+        crc_input->poly != CRC_POLYNOMIAL_CRC_8) {
+        return VSD_ERR_GENERIC;
+    }
+    p = crc_input->p_buffer;
+    for (i = 0; i < crc_input->buffer_length; i++) {
+        crc ^= p[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    *crc_result = crc;
+    return VSD_SUCCESS;
+}
+
+// milliseconds of device time since the simulation started
+int hal_get_utc_time(uint64_t *utc)
+{
+    static uint64_t start;
+
+    if (!utc) {
+        return VSD_ERR_GENERIC;
+    }
+    host_sim_lock();
+    if (start == 0) {
+        start = host_sim_now_ns();
+    }
+    *utc = (uint64_t)((host_sim_now_ns() - start) * host_sim_config.speed /
+                      1e6);
+    host_sim_unlock();
+    return VSD_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file imu_archive.c
+ * @brief pack IMU_Dataset recordings into an archive (alg_imu_archive.h)
+ * and list one.
+ *
+ *   imu_archive pack IMU_Dataset.imua $(find IMU_Dataset -name '*.txt' \
+ *       ! -name ReadMe.txt | sort)
+ *   imu_archive list IMU_Dataset.imua
+ *
+ * The label of a recording is the name of the directory holding it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "alg_imu_archive.h"
+
+/* start of the last path component of path[0, len) */
+static const char *path_base(const char *path, size_t len)
+{
+    while (len > 0 && path[len - 1] != '/' && path[len - 1] != '\\') {
+        len--;
+    }
+    return path + len;
+}
+
+/* directory name above file, "" when there is none */
+static void path_label(const char *file, char *label, size_t size)
+{
+    const char *base = path_base(file, strlen(file));
+    size_t end       = (size_t)(base - file);
+    const char *dir  = NULL;
+
+    label[0] = '\0';
+    if (end == 0) {
+        return;
+    }
+    end--; // the separator
+    dir = path_base(file, end);
+    end = (size_t)(file + end - dir);
+    if (end >= size) {
+        end = size - 1;
+    }
+    memcpy(label, dir, end);
+    label[end] = '\0';
+}
+
+static int pack(const char *out, int file_num, char **file)
+{
+    ImuArchiveWriter writer;
+    ImuRecording rec;
+    char label[IMU_ARCHIVE_LABEL];
+    uint64_t frames = 0;
+    uint32_t line   = 0;
+    int i           = 0;
+
+    if (imu_archive_create(&writer, out) != ALGO_NORMAL) {
+        printf("Fail to create %s\n", out);
+        return 1;
+    }
+    imu_recording_init(&rec, NULL, 0);
+    for (i = 0; i < file_num; i++) {
+        if (imu_recording_load(&rec, file[i], &line) != ALGO_NORMAL) {
+            printf("Fail to load %s (line %u)\n", file[i], line);
+            break;
+        }
+        path_label(file[i], label, sizeof(label));
+        if (imu_archive_add(&writer, label,
+                            path_base(file[i], strlen(file[i])), &rec,
+                            ACC_FS) != ALGO_NORMAL) {
+            printf("Fail to add %s\n", file[i]);
+            break;
+        }
+        frames += rec.len;
+    }
+    imu_recording_free(&rec);
+    if (imu_archive_finish(&writer) != ALGO_NORMAL || i < file_num) {
+        printf("Fail to write %s\n", out);
+        remove(out);
+        return 1;
+    }
+    printf("%d recordings, %llu frames\n", file_num,
+           (unsigned long long)frames);
+    return 0;
+}
+
+static int list(const char *path)
+{
+    ImuArchive archive;
+    const ImuArchiveRecord *record = NULL;
+    uint32_t i                     = 0;
+
+    if (imu_archive_open(&archive, path) != ALGO_NORMAL) {
+        printf("%s is not an IMU archive\n", path);
+        return 1;
+    }
+    printf("%-16s %-40s %8s %4s\n", "label", "name", "frames", "fs");
+    for (i = 0; i < archive.header->record_num; i++) {
+        record = &archive.record[i];
+        printf("%-16s %-40s %8u %4u\n", imu_archive_label(&archive, i),
+               record->name, record->frames, record->sample_rate);
+    }
+    imu_archive_close(&archive);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "pack") == 0) {
+        return pack(argv[2], argc - 3, argv + 3);
+    }
+    if (argc == 3 && strcmp(argv[1], "list") == 0) {
+        return list(argv[2]);
+    }
+    printf("usage: %s pack ARCHIVE FILE...\n"
+           "       %s list ARCHIVE\n",
+           argv[0], argv[0]);
+    return 1;
+}
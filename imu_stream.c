@@ -0,0 +1,246 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file imu_stream.c
+ * @brief runs the step counter on frames as they arrive on stdin or a FIFO
+ * and writes one JSON line per processed second:
+ *
+ *   imu_stream [-b frame_bytes] [PATH]
+ *   {"frame":43,"steps":2,"total":2,"class":-1,"latency_us":11.4}
+ *
+ * Frames are text lines as in IMU_Dataset (alg_imu_loader.h) or, with -b,
+ * packed little endian int16_t gyro_x, gyro_y, gyro_z, x, y, z followed by
+ * frame_bytes - 12 bytes that are skipped (16 for ImuGyroAccelData). They
+ * are fed to step_counter_ctx_process() in main.c's chunks: ACC_FS - 5 - 2
+ * frames first, then ACC_FS. frame is the number of frames consumed, steps
+ * the steps of the chunk, class the window class or -1 when the chunk closed
+ * no window, and latency_us the time from the read() that completed the
+ * chunk to its line being written.
+ *
+ * Memory is fixed, a step counter context and one read buffer, whatever the
+ * length of the stream, and nothing runs between reads: many streams each
+ * in its own imu_stream cost little more than their pipes.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "alg_step_counter.h"
+#include "alg_imu_loader.h"
+#include "MyNN/alg_mlp_network.h"
+
+#define STREAM_HEAD      (ACC_FS - 5 - 2) /* frames of the first chunk */
+#define STREAM_BUF       (8192)           /* bytes read at once */
+#define STREAM_FRAME_MAX (64)             /* largest binary frame, bytes */
+
+/**
+ * @brief state of the stream
+ * @param text: frames of the chunk being filled from text lines
+ * @param chunk: frames in the chunk being filled
+ * @param frames: frames consumed so far
+ * @param line: lines read so far
+ */
+typedef struct ImuStream {
+    StepCounterCtx ctx;
+    ImuRecording text;
+    int16_t text_buf[IMU_AXES * ACC_FS];
+    uint16_t chunk;
+    uint64_t frames;
+    uint64_t steps;
+    uint32_t line;
+    uint32_t bad_lines;
+    uint64_t arrival_ns; /* return of the read() that gave the newest data */
+} ImuStream;
+
+static ImuStream stream;
+
+/* bytes read and not consumed yet, text lines or binary frames */
+static char stream_buf[STREAM_BUF] __attribute__((aligned(8)));
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// frames needed before the next step_counter_ctx_process() call
+static uint16_t chunk_len(const ImuStream *s)
+{
+    return s->frames == 0 ? STREAM_HEAD : ACC_FS;
+}
+
+static AlgoError process_chunk(ImuStream *s, AccInput *acc_input)
+{
+    StepCounterOutput output;
+
+    if (step_counter_ctx_process(&s->ctx, acc_input, &output) !=
+        ALGO_NORMAL) {
+        return ALGO_ERR_GENERIC;
+    }
+    s->frames += acc_input->len;
+    s->steps += output.step_num;
+    printf("{\"frame\":%llu,\"steps\":%u,\"total\":%llu,\"class\":%d,"
+           "\"latency_us\":%.1f}\n",
+           (unsigned long long)s->frames, output.step_num,
+           (unsigned long long)s->steps, output.class,
+           (now_ns() - s->arrival_ns) * 1e-3);
+    return ALGO_NORMAL;
+}
+
+// one text line without its '\n', a bad line is reported and skipped
+static AlgoError stream_line(ImuStream *s, const char *line, size_t len)
+{
+    AccInput acc_input = { 0, NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+    uint32_t bad       = 0;
+
+    s->line++;
+    if (imu_recording_parse(&s->text, line, len, &bad) != ALGO_NORMAL) {
+        fprintf(stderr, "Bad data at line %u\n", s->line);
+        s->bad_lines++;
+        return ALGO_NORMAL;
+    }
+    if (s->text.len < chunk_len(s)) {
+        return ALGO_NORMAL;
+    }
+    imu_recording_window(&s->text, 0, (uint16_t)s->text.len, &acc_input);
+    if (process_chunk(s, &acc_input) != ALGO_NORMAL) {
+        return ALGO_ERR_GENERIC;
+    }
+    return imu_recording_init(&s->text, s->text_buf, ACC_FS);
+}
+
+// complete lines of buf[0, len), returns the bytes consumed
+static size_t stream_text(ImuStream *s, char *buf, size_t len, int eof,
+                          AlgoError *ret)
+{
+    char *p = buf, *end = buf + len, *nl = NULL;
+
+    *ret = ALGO_NORMAL;
+    while (p < end && *ret == ALGO_NORMAL) {
+        nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) {
+            if (!eof) {
+                break;
+            }
+            nl = end; // the last line may lack its '\n'
+        }
+        *ret = stream_line(s, p, (size_t)(nl - p));
+        p    = nl < end ? nl + 1 : end;
+    }
+    return (size_t)(p - buf);
+}
+
+// whole chunks of buf[0, len) read in place, returns the bytes consumed
+static size_t stream_binary(ImuStream *s, char *buf, size_t len,
+                            uint16_t frame_bytes, AlgoError *ret)
+{
+    AccInput acc_input = { 0, NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+    size_t used        = 0;
+
+    *ret = ALGO_NORMAL;
+    while (len - used >= (size_t)chunk_len(s) * frame_bytes &&
+           *ret == ALGO_NORMAL) {
+        acc_input_from_frames(&acc_input, (int16_t *)(buf + used),
+                              chunk_len(s), frame_bytes);
+        used += (size_t)acc_input.len * frame_bytes;
+        *ret = process_chunk(s, &acc_input);
+    }
+    return used;
+}
+
+// read fd to its end, consuming what arrives as soon as it arrives
+static AlgoError stream_run(ImuStream *s, int fd, uint16_t frame_bytes)
+{
+    AlgoError ret = ALGO_NORMAL;
+    size_t len = 0, used = 0;
+    ssize_t n = 0;
+
+    while (ret == ALGO_NORMAL) {
+        n = read(fd, stream_buf + len, sizeof(stream_buf) - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "Fail to read: %s\n", strerror(errno));
+            return ALGO_ERR_GENERIC;
+        }
+        s->arrival_ns = now_ns();
+        len += (size_t)n;
+        used = frame_bytes > 0
+                   ? stream_binary(s, stream_buf, len, frame_bytes, &ret)
+                   : stream_text(s, stream_buf, len, n == 0, &ret);
+        memmove(stream_buf, stream_buf + used, len - used);
+        len -= used;
+        if (n == 0) {
+            break;
+        }
+        if (len == sizeof(stream_buf)) {
+            fprintf(stderr, "Line %u longer than %d bytes\n", s->line + 1,
+                    STREAM_BUF);
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    // frames short of a chunk at the end are not processed, as in main.c
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-b frame_bytes] [PATH]\n"
+            "  PATH  file or FIFO to read, stdin by default\n"
+            "  -b    packed binary frames of frame_bytes bytes (12 to %d, "
+            "even) instead of text lines\n",
+            name, STREAM_FRAME_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    AlgoError ret = ALGO_NORMAL;
+    int opt = 0, fd = STDIN_FILENO, frame_bytes = 0;
+
+    while ((opt = getopt(argc, argv, "b:h")) != -1) {
+        switch (opt) {
+        case 'b':
+            frame_bytes = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind + 1 < argc ||
+        (frame_bytes != 0 &&
+         (frame_bytes < IMU_AXES * (int)sizeof(int16_t) ||
+          frame_bytes > STREAM_FRAME_MAX || frame_bytes % 2 != 0))) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (optind < argc && (fd = open(argv[optind], O_RDONLY)) < 0) {
+        fprintf(stderr, "Fail to open %s: %s\n", argv[optind],
+                strerror(errno));
+        return 1;
+    }
+    // a reader at the other end of a pipe wants every line when it is made
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (networks_init() != ALGO_NORMAL ||
+        step_counter_ctx_init(&stream.ctx) != ALGO_NORMAL ||
+        imu_recording_init(&stream.text, stream.text_buf, ACC_FS) !=
+            ALGO_NORMAL) {
+        fprintf(stderr, "Fail to initialize the step counter\n");
+        return 1;
+    }
+    ret = stream_run(&stream, fd, (uint16_t)frame_bytes);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    if (stream.bad_lines > 0) {
+        fprintf(stderr, "%u bad lines skipped\n", stream.bad_lines);
+    }
+    return ret == ALGO_NORMAL ? 0 : 1;
+}
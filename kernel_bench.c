@@ -0,0 +1,560 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file kernel_bench.c
+ * @brief times every hot kernel of the step counter and its networks on
+ * windows of IMU_Dataset recordings, and writes the results as JSON so
+ * that two commits can be diffed:
+ *
+ *   kernel_bench [-r rounds] [-t ms] [-o out.json] [-b base.json] [-c]
+ *                [RECORDING...]
+ *
+ * RECORDING is an IMU_Dataset file or an imu_archive archive, a walk
+ * recording by default. Every kernel is run over all of its inputs in a
+ * pass, passes are repeated to fill -t ms per round and the median of the
+ * rounds is reported. The passes of the pruning kernels and of
+ * batch_normal1d() restore their input before every call, which is timed
+ * with them. The triple_sums() kernels are also timed one by one, and -c
+ * only checks them against each other instead of timing anything.
+ *
+ * Allocations are counted by wrapping malloc(), calloc() and realloc() at
+ * link time (-Wl,--wrap), which the Makefile does with GNU ld; without it
+ * they are reported as null.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "kernel_bench.h"
+#include "alg_imu_archive.h"
+#include "MyNN/alg_mlp_network.h"
+
+#ifndef KERNEL_BENCH_WRAP_MALLOC
+#define KERNEL_BENCH_WRAP_MALLOC (0)
+#endif
+
+/* git revision the bench was built from, recorded in the JSON */
+#ifndef KERNEL_BENCH_REV
+#define KERNEL_BENCH_REV ""
+#endif
+
+#define KERNEL_BENCH_MAX    (32) /* kernels */
+#define KERNEL_BENCH_ROUNDS (15) /* most rounds of -r */
+
+static const char *default_recording =
+    "IMU_Dataset/walk/IMU-2023-05-15-16_34_51_walk.txt";
+
+typedef struct KernelBenchResult {
+    const char *name;
+    uint32_t calls;
+    uint32_t samples;
+    uint32_t per_window;
+    double ns_per_call;
+    double cycles_per_call;
+    double allocs_per_call; /* < 0 when not counted */
+} KernelBenchResult;
+
+static struct {
+    uint16_t rounds;
+    uint64_t round_ns;
+    uint16_t result_num;
+    KernelBenchResult result[KERNEL_BENCH_MAX];
+} kernel_bench;
+
+#if KERNEL_BENCH_WRAP_MALLOC
+static uint64_t alloc_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t num, size_t size)
+{
+    alloc_count++;
+    return __real_calloc(num, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* TSC ticks on x86 hosts and nanoseconds on other hosts, as alg_profile.h */
+static uint64_t now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+static const char *cycle_unit(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc";
+#else
+    return "ns";
+#endif
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void kernel_bench_run(const KernelBench *bench)
+{
+    KernelBenchResult *result = NULL;
+    double ns[KERNEL_BENCH_ROUNDS], cycles[KERNEL_BENCH_ROUNDS];
+    uint64_t start = 0, start_cycles = 0, elapsed = 0, reps = 1, r = 0;
+    uint64_t allocs = 0;
+    uint16_t i = 0;
+
+    if (kernel_bench.result_num >= KERNEL_BENCH_MAX || bench->calls == 0) {
+        return;
+    }
+
+    // one pass to warm up, then as many passes as fill a round
+    start = now_ns();
+    bench->pass(bench->ctx);
+    elapsed = now_ns() - start;
+    if (elapsed < kernel_bench.round_ns) {
+        reps = kernel_bench.round_ns / (elapsed > 0 ? elapsed : 1);
+    }
+
+#if KERNEL_BENCH_WRAP_MALLOC
+    allocs = alloc_count;
+#endif
+    for (i = 0; i < kernel_bench.rounds; i++) {
+        start        = now_ns();
+        start_cycles = now_cycles();
+        for (r = 0; r < reps; r++) {
+            bench->pass(bench->ctx);
+        }
+        cycles[i] = (double)(now_cycles() - start_cycles) /
+                    ((double)reps * bench->calls);
+        ns[i] = (double)(now_ns() - start) / ((double)reps * bench->calls);
+    }
+    qsort(ns, kernel_bench.rounds, sizeof(double), compare_double);
+    qsort(cycles, kernel_bench.rounds, sizeof(double), compare_double);
+
+    result                  = &kernel_bench.result[kernel_bench.result_num++];
+    result->name            = bench->name;
+    result->calls           = bench->calls;
+    result->samples         = bench->samples;
+    result->per_window      = bench->per_window;
+    result->ns_per_call     = ns[kernel_bench.rounds / 2];
+    result->cycles_per_call = cycles[kernel_bench.rounds / 2];
+#if KERNEL_BENCH_WRAP_MALLOC
+    result->allocs_per_call = (double)(alloc_count - allocs) /
+                              ((double)kernel_bench.rounds * reps *
+                               bench->calls);
+#else
+    (void)allocs;
+    result->allocs_per_call = -1;
+#endif
+}
+
+uint32_t kernel_bench_chunk_num(const ImuRecording *rec)
+{
+    if (rec->len < KERNEL_BENCH_HEAD) {
+        return 0;
+    }
+    return 1 + (rec->len - KERNEL_BENCH_HEAD) / ACC_FS;
+}
+
+void kernel_bench_chunk(const ImuRecording *rec, uint32_t n,
+                        AccInput *acc_input)
+{
+    if (n == 0) {
+        imu_recording_window(rec, 0, KERNEL_BENCH_HEAD, acc_input);
+    } else {
+        imu_recording_window(rec, KERNEL_BENCH_HEAD + (n - 1) * ACC_FS,
+                             ACC_FS, acc_input);
+    }
+}
+
+/* every recording given, loaded files and archives mapped */
+typedef struct BenchData {
+    uint32_t rec_num;
+    ImuRecording *rec;
+    uint32_t archive_num;
+    ImuArchive *archive;
+} BenchData;
+
+static ImuRecording *data_add(BenchData *data)
+{
+    ImuRecording *rec = realloc(data->rec, (data->rec_num + 1) *
+                                               sizeof(ImuRecording));
+    if (!rec) {
+        return NULL;
+    }
+    data->rec = rec;
+    return &data->rec[data->rec_num++];
+}
+
+static int data_load(BenchData *data, const char *path)
+{
+    ImuArchive archive, *archives = NULL;
+    ImuRecording *rec = NULL;
+    uint32_t line = 0, i = 0;
+
+    if (imu_archive_open(&archive, path) == ALGO_NORMAL) {
+        archives = realloc(data->archive, (data->archive_num + 1) *
+                                              sizeof(ImuArchive));
+        if (!archives) {
+            imu_archive_close(&archive);
+            return -1;
+        }
+        data->archive                      = archives;
+        data->archive[data->archive_num++] = archive;
+        for (i = 0; i < archive.header->record_num; i++) {
+            if (!(rec = data_add(data))) {
+                return -1;
+            }
+            imu_archive_recording(&archive, i, rec);
+        }
+        return 0;
+    }
+    if (!(rec = data_add(data))) {
+        return -1;
+    }
+    imu_recording_init(rec, NULL, 0);
+    if (imu_recording_load(rec, path, &line) != ALGO_NORMAL) {
+        if (line > 0) {
+            printf("Bad data at line %u of %s\n", line, path);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static void data_free(BenchData *data)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < data->rec_num; i++) {
+        imu_recording_free(&data->rec[i]);
+    }
+    for (i = 0; i < data->archive_num; i++) {
+        imu_archive_close(&data->archive[i]);
+    }
+    free(data->rec);
+    free(data->archive);
+}
+
+static int input_alloc(KernelBenchInput *input, const BenchData *data)
+{
+    uint32_t i = 0, n = 0;
+    uint16_t k = 0;
+
+    memset(input, 0, sizeof(KernelBenchInput));
+    for (i = 0; i < data->rec_num; i++) {
+        input->frames     += data->rec[i].len;
+        input->chunk_num  += kernel_bench_chunk_num(&data->rec[i]);
+        input->window_cap += data->rec[i].len / WIN_LEN + 1;
+    }
+    input->sample_num = input->frames * KERNEL_BENCH_AXES;
+
+    input->chunk  = malloc(input->chunk_num * sizeof(AccInput));
+    input->sample = malloc((size_t)input->sample_num * sizeof(int16_t));
+    input->window = malloc((size_t)input->window_cap * KERNEL_BENCH_AXES *
+                           WIN_LEN * sizeof(int16_t));
+    input->sums   = malloc((size_t)input->window_cap * 2 *
+                           sizeof(TripleSums));
+    input->rows   = malloc((size_t)input->window_cap * 2 * WIN_LEN * 3 *
+                           sizeof(float));
+    input->feature = malloc((size_t)input->window_cap * STEP_FEATURE_NUM *
+                            sizeof(FeatureValue));
+    input->feature_float = malloc((size_t)input->window_cap *
+                                  STEP_FEATURE_NUM * sizeof(float));
+    for (k = 0; k < KERNEL_BENCH_PEAK_STAGES; k++) {
+        input->peaks[k] = malloc((size_t)input->window_cap *
+                                 KERNEL_BENCH_AXES *
+                                 sizeof(KernelBenchPeaks));
+        if (!input->peaks[k]) {
+            return -1;
+        }
+    }
+    if (!input->chunk || !input->sample || !input->window || !input->sums ||
+        !input->rows || !input->feature || !input->feature_float) {
+        return -1;
+    }
+
+    // raw samples of each axis in turn, as a filter sees them
+    for (i = 0, n = 0; i < data->rec_num; i++) {
+        const ImuRecording *rec = &data->rec[i];
+        const int16_t *axis[KERNEL_BENCH_AXES] = { rec->gyro_x, rec->gyro_y,
+                                                   rec->gyro_z, rec->x,
+                                                   rec->y,      rec->z };
+        for (k = 0; k < KERNEL_BENCH_AXES; k++) {
+            memcpy(input->sample + n, axis[k], rec->len * sizeof(int16_t));
+            n += rec->len;
+        }
+    }
+    return 0;
+}
+
+static void input_free(KernelBenchInput *input)
+{
+    uint16_t k = 0;
+
+    free(input->chunk);
+    free(input->sample);
+    free(input->window);
+    free(input->sums);
+    free(input->rows);
+    free(input->feature);
+    free(input->feature_float);
+    for (k = 0; k < KERNEL_BENCH_PEAK_STAGES; k++) {
+        free(input->peaks[k]);
+    }
+}
+
+static int input_gather(KernelBenchInput *input, const BenchData *data)
+{
+    uint32_t i = 0, n = 0, c = 0, chunk_num = 0;
+
+    for (i = 0; i < data->rec_num; i++) {
+        chunk_num = kernel_bench_chunk_num(&data->rec[i]);
+        for (n = 0; n < chunk_num; n++) {
+            kernel_bench_chunk(&data->rec[i], n, &input->chunk[c++]);
+        }
+        if (kernel_bench_step_gather(input, &data->rec[i]) != ALGO_NORMAL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void print_table(void)
+{
+    const KernelBenchResult *result = NULL;
+    uint16_t i = 0;
+
+    printf("%-28s %10s %12s %12s %14s %8s\n", "kernel", "calls", "ns/call",
+           "ns/sample", "cycles/window", "allocs");
+    for (i = 0; i < kernel_bench.result_num; i++) {
+        result = &kernel_bench.result[i];
+        printf("%-28s %10u %12.2f %12.3f %14.0f ", result->name,
+               result->calls, result->ns_per_call,
+               result->ns_per_call / result->samples,
+               result->cycles_per_call * result->per_window);
+        if (result->allocs_per_call < 0) {
+            printf("%8s\n", "-");
+        } else {
+            printf("%8.2f\n", result->allocs_per_call);
+        }
+    }
+}
+
+/* one kernel per line, so that two files diff line by line */
+static int write_json(const char *path, const KernelBenchInput *input)
+{
+    FILE *fp = fopen(path, "w");
+    const KernelBenchResult *result = NULL;
+    uint16_t i = 0;
+
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp,
+            "{\n"
+            "  \"revision\": \"%s\",\n"
+            "  \"fixed_point\": %d,\n"
+            "  \"win_len\": %d,\n"
+            "  \"window_stats\": \"%s\",\n"
+            "  \"cycle_unit\": \"%s\",\n"
+            "  \"frames\": %u,\n"
+            "  \"windows\": %u,\n"
+            "  \"rounds\": %u,\n"
+            "  \"kernels\": [\n",
+            KERNEL_BENCH_REV, ALG_FIXED_POINT, WIN_LEN, window_stats_name(),
+            cycle_unit(), input->frames, input->window_num,
+            kernel_bench.rounds);
+    for (i = 0; i < kernel_bench.result_num; i++) {
+        result = &kernel_bench.result[i];
+        fprintf(fp,
+                "    {\"name\": \"%s\", \"calls\": %u, "
+                "\"samples_per_call\": %u, \"calls_per_window\": %u, "
+                "\"ns_per_call\": %.3f, \"ns_per_sample\": %.4f, "
+                "\"cycles_per_call\": %.1f, \"cycles_per_window\": %.0f, ",
+                result->name, result->calls, result->samples,
+                result->per_window, result->ns_per_call,
+                result->ns_per_call / result->samples,
+                result->cycles_per_call,
+                result->cycles_per_call * result->per_window);
+        if (result->allocs_per_call < 0) {
+            fprintf(fp, "\"allocs_per_call\": null}");
+        } else {
+            fprintf(fp, "\"allocs_per_call\": %.3f}",
+                    result->allocs_per_call);
+        }
+        fprintf(fp, i + 1 < kernel_bench.result_num ? ",\n" : "\n");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* ns_per_sample against a JSON file of an earlier run, kernels are matched
+ * by name */
+static int compare_json(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[512], name[64];
+    const char *field = NULL;
+    double base = 0, now = 0;
+    uint16_t i = 0;
+
+    if (!fp) {
+        return -1;
+    }
+    printf("\n%-28s %12s %12s %8s\n", "kernel", "base ns/smp", "ns/sample",
+           "change");
+    while (fgets(line, sizeof(line), fp)) {
+        field = strstr(line, "\"ns_per_sample\": ");
+        if (sscanf(line, " {\"name\": \"%63[^\"]\"", name) != 1 || !field) {
+            continue;
+        }
+        base = strtod(field + strlen("\"ns_per_sample\": "), NULL);
+        for (i = 0; i < kernel_bench.result_num; i++) {
+            if (strcmp(kernel_bench.result[i].name, name) == 0) {
+                break;
+            }
+        }
+        if (i == kernel_bench.result_num || base <= 0) {
+            continue;
+        }
+        now = kernel_bench.result[i].ns_per_call /
+              kernel_bench.result[i].samples;
+        printf("%-28s %12.3f %12.3f %+7.1f%%\n", name, base, now,
+               (now / base - 1) * 100);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-r rounds] [-t ms] [-o out.json] [-b base.json] "
+           "[-c] [RECORDING...]\n"
+           "  RECORDING  IMU_Dataset recording or imu_archive archive, %s "
+           "by default\n"
+           "  -r         rounds, the median is reported, 5 by default, at "
+           "most %d\n"
+           "  -t         least milliseconds per round, 20 by default\n"
+           "  -o         write the results as JSON\n"
+           "  -b         compare with the JSON of an earlier run\n"
+           "  -c         check the window_stats kernels against an int64 "
+           "reference instead, exit status 1 on a mismatch\n",
+           name, default_recording, KERNEL_BENCH_ROUNDS);
+}
+
+int main(int argc, char **argv)
+{
+    BenchData data;
+    KernelBenchInput input;
+    const char *json_path = NULL, *base_path = NULL;
+    int opt = 0, ret = 0, ms = 20, rounds = 5, check = 0;
+
+    while ((opt = getopt(argc, argv, "r:t:o:b:ch")) != -1) {
+        switch (opt) {
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 't':
+            ms = atoi(optarg);
+            break;
+        case 'o':
+            json_path = optarg;
+            break;
+        case 'b':
+            base_path = optarg;
+            break;
+        case 'c':
+            check = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (rounds < 1 || rounds > KERNEL_BENCH_ROUNDS || ms < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    kernel_bench.rounds   = (uint16_t)rounds;
+    kernel_bench.round_ns = (uint64_t)ms * 1000000u;
+
+    memset(&data, 0, sizeof(data));
+    memset(&input, 0, sizeof(input));
+    if (optind == argc) {
+        ret = data_load(&data, default_recording);
+        if (ret != 0) {
+            printf("Fail to load %s\n", default_recording);
+        }
+    }
+    for (; optind < argc && ret == 0; optind++) {
+        ret = data_load(&data, argv[optind]);
+        if (ret != 0) {
+            printf("Fail to load %s\n", argv[optind]);
+        }
+    }
+    if (ret == 0 && networks_init() != ALGO_NORMAL) {
+        ret = -1;
+    }
+    if (ret == 0 && (input_alloc(&input, &data) != 0 ||
+                     input_gather(&input, &data) != 0)) {
+        printf("Fail to prepare the kernel inputs\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && check) {
+        printf("%u recordings, %u windows\n", data.rec_num, input.window_num);
+        if (kernel_bench_window_stats_check(&input) != ALGO_NORMAL) {
+            ret = -1;
+        }
+    } else if (ret == 0) {
+        printf("%u recordings, %u frames, %u windows, %u active window "
+               "axes, window_stats %s\n",
+               data.rec_num, input.frames, input.window_num, input.peak_num,
+               window_stats_name());
+        kernel_bench_step(&input);
+        kernel_bench_window_stats(&input);
+        kernel_bench_networks(&input);
+        print_table();
+        if (json_path && write_json(json_path, &input) != 0) {
+            printf("Fail to write %s\n", json_path);
+            ret = -1;
+        }
+        if (base_path && compare_json(base_path) != 0) {
+            printf("Fail to read %s\n", base_path);
+            ret = -1;
+        }
+    }
+    input_free(&input);
+    data_free(&data);
+    return ret == 0 ? 0 : 1;
+}
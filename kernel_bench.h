@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file kernel_bench.h
+ * @brief harness shared by the kernel_bench translation units. The kernels
+ * are static, so kernel_bench_step.c and kernel_bench_networks.c compile
+ * the module under test in and hand their passes to kernel_bench_run().
+ */
+
+#ifndef __KERNEL_BENCH_H_
+#define __KERNEL_BENCH_H_
+
+#include <stdint.h>
+#include "alg_step_counter.h"
+#include "alg_imu_loader.h"
+
+/**
+ * @brief one pass of a kernel over all of its inputs
+ * @param ctx: KernelBench.ctx
+ */
+typedef void (*KernelBenchPass)(void *ctx);
+
+/**
+ * @brief a kernel to time
+ * @param calls: kernel calls in one pass
+ * @param samples: axis samples (one value of one axis) covered by one call,
+ * ns_per_sample divides by it
+ * @param per_window: calls the pipeline makes in one WIN_LEN window,
+ * cycles_per_window multiplies by it
+ */
+typedef struct KernelBench {
+    const char *name;
+    uint32_t calls;
+    uint32_t samples;
+    uint32_t per_window;
+    KernelBenchPass pass;
+    void *ctx;
+} KernelBench;
+
+/**
+ * @brief raw extrema of one window axis before a pruning pass, as
+ * peak_valley_stream_close() hands them over
+ * @param len: samples in the buffer
+ * @param mean: their mean
+ */
+typedef struct KernelBenchPeaks {
+    uint16_t len;
+    int16_t mean;
+    uint16_t p_cnt;
+    uint16_t v_cnt;
+    uint16_t p_loc[PEAK_VALLEY_NUM];
+    int16_t p_val[PEAK_VALLEY_NUM];
+    uint16_t v_loc[PEAK_VALLEY_NUM];
+    int16_t v_val[PEAK_VALLEY_NUM];
+} KernelBenchPeaks;
+
+/* frames of the first chunk of a recording, the filter delay that main.c
+ * skips so that later chunks fill whole seconds of the window */
+#define KERNEL_BENCH_HEAD (ACC_FS - 5 - 2)
+
+/* axes of a window in ImuRecording order, gyro first */
+#define KERNEL_BENCH_AXES (6)
+
+/* pruning passes in pipeline order, stage i is the input of pass i */
+#define KERNEL_BENCH_PEAK_STAGES (3)
+
+/**
+ * @brief realistic kernel inputs from IMU_Dataset recordings. The arrays
+ * are allocated by kernel_bench.c for the frame count and filled by
+ * kernel_bench_step_gather().
+ * @param chunk: the chunks of every recording, see kernel_bench_chunk()
+ * @param sample: raw samples of every recording, axis after axis
+ * @param window: window_num x KERNEL_BENCH_AXES x WIN_LEN filtered samples
+ * @param sums: window_num x 2 triple_sums() of the windows, accel first
+ * @param rows: window_num x 2 x WIN_LEN x 3 floats, the accel and the gyro
+ * triple of each window as the rows of calculateCovarianceMatrix()
+ * @param peaks: [stage][window axis] of the windows that swing more than
+ * STEP_ACC_DIFF_THRESHOLD, the only ones that are pruned
+ * @param feature: window_num x STEP_FEATURE_NUM classifier inputs of the
+ * pipeline, feature_num rows of them
+ * @param feature_float: the same as floats, for the 5 class network
+ */
+typedef struct KernelBenchInput {
+    uint32_t frames;
+    uint32_t chunk_num;
+    AccInput *chunk;
+    uint32_t sample_num;
+    int16_t *sample;
+    uint32_t window_cap;
+    uint32_t window_num;
+    int16_t *window;
+    TripleSums *sums;
+    float *rows;
+    uint32_t peak_num;
+    KernelBenchPeaks *peaks[KERNEL_BENCH_PEAK_STAGES];
+    uint32_t feature_num;
+    FeatureValue *feature;
+    float *feature_float;
+} KernelBenchInput;
+
+/**
+ * @brief number of chunks rec is replayed in
+ */
+uint32_t kernel_bench_chunk_num(const ImuRecording *rec);
+
+/**
+ * @brief point acc_input at chunk n of rec, KERNEL_BENCH_HEAD frames for
+ * the first and ACC_FS frames after it
+ */
+void kernel_bench_chunk(const ImuRecording *rec, uint32_t n,
+                        AccInput *acc_input);
+
+/**
+ * @brief time bench and record the result
+ */
+void kernel_bench_run(const KernelBench *bench);
+
+/**
+ * @brief add the windows, extrema and features of rec to input
+ * @return ALGO_ERR_GENERIC when the step counter fails on rec
+ */
+AlgoError kernel_bench_step_gather(KernelBenchInput *input,
+                                   const ImuRecording *rec);
+
+/**
+ * @brief time the filters, the peak detection and pruning, the window
+ * statistics, the deployed network and the whole pipeline
+ */
+void kernel_bench_step(const KernelBenchInput *input);
+
+/**
+ * @brief time the layers of the 5 class network of MyNN/ on feature_float
+ */
+void kernel_bench_networks(const KernelBenchInput *input);
+
+/**
+ * @brief time triple_sums() with each kernel the CPU supports, the kernel
+ * window_stats_select() picks by default is in use again afterwards
+ */
+void kernel_bench_window_stats(const KernelBenchInput *input);
+
+/**
+ * @brief run each kernel the CPU supports on the windows of input, on every
+ * short length and on 65535 sample windows of extreme values, and compare
+ * all fields of TripleSums with a plain int64 computation
+ * @return ALGO_ERR_GENERIC on the first mismatch, which is printed
+ */
+AlgoError kernel_bench_window_stats_check(const KernelBenchInput *input);
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file kernel_bench_networks.c
+ * @brief 5 class network kernels of kernel_bench. MyNN/alg_mlp_networks.c
+ * is compiled in to reach its static layers; its public names are renamed
+ * so that they do not clash with the 11 class network the step counter
+ * links.
+ */
+
+#define networks_init             mlp5_networks_init
+#define networks_export_float     mlp5_networks_export_float
+#define foward_process            mlp5_foward_process
+#define foward_process_batch      mlp5_foward_process_batch
+#define foward_process_q          mlp5_foward_process_q
+#define dump_layer                mlp5_dump_layer
+#define output_csv                mlp5_output_csv
+#define action_list               mlp5_action_list
+#define batch_normal_bias         mlp5_batch_normal_bias
+#define batch_normal_running_mean mlp5_batch_normal_running_mean
+#define batch_normal_running_var  mlp5_batch_normal_running_var
+#define batch_normal_weight       mlp5_batch_normal_weight
+#define linner_layer1_bias        mlp5_linner_layer1_bias
+#define linner_layer1_weight      mlp5_linner_layer1_weight
+#define linner_layer2_bias        mlp5_linner_layer2_bias
+#define linner_layer2_weight      mlp5_linner_layer2_weight
+
+#include "MyNN/alg_mlp_networks.c"
+#include "kernel_bench.h"
+
+/* state of the passes, the layer inputs of every window are computed once
+ * so that each layer is timed on what it sees in foward_process() */
+typedef struct NetworksBench {
+    const KernelBenchInput *input;
+    float *normal; /* feature_num x NETWORKS_INPUT_SIZE, batch normalized */
+    float *hidden; /* feature_num x NETWORKS_LINNER1_SIZE, after relu */
+    int *classes;
+    float x[NETWORKS_INPUT_SIZE];
+    float h[NETWORKS_LINNER1_SIZE];
+    float y[NETWORKS_LINNER2_SIZE];
+    volatile int class;
+} NetworksBench;
+
+static NetworksBench networks_bench;
+
+// the features of window i into x, batch_normal1d() works in place
+static void load_feature(NetworksBench *bench, uint32_t i, LayerData *x)
+{
+    memcpy(bench->x,
+           bench->input->feature_float + (size_t)i * NETWORKS_INPUT_SIZE,
+           sizeof(bench->x));
+    x->size = NETWORKS_INPUT_SIZE;
+    x->data = bench->x;
+}
+
+static void pass_batch_normal1d(void *arg)
+{
+    NetworksBench *bench = arg;
+    LayerData x;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->feature_num; i++) {
+        load_feature(bench, i, &x);
+        batch_normal1d(&x);
+    }
+}
+
+static void pass_linear_calculation1(void *arg)
+{
+    NetworksBench *bench = arg;
+    LayerData x, h = { NETWORKS_LINNER1_SIZE, bench->h };
+    uint32_t i = 0;
+
+    x.size = NETWORKS_INPUT_SIZE;
+    for (i = 0; i < bench->input->feature_num; i++) {
+        x.data = bench->normal + (size_t)i * NETWORKS_INPUT_SIZE;
+        linear_calculation(&bp_networks.linner_layer1, &x, &h);
+    }
+}
+
+static void pass_linear_calculation2(void *arg)
+{
+    NetworksBench *bench = arg;
+    LayerData h, y = { NETWORKS_LINNER2_SIZE, bench->y };
+    uint32_t i = 0;
+
+    h.size = NETWORKS_LINNER1_SIZE;
+    for (i = 0; i < bench->input->feature_num; i++) {
+        h.data = bench->hidden + (size_t)i * NETWORKS_LINNER1_SIZE;
+        linear_calculation(&bp_networks.linner_layer2, &h, &y);
+    }
+}
+
+static void pass_foward_process(void *arg)
+{
+    NetworksBench *bench = arg;
+    LayerData x;
+    uint32_t i = 0;
+    int class  = 0;
+
+    for (i = 0; i < bench->input->feature_num; i++) {
+        load_feature(bench, i, &x);
+        foward_process(&x, &class);
+    }
+    bench->class = class;
+}
+
+static void pass_foward_process_batch(void *arg)
+{
+    NetworksBench *bench = arg;
+
+    foward_process_batch(bench->input->feature_float,
+                         bench->input->feature_num, bench->classes);
+}
+
+void kernel_bench_networks(const KernelBenchInput *input)
+{
+    NetworksBench *bench = &networks_bench;
+    uint32_t num = input->feature_num;
+    uint32_t win = KERNEL_BENCH_AXES * WIN_LEN; /* axis samples per call */
+    KernelBench list[] = {
+        { "mlp5_batch_normal1d", num, win, 1, pass_batch_normal1d, bench },
+        { "mlp5_linear_calculation1", num, win, 1, pass_linear_calculation1,
+          bench },
+        { "mlp5_linear_calculation2", num, win, 1, pass_linear_calculation2,
+          bench },
+        { "mlp5_foward_process", num, win, 1, pass_foward_process, bench },
+        // one call for all windows, timed per window
+        { "mlp5_foward_process_batch", num, win, 1, pass_foward_process_batch,
+          bench },
+    };
+    LayerData x, h = { NETWORKS_LINNER1_SIZE, NULL };
+    uint32_t i = 0;
+
+    if (num == 0 || networks_init() != NET_NORMAL) {
+        return;
+    }
+    bench->input   = input;
+    bench->normal  = malloc((size_t)num * NETWORKS_INPUT_SIZE *
+                            sizeof(float));
+    bench->hidden  = malloc((size_t)num * NETWORKS_LINNER1_SIZE *
+                            sizeof(float));
+    bench->classes = malloc((size_t)num * sizeof(int));
+    if (!bench->normal || !bench->hidden || !bench->classes) {
+        printf("Fail to allocate the network inputs\n");
+    } else {
+        for (i = 0; i < num; i++) {
+            load_feature(bench, i, &x);
+            batch_normal1d(&x);
+            memcpy(bench->normal + (size_t)i * NETWORKS_INPUT_SIZE, x.data,
+                   sizeof(bench->x));
+            h.data = bench->hidden + (size_t)i * NETWORKS_LINNER1_SIZE;
+            linear_calculation(&bp_networks.linner_layer1, &x, &h);
+            relu(&h);
+        }
+        for (i = 0; i < sizeof(list) / sizeof(list[0]); i++) {
+            kernel_bench_run(&list[i]);
+        }
+    }
+    free(bench->normal);
+    free(bench->hidden);
+    free(bench->classes);
+}
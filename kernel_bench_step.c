@@ -0,0 +1,547 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file kernel_bench_step.c
+ * @brief step counter kernels of kernel_bench. alg_step_counter.c is
+ * compiled in to reach its static kernels, so this file is built instead
+ * of it and, like it, never touches the heap.
+ */
+
+#include "alg_step_counter.c"
+#include "kernel_bench.h"
+
+/* state of the passes, the inputs are only read */
+typedef struct StepBench {
+    const KernelBenchInput *input;
+    StepCounterCtx ctx;
+    StepCounterCtx pipeline;
+    MeanFilterGroup group;
+    int16_t group_buf1[MEAN_LEN1];
+    int16_t group_buf2[MEAN_LEN2];
+    PeakValleyStream stream;
+    KernelBenchPeaks work;
+    PeakValley peak_valley;
+    float means[3];
+    float cov[3 * 3];
+    TripleSums sums;
+    TripleStats acc_stats;
+    TripleStats gyro_stats;
+    volatile float sink;
+    volatile int class;
+} StepBench;
+
+static StepBench step_bench;
+
+static const int16_t *window_axis(const KernelBenchInput *input, uint32_t w,
+                                  uint16_t axis)
+{
+    return input->window + ((size_t)w * KERNEL_BENCH_AXES + axis) * WIN_LEN;
+}
+
+static void peaks_view(KernelBenchPeaks *peaks, PeakValley *peak_valley)
+{
+    peak_valley->p_cnt = peaks->p_cnt;
+    peak_valley->v_cnt = peaks->v_cnt;
+    peak_valley->p_loc = peaks->p_loc;
+    peak_valley->v_loc = peaks->v_loc;
+    peak_valley->p_val = peaks->p_val;
+    peak_valley->v_val = peaks->v_val;
+}
+
+// copy the p_cnt and v_cnt extrema that a pass looks at
+static void peaks_copy(KernelBenchPeaks *dst, const KernelBenchPeaks *src)
+{
+    dst->len   = src->len;
+    dst->mean  = src->mean;
+    dst->p_cnt = src->p_cnt;
+    dst->v_cnt = src->v_cnt;
+    memcpy(dst->p_loc, src->p_loc, src->p_cnt * sizeof(uint16_t));
+    memcpy(dst->p_val, src->p_val, src->p_cnt * sizeof(int16_t));
+    memcpy(dst->v_loc, src->v_loc, src->v_cnt * sizeof(uint16_t));
+    memcpy(dst->v_val, src->v_val, src->v_cnt * sizeof(int16_t));
+}
+
+// empty the window the way step_counter_ctx_process() does with hop WIN_LEN
+static void window_clear(AccData *win)
+{
+    win->x_cnt      = 0;
+    win->y_cnt      = 0;
+    win->z_cnt      = 0;
+    win->x_gyro_cnt = 0;
+    win->y_gyro_cnt = 0;
+    win->z_gyro_cnt = 0;
+}
+
+// the extrema of one window axis at each pruning stage, as long as the
+// window is active
+static void gather_peaks(KernelBenchInput *input, const int16_t *data)
+{
+    PeakValleyStream *stream = &step_bench.stream;
+    KernelBenchPeaks *peaks[KERNEL_BENCH_PEAK_STAGES];
+    PeakValley peak_valley;
+    int16_t max = data[0], min = data[0];
+    uint16_t i = 0;
+
+    for (i = 0; i < KERNEL_BENCH_PEAK_STAGES; i++) {
+        peaks[i] = input->peaks[i] + input->peak_num;
+    }
+    memset(stream, 0, sizeof(PeakValleyStream));
+    for (i = 0; i < WIN_LEN; i++) {
+        peak_valley_stream_push(stream, data[i]);
+        max = data[i] > max ? data[i] : max;
+        min = data[i] < min ? data[i] : min;
+    }
+    if (max - min <= STEP_ACC_DIFF_THRESHOLD) {
+        return;
+    }
+
+    peaks[0]->len   = stream->cnt;
+    peaks[0]->mean  = (int16_t)(stream->sum / stream->cnt);
+    peaks[0]->p_cnt = stream->p_cnt;
+    peaks[0]->v_cnt = stream->v_cnt;
+    memcpy(peaks[0]->p_loc, stream->p_loc, sizeof(stream->p_loc));
+    memcpy(peaks[0]->p_val, stream->p_val, sizeof(stream->p_val));
+    memcpy(peaks[0]->v_loc, stream->v_loc, sizeof(stream->v_loc));
+    memcpy(peaks[0]->v_val, stream->v_val, sizeof(stream->v_val));
+
+    peaks_copy(peaks[1], peaks[0]);
+    peaks_view(peaks[1], &peak_valley);
+    remove_false_peak_valley(peaks[1]->mean, &peak_valley);
+    peaks[1]->p_cnt = peak_valley.p_cnt;
+    peaks[1]->v_cnt = peak_valley.v_cnt;
+
+    peaks_copy(peaks[2], peaks[1]);
+    peaks_view(peaks[2], &peak_valley);
+    merge_close_peak_valley(&peak_valley);
+    peaks[2]->p_cnt = peak_valley.p_cnt;
+    peaks[2]->v_cnt = peak_valley.v_cnt;
+
+    input->peak_num++;
+}
+
+static void gather_window(KernelBenchInput *input, AccData *win)
+{
+    int16_t *axis[KERNEL_BENCH_AXES] = { win->gyro_x, win->gyro_y,
+                                         win->gyro_z, win->x,
+                                         win->y,      win->z };
+    uint32_t w = input->window_num++;
+    int16_t *dst = NULL;
+    float *rows  = NULL;
+    uint16_t i = 0, j = 0;
+
+    for (i = 0; i < KERNEL_BENCH_AXES; i++) {
+        dst = input->window + ((size_t)w * KERNEL_BENCH_AXES + i) * WIN_LEN;
+        memcpy(dst, axis[i], WIN_LEN * sizeof(int16_t));
+        gather_peaks(input, dst);
+    }
+    for (i = 0; i < 2; i++) {
+        // accel is axes 3..5, gyro 0..2
+        rows = input->rows + ((size_t)w * 2 + i) * WIN_LEN * 3;
+        for (j = 0; j < WIN_LEN; j++) {
+            rows[j * 3]     = axis[3 - 3 * i][j];
+            rows[j * 3 + 1] = axis[4 - 3 * i][j];
+            rows[j * 3 + 2] = axis[5 - 3 * i][j];
+        }
+    }
+    window_sums(win, 0, WIN_LEN, input->sums + (size_t)w * 2);
+}
+
+static float feature_float(uint16_t i, FeatureValue v)
+{
+#if ALG_FIXED_POINT
+    // the peak intervals are Q(NETWORKS_LAMBDA_FRAC), the rest integers
+    if ((i >= 7 && i <= 9) || i >= 17) {
+        return (float)v / (1 << NETWORKS_LAMBDA_FRAC);
+    }
+#else
+    (void)i;
+#endif
+    return (float)v;
+}
+
+AlgoError kernel_bench_step_gather(KernelBenchInput *input,
+                                   const ImuRecording *rec)
+{
+    StepCounterCtx *ctx      = &step_bench.ctx;
+    AccData *win             = &ctx->acc_data_hub.win;
+    StepCounterOutput output = { 0, -1, { 0 } };
+    AccInput chunk;
+    uint32_t n = 0, chunk_num = kernel_bench_chunk_num(rec);
+    uint16_t appended = 0, i = 0;
+    FeatureValue *feature = NULL;
+
+    // the windows as the pipeline sees them without overlap
+    step_counter_ctx_init(ctx);
+    for (n = 0; n < chunk_num; n++) {
+        kernel_bench_chunk(rec, n, &chunk);
+        if (acc_data_preprocess(&chunk, &ctx->mean_filter_hub,
+                                &ctx->acc_data_hub,
+                                &appended) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+        if (win->x_cnt >= WIN_LEN && input->window_num < input->window_cap) {
+            gather_window(input, win);
+        }
+        if (win->x_cnt >= WIN_LEN || win->x_cnt % ACC_FS != 0) {
+            window_clear(win);
+        }
+    }
+
+    // and the classifier inputs of the pipeline itself
+    step_counter_ctx_init(ctx);
+    for (n = 0; n < chunk_num; n++) {
+        kernel_bench_chunk(rec, n, &chunk);
+        if (step_counter_ctx_process(ctx, &chunk, &output) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+        if (output.class < 0 || input->feature_num >= input->window_cap) {
+            continue;
+        }
+        feature = input->feature + (size_t)input->feature_num *
+                                       STEP_FEATURE_NUM;
+        memcpy(feature, output.feature, sizeof(output.feature));
+        for (i = 0; i < STEP_FEATURE_NUM; i++) {
+            input->feature_float[(size_t)input->feature_num *
+                                     STEP_FEATURE_NUM + i] =
+                feature_float(i, feature[i]);
+        }
+        input->feature_num++;
+    }
+    return ALGO_NORMAL;
+}
+
+static void pass_mean_filtering(void *arg)
+{
+    StepBench *bench = arg;
+    const int16_t *sample = bench->input->sample;
+    MeanOutput output;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->sample_num; i++) {
+        mean_filtering(sample[i], &bench->group.f1, &output);
+    }
+}
+
+static void pass_group_mean_filtering(void *arg)
+{
+    StepBench *bench = arg;
+    const int16_t *sample = bench->input->sample;
+    MeanOutput output;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->sample_num; i++) {
+        group_mean_filtering(sample[i], &bench->group, &output);
+    }
+}
+
+static void pass_acc_data_preprocess(void *arg)
+{
+    StepBench *bench = arg;
+    AccData *win     = &bench->ctx.acc_data_hub.win;
+    uint16_t appended = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->chunk_num; i++) {
+        acc_data_preprocess(&bench->input->chunk[i],
+                            &bench->ctx.mean_filter_hub,
+                            &bench->ctx.acc_data_hub, &appended);
+        if (win->x_cnt >= WIN_LEN || win->x_cnt % ACC_FS != 0) {
+            window_clear(win);
+        }
+    }
+}
+
+static void pass_peak_valley_stream_push(void *arg)
+{
+    StepBench *bench = arg;
+    const int16_t *data = NULL;
+    uint32_t w = 0;
+    uint16_t i = 0, j = 0;
+
+    for (w = 0; w < bench->input->window_num; w++) {
+        for (i = 0; i < KERNEL_BENCH_AXES; i++) {
+            data = window_axis(bench->input, w, i);
+            for (j = 0; j < WIN_LEN; j++) {
+                peak_valley_stream_push(&bench->stream, data[j]);
+            }
+            peak_valley_stream_reset(&bench->stream);
+        }
+    }
+}
+
+static void pass_remove_false_peak_valley(void *arg)
+{
+    StepBench *bench = arg;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->peak_num; i++) {
+        peaks_copy(&bench->work, &bench->input->peaks[0][i]);
+        peaks_view(&bench->work, &bench->peak_valley);
+        remove_false_peak_valley(bench->work.mean, &bench->peak_valley);
+    }
+}
+
+static void pass_merge_close_peak_valley(void *arg)
+{
+    StepBench *bench = arg;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->peak_num; i++) {
+        peaks_copy(&bench->work, &bench->input->peaks[1][i]);
+        peaks_view(&bench->work, &bench->peak_valley);
+        merge_close_peak_valley(&bench->peak_valley);
+    }
+}
+
+static void pass_remove_asymmetric_peaks(void *arg)
+{
+    StepBench *bench = arg;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->peak_num; i++) {
+        peaks_copy(&bench->work, &bench->input->peaks[2][i]);
+        peaks_view(&bench->work, &bench->peak_valley);
+        remove_asymmetric_peaks(bench->work.len, &bench->peak_valley);
+    }
+}
+
+/*
+ * Legacy reference kernels: the float window statistics that
+ * window_statistics() replaced in the step counter, kept here to time
+ * against it.
+ */
+static float calculateVariance(int16_t *arr, int size)
+{
+    float sum      = 1;
+    float mean     = 0;
+    float variance = 0;
+
+    for (int i = 0; i < size; i++) {
+        sum += arr[i];
+    }
+    mean = sum / size;
+
+    for (int i = 0; i < size; i++) {
+        variance += (arr[i] - mean) * (arr[i] - mean);
+    }
+    variance /= size;
+
+    return variance;
+}
+
+static int16_t right_shift_square(int16_t n, int shift)
+{
+    return (n / shift) * (n / shift);
+}
+
+static float calculateMeanFeature(AccData *arr, int size, int type)
+{
+    float sum = 0;
+    int16_t *x, *y, *z;
+    x = arr->x;
+    y = arr->y;
+    z = arr->z;
+    if (!type) {
+        x = arr->gyro_x;
+        y = arr->gyro_y;
+        z = arr->gyro_z;
+    }
+    for (int i = 0; i < size; i++) {
+        sum += right_shift_square(x[i], 2);
+        sum += right_shift_square(y[i], 2);
+        sum += right_shift_square(z[i], 2);
+    }
+    return sum / size;
+}
+
+// calculate cov matrix, arr is rows x cols and covMatrix is cols x cols,
+// both row-major, means is caller provided scratch of cols floats
+static void calculateCovarianceMatrix(const float *arr, int rows, int cols,
+                                      float *means, float *covMatrix)
+{
+    for (int j = 0; j < cols; j++) {
+        float sum = 0;
+        for (int i = 0; i < rows; i++) {
+            sum += arr[i * cols + j];
+        }
+        means[j] = sum / rows;
+    }
+
+    for (int i = 0; i < cols; i++) {
+        for (int j = 0; j < cols; j++) {
+            float sum = 0;
+            for (int k = 0; k < rows; k++) {
+                sum += (arr[k * cols + i] - means[i]) *
+                       (arr[k * cols + j] - means[j]);
+            }
+            covMatrix[i * cols + j] = sum / (rows - 1);
+        }
+    }
+}
+
+static void pass_calculate_variance(void *arg)
+{
+    StepBench *bench = arg;
+    float sum = 0;
+    uint32_t w = 0;
+    uint16_t i = 0;
+
+    for (w = 0; w < bench->input->window_num; w++) {
+        for (i = 0; i < KERNEL_BENCH_AXES; i++) {
+            sum += calculateVariance(
+                (int16_t *)window_axis(bench->input, w, i), WIN_LEN);
+        }
+    }
+    bench->sink = sum;
+}
+
+static void pass_calculate_mean_feature(void *arg)
+{
+    StepBench *bench = arg;
+    AccData win;
+    float sum  = 0;
+    uint32_t w = 0;
+
+    memset(&win, 0, sizeof(win));
+    for (w = 0; w < bench->input->window_num; w++) {
+        win.gyro_x = (int16_t *)window_axis(bench->input, w, 0);
+        win.gyro_y = (int16_t *)window_axis(bench->input, w, 1);
+        win.gyro_z = (int16_t *)window_axis(bench->input, w, 2);
+        win.x      = (int16_t *)window_axis(bench->input, w, 3);
+        win.y      = (int16_t *)window_axis(bench->input, w, 4);
+        win.z      = (int16_t *)window_axis(bench->input, w, 5);
+        sum += calculateMeanFeature(&win, WIN_LEN, 0);
+        sum += calculateMeanFeature(&win, WIN_LEN, 1);
+    }
+    bench->sink = sum;
+}
+
+static void pass_calculate_covariance_matrix(void *arg)
+{
+    StepBench *bench = arg;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->window_num * 2; i++) {
+        calculateCovarianceMatrix(bench->input->rows +
+                                      (size_t)i * WIN_LEN * 3,
+                                  WIN_LEN, 3, bench->means, bench->cov);
+    }
+}
+
+static void pass_triple_sums(void *arg)
+{
+    StepBench *bench = arg;
+    uint32_t w = 0;
+    uint16_t i = 0;
+
+    for (w = 0; w < bench->input->window_num; w++) {
+        for (i = 0; i < KERNEL_BENCH_AXES; i += 3) {
+            triple_sums(window_axis(bench->input, w, i),
+                        window_axis(bench->input, w, i + 1),
+                        window_axis(bench->input, w, i + 2), WIN_LEN,
+                        &bench->sums);
+        }
+    }
+}
+
+static void pass_window_statistics(void *arg)
+{
+    StepBench *bench = arg;
+    uint32_t w = 0;
+
+    for (w = 0; w < bench->input->window_num; w++) {
+        window_statistics(bench->input->sums + (size_t)w * 2, WIN_LEN,
+                          &bench->acc_stats, &bench->gyro_stats);
+    }
+}
+
+static void pass_foward_process(void *arg)
+{
+    StepBench *bench = arg;
+    FeatureValue *feature = NULL;
+    uint32_t i = 0;
+    int class  = 0;
+
+    for (i = 0; i < bench->input->feature_num; i++) {
+        feature = bench->input->feature + (size_t)i * STEP_FEATURE_NUM;
+#if ALG_FIXED_POINT
+        LayerDataQ layer = { STEP_FEATURE_NUM, 0, feature };
+        foward_process_q(&layer, &class);
+#else
+        LayerData layer = { STEP_FEATURE_NUM, feature };
+        foward_process(&layer, &class);
+#endif
+    }
+    bench->class = class;
+}
+
+static void pass_step_counter_ctx_process(void *arg)
+{
+    StepBench *bench = arg;
+    StepCounterOutput output;
+    uint32_t i = 0;
+
+    for (i = 0; i < bench->input->chunk_num; i++) {
+        step_counter_ctx_process(&bench->pipeline, &bench->input->chunk[i],
+                                 &output);
+    }
+}
+
+void kernel_bench_step(const KernelBenchInput *input)
+{
+    StepBench *bench = &step_bench;
+    uint32_t win_num = input->window_num;
+    uint32_t win     = KERNEL_BENCH_AXES * WIN_LEN; /* axis samples */
+    uint32_t chunk   = KERNEL_BENCH_AXES * ACC_FS;
+    KernelBench list[] = {
+        { "mean_filtering", input->sample_num, 1, 2 * win,
+          pass_mean_filtering, bench },
+        { "group_mean_filtering", input->sample_num, 1, win,
+          pass_group_mean_filtering, bench },
+        { "acc_data_preprocess", input->chunk_num, chunk, WIN_LEN / ACC_FS,
+          pass_acc_data_preprocess, bench },
+        { "peak_valley_stream_push", win_num * win, 1, win,
+          pass_peak_valley_stream_push, bench },
+        { "remove_false_peak_valley", input->peak_num, WIN_LEN,
+          KERNEL_BENCH_AXES, pass_remove_false_peak_valley, bench },
+        { "merge_close_peak_valley", input->peak_num, WIN_LEN,
+          KERNEL_BENCH_AXES, pass_merge_close_peak_valley, bench },
+        { "remove_asymmetric_peaks", input->peak_num, WIN_LEN,
+          KERNEL_BENCH_AXES, pass_remove_asymmetric_peaks, bench },
+        { "calculateVariance", win_num * KERNEL_BENCH_AXES, WIN_LEN,
+          KERNEL_BENCH_AXES, pass_calculate_variance, bench },
+        { "calculateMeanFeature", win_num * 2, 3 * WIN_LEN, 2,
+          pass_calculate_mean_feature, bench },
+        { "calculateCovarianceMatrix", win_num * 2, 3 * WIN_LEN, 2,
+          pass_calculate_covariance_matrix, bench },
+        { "triple_sums", win_num * 2, 3 * WIN_LEN, 2, pass_triple_sums,
+          bench },
+        { "window_statistics", win_num, win, 1, pass_window_statistics,
+          bench },
+#if ALG_FIXED_POINT
+        { "foward_process_q", input->feature_num, win, 1,
+          pass_foward_process, bench },
+#else
+        { "foward_process", input->feature_num, win, 1, pass_foward_process,
+          bench },
+#endif
+        { "step_counter_ctx_process", input->chunk_num, chunk,
+          WIN_LEN / ACC_FS, pass_step_counter_ctx_process, bench },
+    };
+    uint16_t i = 0;
+
+    bench->input        = input;
+    bench->group.f1.buf = bench->group_buf1;
+    bench->group.f1.len = MEAN_LEN1;
+    bench->group.f2.buf = bench->group_buf2;
+    bench->group.f2.len = MEAN_LEN2;
+    memset(&bench->stream, 0, sizeof(PeakValleyStream));
+    step_counter_ctx_init(&bench->ctx);
+    step_counter_ctx_init(&bench->pipeline);
+
+    for (i = 0; i < sizeof(list) / sizeof(list[0]); i++) {
+        if (list[i].calls > 0) {
+            kernel_bench_run(&list[i]);
+        }
+    }
+}
@@ -0,0 +1,264 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file kernel_bench_window_stats.c
+ * @brief the triple_sums() kernels of kernel_bench, each one the CPU
+ * supports timed on its own through window_stats_select() and checked
+ * against a plain int64 reference
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "alg_window_stats.h"
+#include "kernel_bench.h"
+
+#define STATS_LEN_MAX  (65535) /* longest window triple_sums() takes */
+#define STATS_TAIL_MAX (64)    /* short lengths checked, every tail size */
+
+typedef struct StatsKernel {
+    WindowStatsImpl impl;
+    const char *name;
+    const char *bench_name;
+} StatsKernel;
+
+static const StatsKernel stats_kernels[] = {
+    { WINDOW_STATS_SCALAR, "scalar", "triple_sums_scalar" },
+    { WINDOW_STATS_SSE2, "sse2", "triple_sums_sse2" },
+    { WINDOW_STATS_AVX2, "avx2", "triple_sums_avx2" },
+};
+
+#define STATS_KERNEL_NUM (sizeof(stats_kernels) / sizeof(stats_kernels[0]))
+
+/* state of the passes and of the check, the inputs are only read */
+typedef struct StatsBench {
+    const KernelBenchInput *input;
+    TripleSums sums;
+    int16_t axis[3][STATS_LEN_MAX];
+} StatsBench;
+
+static StatsBench stats_bench;
+
+static const int16_t *window_axis(const KernelBenchInput *input, uint32_t w,
+                                  uint16_t axis)
+{
+    return input->window + ((size_t)w * KERNEL_BENCH_AXES + axis) * WIN_LEN;
+}
+
+static void pass_triple_sums(void *arg)
+{
+    StatsBench *bench = arg;
+    uint32_t w = 0;
+    uint16_t i = 0;
+
+    for (w = 0; w < bench->input->window_num; w++) {
+        for (i = 0; i < KERNEL_BENCH_AXES; i += 3) {
+            triple_sums(window_axis(bench->input, w, i),
+                        window_axis(bench->input, w, i + 1),
+                        window_axis(bench->input, w, i + 2), WIN_LEN,
+                        &bench->sums);
+        }
+    }
+}
+
+// the definition of every field, in int64 and one sample at a time
+static void reference_sums(const int16_t *x, const int16_t *y,
+                           const int16_t *z, uint16_t len, TripleSums *out)
+{
+    const int16_t *axis[3] = { x, y, z };
+    int64_t sum[3] = { 0 }, sq[3] = { 0 }, cross[3] = { 0 }, energy = 0;
+    int64_t v[3];
+    uint16_t i = 0, k = 0;
+
+    memset(out, 0, sizeof(TripleSums));
+    for (k = 0; k < 3; k++) {
+        out->max[k] = axis[k][0];
+        out->min[k] = axis[k][0];
+    }
+    for (i = 0; i < len; i++) {
+        for (k = 0; k < 3; k++) {
+            v[k] = axis[k][i];
+            sum[k] += v[k];
+            sq[k] += v[k] * v[k];
+            energy += (int16_t)((v[k] / 2) * (v[k] / 2));
+            out->max[k] = v[k] > out->max[k] ? (int16_t)v[k] : out->max[k];
+            out->min[k] = v[k] < out->min[k] ? (int16_t)v[k] : out->min[k];
+        }
+        cross[0] += v[0] * v[1];
+        cross[1] += v[0] * v[2];
+        cross[2] += v[1] * v[2];
+    }
+    for (k = 0; k < 3; k++) {
+        out->sum[k]   = (int32_t)sum[k];
+        out->sq[k]    = sq[k];
+        out->cross[k] = cross[k];
+    }
+    out->energy = energy;
+}
+
+// field by field, the padding of TripleSums is not set by the kernels
+static int sums_equal(const TripleSums *a, const TripleSums *b)
+{
+    uint16_t k = 0;
+
+    for (k = 0; k < 3; k++) {
+        if (a->sum[k] != b->sum[k] || a->sq[k] != b->sq[k] ||
+            a->cross[k] != b->cross[k] || a->max[k] != b->max[k] ||
+            a->min[k] != b->min[k]) {
+            return 0;
+        }
+    }
+    return a->energy == b->energy;
+}
+
+/**
+ * @brief the kernel in use against reference_sums() on one window
+ * @return 1 when they agree
+ */
+static int check_window(const char *kernel, const char *what,
+                        const int16_t *x, const int16_t *y, const int16_t *z,
+                        uint16_t len)
+{
+    TripleSums expect, got;
+    uint16_t k = 0;
+
+    reference_sums(x, y, z, len, &expect);
+    triple_sums(x, y, z, len, &got);
+    if (sums_equal(&expect, &got)) {
+        return 1;
+    }
+    printf("MISMATCH %s on %s of %u samples, got / expected\n", kernel,
+           what, len);
+    for (k = 0; k < 3; k++) {
+        printf("  axis %u: sum %d / %d, sq %lld / %lld, cross %lld / %lld, "
+               "max %d / %d, min %d / %d\n",
+               k, got.sum[k], expect.sum[k], (long long)got.sq[k],
+               (long long)expect.sq[k], (long long)got.cross[k],
+               (long long)expect.cross[k], got.max[k], expect.max[k],
+               got.min[k], expect.min[k]);
+    }
+    printf("  energy %lld / %lld\n", (long long)got.energy,
+           (long long)expect.energy);
+    return 0;
+}
+
+// fill the check buffer with pattern p, 0 to STATS_PATTERN_NUM - 1
+#define STATS_PATTERN_NUM (6)
+static const char *fill_pattern(StatsBench *bench, uint16_t p)
+{
+    static const char *name[STATS_PATTERN_NUM] = {
+        "all INT16_MAX",        "all INT16_MIN",
+        "alternating extremes", "x max, y min, z max",
+        "one INT16_MIN spike",  "random full range",
+    };
+    uint32_t seed = 0x2545f491u;
+    uint32_t i    = 0;
+    uint16_t k    = 0;
+
+    for (i = 0; i < STATS_LEN_MAX; i++) {
+        for (k = 0; k < 3; k++) {
+            switch (p) {
+            case 0:
+                bench->axis[k][i] = INT16_MAX;
+                break;
+            case 1:
+                bench->axis[k][i] = INT16_MIN;
+                break;
+            case 2:
+                bench->axis[k][i] = (i + k) % 2 ? INT16_MAX : INT16_MIN;
+                break;
+            case 3:
+                bench->axis[k][i] = k == 1 ? INT16_MIN : INT16_MAX;
+                break;
+            case 4:
+                bench->axis[k][i] = i == STATS_LEN_MAX - 1 - k ? INT16_MIN
+                                                               : 1;
+                break;
+            default:
+                seed              = seed * 1664525u + 1013904223u;
+                bench->axis[k][i] = (int16_t)(seed >> 16);
+                break;
+            }
+        }
+    }
+    return name[p];
+}
+
+AlgoError kernel_bench_window_stats_check(const KernelBenchInput *input)
+{
+    StatsBench *bench = &stats_bench;
+    const char *what = NULL;
+    uint32_t kernel = 0, w = 0, checked = 0, failed = 0;
+    uint16_t i = 0, p = 0, len = 0;
+    char name[64];
+
+    for (kernel = 0; kernel < STATS_KERNEL_NUM; kernel++) {
+        if (window_stats_select(stats_kernels[kernel].impl) != 0) {
+            printf("window_stats %s: not supported, skipped\n",
+                   stats_kernels[kernel].name);
+            continue;
+        }
+        checked = 0;
+        failed  = 0;
+        // the windows of the pipeline, and a prefix of each of every
+        // length to reach the tails of the vector loops
+        for (w = 0; w < input->window_num && failed == 0; w++) {
+            for (i = 0; i < KERNEL_BENCH_AXES && failed == 0; i += 3) {
+                len = (uint16_t)(w % WIN_LEN + 1);
+                snprintf(name, sizeof(name), "window %u", w);
+                failed += !check_window(stats_kernels[kernel].name, name,
+                                        window_axis(input, w, i),
+                                        window_axis(input, w, i + 1),
+                                        window_axis(input, w, i + 2),
+                                        WIN_LEN);
+                failed += !check_window(stats_kernels[kernel].name, name,
+                                        window_axis(input, w, i),
+                                        window_axis(input, w, i + 1),
+                                        window_axis(input, w, i + 2), len);
+                checked += 2;
+            }
+        }
+        // windows as long as a uint16_t length allows and every short one,
+        // on the values that come closest to overflowing a sum
+        for (p = 0; p < STATS_PATTERN_NUM && failed == 0; p++) {
+            what = fill_pattern(bench, p);
+            failed += !check_window(stats_kernels[kernel].name, what,
+                                    bench->axis[0], bench->axis[1],
+                                    bench->axis[2], STATS_LEN_MAX);
+            checked++;
+            for (len = 1; len <= STATS_TAIL_MAX && failed == 0; len++) {
+                failed += !check_window(
+                    stats_kernels[kernel].name, what,
+                    bench->axis[0] + STATS_LEN_MAX - len,
+                    bench->axis[1] + STATS_LEN_MAX - len,
+                    bench->axis[2] + STATS_LEN_MAX - len, len);
+                checked++;
+            }
+        }
+        printf("window_stats %s: %u windows, %s\n",
+               stats_kernels[kernel].name, checked,
+               failed == 0 ? "match" : "MISMATCH");
+        if (failed > 0) {
+            window_stats_select(WINDOW_STATS_AUTO);
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    window_stats_select(WINDOW_STATS_AUTO);
+    return ALGO_NORMAL;
+}
+
+void kernel_bench_window_stats(const KernelBenchInput *input)
+{
+    StatsBench *bench = &stats_bench;
+    KernelBench run   = { NULL, input->window_num * 2, 3 * WIN_LEN, 2,
+                          pass_triple_sums, bench };
+    uint32_t kernel   = 0;
+
+    bench->input = input;
+    for (kernel = 0; kernel < STATS_KERNEL_NUM && run.calls > 0; kernel++) {
+        if (window_stats_select(stats_kernels[kernel].impl) == 0) {
+            run.name = stats_kernels[kernel].bench_name;
+            kernel_bench_run(&run);
+        }
+    }
+    window_stats_select(WINDOW_STATS_AUTO);
+}
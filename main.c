@@ -1,120 +1,140 @@
 #include "alg_step_counter.h"
 #include "MyNN/alg_mlp_network.h"
-#define MAX_ACC_LEN (10000)
-#define MAX_LINE_LENGTH (100)
-#define MAX_INTEGER_LENGTH (8)
-static int16_t acc_x[MAX_ACC_LEN], acc_y[MAX_ACC_LEN], acc_z[MAX_ACC_LEN];
-static int16_t gyro_x[MAX_ACC_LEN], gyro_y[MAX_ACC_LEN], gyro_z[MAX_ACC_LEN];
+#include "alg_trace.h"
+#include "alg_profile.h"
+#include "alg_imu_loader.h"
+#include "alg_imu_archive.h"
+#include <string.h>
 
-static int read_data(const char *file_name, AccInput *saved_data)
+#if ALG_PROFILE
+static void print_profile(void)
 {
-    int16_t new_num;
-    uint16_t cnt;
-    FILE *fd;
-    int ret;
-    char line[MAX_LINE_LENGTH];
-    if (!file_name || !saved_data) {
-        return ALGO_ERR_GENERIC;
-    }
-
-    saved_data->len = 0;
+    AlgProfile profile;
+    const AlgProfileStat *stat = NULL;
+    uint16_t i = 0;
 
-    // open data file
-    if ((fd = fopen(file_name, "r")) == NULL) {
-        printf("Fail to open the file in read_data()\n");
-        return ALGO_ERR_GENERIC;
+    if (step_counter_get_profile(&profile) != ALGO_NORMAL) {
+        return;
     }
-    // read data file
-    cnt = 0;
-    while ((fgets(line, MAX_LINE_LENGTH, fd)) != NULL) {
-        int numbers[MAX_INTEGER_LENGTH];
-        int num_count = 0;
-        char *token   = strtok(line, ",");
-        while (token && num_count < MAX_INTEGER_LENGTH) {
-            int number           = atoi(token);
-            numbers[num_count++] = number;
-            token                = strtok(NULL, ",");
+    printf("%-12s %8s %12s %12s %12s %12s %6s\n", "stage", "count", "min",
+           "avg", "max", "instret", "over");
+    for (i = 0; i < PROFILE_STAGE_NUM; i++) {
+        stat = &profile.stage[i];
+        if (stat->count == 0) {
+            continue;
         }
-        saved_data->gyro_x[cnt] = numbers[0];
-        saved_data->gyro_y[cnt] = numbers[1];
-        saved_data->gyro_z[cnt] = numbers[2];
-        saved_data->x[cnt]      = numbers[3];
-        saved_data->y[cnt]      = numbers[4];
-        saved_data->z[cnt]      = numbers[5];
-        cnt++;
-    }
-
-    saved_data->len = cnt;
-
-    // close data file
-    ret = fclose(fd);
-    if (ret != 0) {
-        printf("Fail to close the file in read_data()\n");
-        return ALGO_ERR_GENERIC;
+        printf("%-12s %8u %12u %12.1f %12u %12.1f %6u\n",
+               alg_profile_name((AlgProfileStage)i), stat->count, stat->min,
+               (double)stat->cycles / stat->count, stat->max,
+               (double)stat->instret / stat->count, stat->over);
     }
-    return ALGO_NORMAL;
 }
+#endif
 
-int main(void)
+// replay rec in one second windows, printing the total every 5 seconds
+static AlgoError replay(const ImuRecording *rec)
 {
-    uint16_t step_num = 0, step_total = 0, i;
+    uint16_t step_num    = 0;
+    uint32_t step_total  = 0, i;
     AlgoError ret        = ALGO_NORMAL;
     uint16_t delay_point = ACC_FS - 5 - 2;
-    const char *fn       = "D:\\Projects\\Versilicon_Embedded_Contest_2023\\C代码待验证\\IMU_Dataset\\jumping_"
-                           "squat\\IMU-2023-06-01-09_48_38_jumping_squat.txt";
-    AccInput acc_xyz     = {
-        0, gyro_x, gyro_y, gyro_z, acc_x, acc_y, acc_z
-    }; // store x,y,z three vector and the length
     AccInput acc_xyz_win = {
-        0, NULL, NULL, NULL, NULL, NULL, NULL
+        0, NULL, NULL, NULL, NULL, NULL, NULL, 0
     }; // store one second data for process (win is window!)
 
-    ret = read_data(fn, &acc_xyz);
-
-    if (ret != ALGO_NORMAL) {
-        return 0;
-    }
     ret = step_counter_init();
-    ret = networks_init();
-    if (ret != ALGO_NORMAL) {
-        return 0;
+    if (ret != ALGO_NORMAL || rec->len < delay_point) {
+        return ret;
     }
-    acc_xyz_win.gyro_x = acc_xyz.gyro_x;
-    acc_xyz_win.gyro_y = acc_xyz.gyro_y;
-    acc_xyz_win.gyro_z = acc_xyz.gyro_z;
-    acc_xyz_win.x      = acc_xyz.x;
-    acc_xyz_win.y      = acc_xyz.y;
-    acc_xyz_win.z      = acc_xyz.z;
-    acc_xyz_win.len    = delay_point;
+    imu_recording_window(rec, 0, delay_point, &acc_xyz_win);
     ret = step_counter_process(&acc_xyz_win, &step_num); // everytime callthis
                                                          // func, will get1s
                                                          // result( data
                                                          // lenth=25 )
 
-    for (i = delay_point; i <= acc_xyz.len - ACC_FS; i += ACC_FS) {
-        acc_xyz_win.x      = acc_xyz.x + i;
-        acc_xyz_win.y      = acc_xyz.y + i;
-        acc_xyz_win.z      = acc_xyz.z + i;
-        acc_xyz_win.gyro_x = acc_xyz.gyro_x + i;
-        acc_xyz_win.gyro_y = acc_xyz.gyro_y + i;
-        acc_xyz_win.gyro_z = acc_xyz.gyro_z + i;
-        acc_xyz_win.len    = ACC_FS;
+    for (i = delay_point; i + ACC_FS <= rec->len; i += ACC_FS) {
+        // read the frames in place, no per axis copy
+        imu_recording_window(rec, i, ACC_FS, &acc_xyz_win);
         ret = step_counter_process(&acc_xyz_win, &step_num); // everytime call
                                                              // this func, will
         // get 1sresult( datalenth = 25)
         if (ret != ALGO_NORMAL) {
             printf("Error in step_counter_process()!\n");
-            return 0;
+            return ret;
         }
         step_total += step_num;
         if ((i - delay_point) % (ACC_FS * 5) == 0) {
-            printf("Time = %3d(s)\tTotal steps = %3d\n", i / ACC_FS,
+            printf("Time = %3u(s)\tTotal steps = %3u\n", i / ACC_FS,
                    step_total);
         }
     }
+    return ALGO_NORMAL;
+}
+
+// every recording of an archive from imu_archive, or the one called name
+static AlgoError replay_archive(const ImuArchive *archive, const char *name)
+{
+    ImuRecording rec;
+    uint32_t i = 0;
+
+    for (i = 0; i < archive->header->record_num; i++) {
+        if (name && strcmp(archive->record[i].name, name) != 0) {
+            continue;
+        }
+        imu_archive_recording(archive, i, &rec);
+        printf("# %s %s\n", imu_archive_label(archive, i),
+               archive->record[i].name);
+        if (replay(&rec) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+    }
+    return ALGO_NORMAL;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t line  = 0;
+    AlgoError ret  = ALGO_NORMAL;
+    const char *fn = "D:\\Projects\\Versilicon_Embedded_Contest_2023\\C代码待验证\\IMU_Dataset\\jumping_"
+                     "squat\\IMU-2023-06-01-09_48_38_jumping_squat.txt";
+    ImuRecording acc_xyz; // one array per axis and the length
+    ImuArchive archive;
+
+    // an IMU_Dataset file may be given instead of the default one, or an
+    // archive from imu_archive and optionally the name of one recording
+    if (argc > 1) {
+        fn = argv[1];
+    }
+    if (networks_init() != ALGO_NORMAL) {
+        return 0;
+    }
+    if (imu_archive_open(&archive, fn) == ALGO_NORMAL) {
+        replay_archive(&archive, argc > 2 ? argv[2] : NULL);
+        imu_archive_close(&archive);
+    } else {
+        imu_recording_init(&acc_xyz, NULL, 0);
+        ret = imu_recording_load(&acc_xyz, fn, &line);
+        if (ret == ALGO_NORMAL) {
+            replay(&acc_xyz);
+        } else if (line > 0) {
+            printf("Bad data at line %u of %s\n", line, fn);
+        } else {
+            printf("Fail to load %s\n", fn);
+        }
+        imu_recording_free(&acc_xyz);
+    }
 
     // foward_process(&ld, &class);
     // printf("%d  ", class);
 
+#if ALG_PROFILE
+    print_profile();
+#endif
+#if ALG_TRACE
+    // decode with: python3 alg_trace_decode.py alg_trace.bin
+    if (alg_trace_save("alg_trace.bin") != 0) {
+        printf("Fail to save alg_trace.bin\n");
+    }
+#endif
     return 0;
 }
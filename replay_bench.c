@@ -0,0 +1,424 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file replay_bench.c
+ * @brief replays every recording of IMU_Dataset through the step counter the
+ * way main.c does, checks the results against a golden file and reports the
+ * throughput and the per window latency:
+ *
+ *   replay_bench [-n runs] [-p hop] [-g golden.txt] [-w] [RECORDING...]
+ *
+ * RECORDING is a directory laid out like IMU_Dataset, an IMU_Dataset file or
+ * an imu_archive archive, IMU_Dataset by default. The golden file holds one
+ * line per recording with its total steps and the class of every window; -w
+ * writes it instead of checking it. The exit status is 1 when any recording
+ * differs from the golden file. -p replays with step_counter_ctx_set_hop(),
+ * whose results differ from the default hop and are checked against
+ * replay_golden_hop<hop>.txt instead.
+ *
+ * Each recording is replayed on a fresh StepCounterCtx, which is what
+ * step_counter_init() and step_counter_process() do on their default
+ * context; the context is used directly because step_counter_process() does
+ * not return the window classes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "alg_step_counter.h"
+#include "alg_imu_dataset.h"
+#include "MyNN/alg_mlp_network.h"
+
+#define REPLAY_HEAD     (ACC_FS - 5 - 2) /* frames of the first chunk */
+#define REPLAY_LINE_MAX (16384)          /* bytes of a golden line */
+#define REPLAY_REPORT   (10)             /* mismatches printed */
+
+#if ALG_FIXED_POINT
+static const char *default_golden     = "replay_golden_q.txt";
+static const char *default_hop_golden = "replay_golden_hop%d_q.txt";
+#else
+static const char *default_golden     = "replay_golden.txt";
+static const char *default_hop_golden = "replay_golden_hop%d.txt";
+#endif
+
+/**
+ * @brief results of one recording
+ * @param steps: sum of step_num over all chunks
+ * @param class: class of every window, window_num of them
+ */
+typedef struct ReplayResult {
+    uint32_t steps;
+    uint32_t window_num;
+    int16_t *class;
+} ReplayResult;
+
+/* latencies of the calls that closed a window, over all runs */
+typedef struct ReplayTiming {
+    uint64_t *latency;
+    uint64_t num;
+    uint64_t cap;
+    uint64_t frames;
+    uint64_t windows;
+    uint64_t busy_ns; /* inside step_counter_ctx_process() */
+} ReplayTiming;
+
+static StepCounterCtx replay_ctx;
+static uint16_t replay_hop = WIN_LEN;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static AlgoError add_latency(ReplayTiming *timing, uint64_t ns)
+{
+    uint64_t *grown = NULL;
+    uint64_t cap    = 0;
+
+    if (timing->num == timing->cap) {
+        cap   = timing->cap > 0 ? 2 * timing->cap : 4096;
+        grown = realloc(timing->latency, cap * sizeof(uint64_t));
+        if (!grown) {
+            return ALGO_ERR_GENERIC;
+        }
+        timing->latency = grown;
+        timing->cap     = cap;
+    }
+    timing->latency[timing->num++] = ns;
+    return ALGO_NORMAL;
+}
+
+// replay rec in main.c's chunks, result->class holds one class per window
+static AlgoError replay(const ImuRecording *rec, ReplayResult *result,
+                        ReplayTiming *timing)
+{
+    StepCounterOutput output;
+    AccInput acc_input = { 0, NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+    uint32_t i = 0, cap = 0;
+    uint16_t len   = REPLAY_HEAD;
+    uint64_t start = 0, ns = 0;
+    int16_t *grown = NULL;
+
+    result->steps      = 0;
+    result->window_num = 0;
+    if (step_counter_ctx_init(&replay_ctx) != ALGO_NORMAL ||
+        step_counter_ctx_set_hop(&replay_ctx, replay_hop) != ALGO_NORMAL) {
+        return ALGO_ERR_GENERIC;
+    }
+    if (rec->len < REPLAY_HEAD) {
+        return ALGO_NORMAL;
+    }
+    cap   = rec->len / replay_hop + 1;
+    grown = realloc(result->class, cap * sizeof(int16_t));
+    if (!grown) {
+        return ALGO_ERR_GENERIC;
+    }
+    result->class = grown;
+
+    for (i = 0; i + len <= rec->len; i += len, len = ACC_FS) {
+        imu_recording_window(rec, i, len, &acc_input);
+        start = now_ns();
+        if (step_counter_ctx_process(&replay_ctx, &acc_input, &output) !=
+            ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+        ns = now_ns() - start;
+        timing->busy_ns += ns;
+        timing->frames += len;
+        result->steps += output.step_num;
+        if (output.class < 0) {
+            continue;
+        }
+        if (result->window_num == cap ||
+            add_latency(timing, ns) != ALGO_NORMAL) {
+            return ALGO_ERR_GENERIC;
+        }
+        result->class[result->window_num++] = output.class;
+        timing->windows++;
+    }
+    return ALGO_NORMAL;
+}
+
+// "label name steps class,class,..." as in the golden file
+static void format_result(const ImuDatasetEntry *entry,
+                          const ReplayResult *result, char *line, size_t size)
+{
+    size_t len = 0;
+    uint32_t i = 0;
+
+    len = (size_t)snprintf(line, size, "%s %s %u ",
+                           entry->label[0] ? entry->label : "-", entry->name,
+                           result->steps);
+    for (i = 0; i < result->window_num && len < size; i++) {
+        len += (size_t)snprintf(line + len, size - len, i > 0 ? ",%d" : "%d",
+                                result->class[i]);
+    }
+    if (result->window_num == 0 && len < size) {
+        snprintf(line + len, size - len, "-");
+    }
+}
+
+/* the golden file, one line per recording without its '\n' */
+typedef struct ReplayGolden {
+    char *text;
+    char **line;
+    uint8_t *used;
+    uint32_t num;
+} ReplayGolden;
+
+static int golden_load(ReplayGolden *golden, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    long size = 0;
+    char *p = NULL, *end = NULL;
+    uint32_t num = 0;
+
+    memset(golden, 0, sizeof(ReplayGolden));
+    if (!fp) {
+        return -1;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+        fseek(fp, 0, SEEK_SET) != 0 ||
+        (golden->text = malloc((size_t)size + 1)) == NULL ||
+        fread(golden->text, 1, (size_t)size, fp) != (size_t)size) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    golden->text[size] = '\0';
+    for (p = golden->text; *p; p++) {
+        num += *p == '\n';
+    }
+    golden->line = calloc(num + 1, sizeof(char *));
+    golden->used = calloc(num + 1, 1);
+    if (!golden->line || !golden->used) {
+        return -1;
+    }
+    for (p = golden->text; *p; p = end + 1) {
+        end = strchr(p, '\n');
+        if (!end) {
+            end = p + strlen(p) - 1;
+        } else {
+            *end = '\0';
+        }
+        if (*p != '#' && *p != '\0') {
+            golden->line[golden->num++] = p;
+        }
+    }
+    return 0;
+}
+
+static void golden_free(ReplayGolden *golden)
+{
+    free(golden->text);
+    free(golden->line);
+    free(golden->used);
+}
+
+// golden line of the recording in line, which starts with "label name "
+static int golden_find(ReplayGolden *golden, const char *line)
+{
+    const char *key = strchr(line, ' ');
+    size_t len      = 0;
+    uint32_t i      = 0;
+
+    key = strchr(key + 1, ' ');
+    len = (size_t)(key - line) + 1;
+    for (i = 0; i < golden->num; i++) {
+        if (!golden->used[i] && strncmp(golden->line[i], line, len) == 0) {
+            golden->used[i] = 1;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void print_timing(ReplayTiming *timing, uint64_t wall_ns)
+{
+    double busy = timing->busy_ns > 0 ? timing->busy_ns * 1e-9 : 1e-9;
+
+    printf("%llu frames (%llu samples), %llu windows in %.3f s, %.3f s in "
+           "step_counter_ctx_process()\n",
+           (unsigned long long)timing->frames,
+           (unsigned long long)timing->frames * 6,
+           (unsigned long long)timing->windows, wall_ns * 1e-9, busy);
+    printf("%.0f samples/s, %.0f windows/s\n", timing->frames * 6 / busy,
+           timing->windows / busy);
+    if (timing->num == 0) {
+        return;
+    }
+    qsort(timing->latency, timing->num, sizeof(uint64_t), compare_u64);
+    printf("window latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           timing->latency[(timing->num - 1) / 2] * 1e-3,
+           timing->latency[(timing->num - 1) * 99 / 100] * 1e-3,
+           timing->latency[timing->num - 1] * 1e-3);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-n runs] [-p hop] [-g golden.txt] [-w] "
+           "[RECORDING...]\n"
+           "  RECORDING  IMU_Dataset directory or recording, or imu_archive "
+           "archive, IMU_Dataset by default\n"
+           "  -n         replay everything n times for the timing, 1 by "
+           "default\n"
+           "  -p         samples between two windows, a multiple of %d up "
+           "to %d, %d by default\n"
+           "  -g         golden file, %s by default, one per hop with "
+           "-p\n"
+           "  -w         write the golden file instead of checking it\n",
+           name, ACC_FS, WIN_LEN, WIN_LEN, default_golden);
+}
+
+int main(int argc, char **argv)
+{
+    ImuDataset set;
+    ImuRecording store, rec;
+    ReplayResult result = { 0, 0, NULL };
+    ReplayTiming timing;
+    ReplayGolden golden;
+    const char *golden_path = NULL;
+    char hop_golden[64];
+    char *line = NULL;
+    FILE *out  = NULL;
+    uint64_t start = 0, wall_ns = 0;
+    uint32_t t = 0, mismatch = 0;
+    int opt = 0, ret = 0, runs = 1, write = 0, run = 0, g = 0;
+    int hop = WIN_LEN;
+
+    while ((opt = getopt(argc, argv, "n:p:g:wh")) != -1) {
+        switch (opt) {
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'p':
+            hop = atoi(optarg);
+            break;
+        case 'g':
+            golden_path = optarg;
+            break;
+        case 'w':
+            write = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || hop < ACC_FS || hop > WIN_LEN || hop % ACC_FS != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    replay_hop = (uint16_t)hop;
+    if (!golden_path && hop != WIN_LEN) {
+        snprintf(hop_golden, sizeof(hop_golden), default_hop_golden, hop);
+        golden_path = hop_golden;
+    } else if (!golden_path) {
+        golden_path = default_golden;
+    }
+
+    imu_dataset_init(&set);
+    imu_recording_init(&store, NULL, 0);
+    memset(&timing, 0, sizeof(timing));
+    memset(&golden, 0, sizeof(golden));
+    if (optind == argc) {
+        ret = imu_dataset_add(&set, "IMU_Dataset");
+        if (ret != ALGO_NORMAL) {
+            printf("Fail to add IMU_Dataset\n");
+        }
+    }
+    for (; optind < argc && ret == 0; optind++) {
+        ret = imu_dataset_add(&set, argv[optind]);
+        if (ret != ALGO_NORMAL) {
+            printf("Fail to add %s\n", argv[optind]);
+        }
+    }
+    if (ret == 0 && (line = malloc(REPLAY_LINE_MAX)) == NULL) {
+        ret = -1;
+    }
+    if (ret == 0 && networks_init() != ALGO_NORMAL) {
+        ret = -1;
+    }
+    if (ret == 0 && write) {
+        out = fopen(golden_path, "w");
+        if (!out) {
+            printf("Fail to create %s\n", golden_path);
+            ret = -1;
+        } else {
+            fprintf(out, "# replay_bench golden, WIN_LEN %d, hop %d, "
+                    "ALG_FIXED_POINT %d: label name steps classes\n",
+                    WIN_LEN, hop, ALG_FIXED_POINT);
+        }
+    } else if (ret == 0 && golden_load(&golden, golden_path) != 0) {
+        printf("Fail to read %s\n", golden_path);
+        ret = -1;
+    }
+
+    start = now_ns();
+    for (run = 0; run < runs && ret == 0; run++) {
+        for (t = 0; t < set.num && ret == 0; t++) {
+            ret = imu_dataset_recording(&set, t, &store, &rec, NULL);
+            if (ret == ALGO_NORMAL) {
+                ret = replay(&rec, &result, &timing);
+            }
+            if (ret != ALGO_NORMAL) {
+                printf("Fail to replay %s/%s\n", set.entry[t].label,
+                       set.entry[t].name);
+                break;
+            }
+            if (run > 0) {
+                continue;
+            }
+            format_result(&set.entry[t], &result, line, REPLAY_LINE_MAX);
+            if (out) {
+                fprintf(out, "%s\n", line);
+                continue;
+            }
+            g = golden_find(&golden, line);
+            if (g < 0 || strcmp(golden.line[g], line) != 0) {
+                if (mismatch < REPLAY_REPORT) {
+                    printf("MISMATCH %s/%s\n  golden: %s\n  replay: %s\n",
+                           set.entry[t].label, set.entry[t].name,
+                           g < 0 ? "(none)" : golden.line[g], line);
+                }
+                mismatch++;
+            }
+        }
+    }
+    wall_ns = now_ns() - start;
+
+    if (ret == 0) {
+        printf("%u recordings, %d runs\n", set.num, runs);
+        print_timing(&timing, wall_ns);
+        if (out) {
+            printf("golden written to %s\n", golden_path);
+        } else if (mismatch > 0) {
+            printf("FAIL: %u of %u recordings differ from %s\n", mismatch,
+                   set.num, golden_path);
+            ret = 1;
+        } else {
+            printf("PASS: %u recordings match %s\n", set.num, golden_path);
+        }
+    }
+    if (out && fclose(out) != 0) {
+        printf("Fail to write %s\n", golden_path);
+        ret = -1;
+    }
+    golden_free(&golden);
+    free(line);
+    free(result.class);
+    free(timing.latency);
+    imu_recording_free(&store);
+    imu_dataset_free(&set);
+    return ret == 0 ? 0 : 1;
+}
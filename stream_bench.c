@@ -0,0 +1,374 @@
+/**
+ * Copyright (C) 2023 VeriSilicon Holdings Co., Ltd.
+ *
+ * @file stream_bench.c
+ * @brief load generator for alg_stream_engine: IMU_Dataset replayed as
+ * many concurrent devices, one second of frames per device in turn, as fast
+ * as the engine takes them, with 1, 2, 4, ... workers:
+ *
+ *   stream_bench [-d devices] [-s seconds] [-j workers] [-c check]
+ *                [RECORDING...]
+ *
+ * RECORDING is as for replay_bench. Device d plays recording
+ * d % recordings from a start that differs between the devices sharing
+ * one, wrapping to the start of the recording. Each run reports the
+ * aggregate samples/s, the results per second and the latency from
+ * submission to result callback. The step totals of every device must be
+ * the same in every run, and the first check devices must match a serial
+ * replay of the same frames; the exit status is 1 otherwise.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "alg_stream_engine.h"
+#include "alg_imu_dataset.h"
+#include "alg_task_pool.h"
+#include "MyNN/alg_mlp_network.h"
+
+#define BENCH_DEVICES (10000)
+#define BENCH_SECONDS (30)
+#define BENCH_CHECK   (16)
+#define BENCH_HEAD    (ACC_FS - 5 - 2) /* frames of the first chunk */
+#define BENCH_AXES    (6)
+
+/* a recording packed as gyro_x, gyro_y, gyro_z, x, y, z frames */
+typedef struct BenchRecording {
+    int16_t *frame;
+    uint32_t len;
+} BenchRecording;
+
+/* latencies of the results of one worker, only that worker writes them */
+typedef struct BenchLatency {
+    uint64_t *ns;
+    uint64_t num;
+    uint64_t cap;
+    uint8_t failed;
+} BenchLatency;
+
+/**
+ * @brief one run
+ * @param steps: step total of every device, written by the worker owning it
+ */
+typedef struct BenchRun {
+    BenchLatency *latency;
+    uint32_t *steps;
+} BenchRun;
+
+static BenchRecording *bench_rec;
+static uint32_t bench_rec_num;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void on_result(void *user, uint16_t worker, const StreamResult *result)
+{
+    BenchRun *run     = user;
+    BenchLatency *lat = &run->latency[worker];
+    uint64_t *grown   = NULL;
+
+    run->steps[result->device_id] += result->step_num;
+    if (lat->num == lat->cap) {
+        grown = realloc(lat->ns, (lat->cap > 0 ? 2 * lat->cap : 4096) *
+                                     sizeof(uint64_t));
+        if (!grown) {
+            lat->failed = 1;
+            return;
+        }
+        lat->ns  = grown;
+        lat->cap = lat->cap > 0 ? 2 * lat->cap : 4096;
+    }
+    lat->ns[lat->num++] = result->latency_ns;
+}
+
+// first frame of device d, devices sharing a recording start 7 s apart
+static uint32_t device_start(uint32_t d)
+{
+    const BenchRecording *rec = &bench_rec[d % bench_rec_num];
+
+    return (uint32_t)((uint64_t)(d / bench_rec_num) * 7 * ACC_FS %
+                      (rec->len - ACC_FS + 1));
+}
+
+// frames of the next second of a device at *pos, which advances
+static const int16_t *device_second(uint32_t d, uint32_t *pos)
+{
+    const BenchRecording *rec = &bench_rec[d % bench_rec_num];
+    const int16_t *frame      = NULL;
+
+    if (*pos + ACC_FS > rec->len) {
+        *pos = 0;
+    }
+    frame = rec->frame + (size_t)*pos * BENCH_AXES;
+    *pos += ACC_FS;
+    return frame;
+}
+
+static AlgoError load_recordings(const ImuDataset *set)
+{
+    ImuRecording store, rec;
+    BenchRecording *out = NULL;
+    uint32_t t = 0, i = 0;
+
+    bench_rec = calloc(set->num > 0 ? set->num : 1, sizeof(BenchRecording));
+    if (!bench_rec) {
+        return ALGO_ERR_GENERIC;
+    }
+    imu_recording_init(&store, NULL, 0);
+    for (t = 0; t < set->num; t++) {
+        if (imu_dataset_recording(set, t, &store, &rec, NULL) !=
+            ALGO_NORMAL) {
+            printf("Fail to load %s/%s\n", set->entry[t].label,
+                   set->entry[t].name);
+            imu_recording_free(&store);
+            return ALGO_ERR_GENERIC;
+        }
+        if (rec.len < ACC_FS) {
+            continue;
+        }
+        out        = &bench_rec[bench_rec_num];
+        out->len   = rec.len;
+        out->frame = malloc((size_t)rec.len * BENCH_AXES * sizeof(int16_t));
+        if (!out->frame) {
+            imu_recording_free(&store);
+            return ALGO_ERR_GENERIC;
+        }
+        for (i = 0; i < rec.len; i++) {
+            out->frame[i * BENCH_AXES + 0] = rec.gyro_x[i];
+            out->frame[i * BENCH_AXES + 1] = rec.gyro_y[i];
+            out->frame[i * BENCH_AXES + 2] = rec.gyro_z[i];
+            out->frame[i * BENCH_AXES + 3] = rec.x[i];
+            out->frame[i * BENCH_AXES + 4] = rec.y[i];
+            out->frame[i * BENCH_AXES + 5] = rec.z[i];
+        }
+        bench_rec_num++;
+    }
+    imu_recording_free(&store);
+    return bench_rec_num > 0 ? ALGO_NORMAL : ALGO_ERR_GENERIC;
+}
+
+// every device for seconds seconds on worker_num workers
+static AlgoError run_engine(uint16_t worker_num, uint32_t devices,
+                            uint32_t seconds, uint32_t *steps)
+{
+    StreamEngine *engine = NULL;
+    StreamEngineStats stats;
+    BenchRun run;
+    uint32_t *pos = calloc(devices, sizeof(uint32_t));
+    uint64_t *all = NULL, num = 0, start = 0, wall = 0, retries = 0;
+    const int16_t *frame = NULL;
+    uint32_t s = 0, d = 0;
+    uint16_t w = 0;
+    AlgoError ret = ALGO_NORMAL;
+
+    run.latency = calloc(worker_num, sizeof(BenchLatency));
+    run.steps   = steps;
+    if (!pos || !run.latency ||
+        (engine = stream_engine_create(worker_num, on_result, &run)) ==
+            NULL) {
+        free(pos);
+        free(run.latency);
+        return ALGO_ERR_GENERIC;
+    }
+    memset(steps, 0, devices * sizeof(uint32_t));
+    for (d = 0; d < devices; d++) {
+        pos[d] = device_start(d);
+    }
+
+    start = now_ns();
+    for (s = 0; s < seconds && ret == ALGO_NORMAL; s++) {
+        for (d = 0; d < devices && ret == ALGO_NORMAL; d++) {
+            frame = device_second(d, &pos[d]);
+            // a full queue is back pressure, give the workers the CPU
+            while ((ret = stream_engine_submit(
+                        engine, d, frame, ACC_FS,
+                        BENCH_AXES * sizeof(int16_t))) == ALGO_ERR_FULL) {
+                retries++;
+                sched_yield();
+            }
+        }
+    }
+    stream_engine_drain(engine);
+    wall = now_ns() - start;
+    stream_engine_get_stats(engine, &stats);
+    stream_engine_destroy(engine);
+
+    for (w = 0; w < worker_num; w++) {
+        num += run.latency[w].num;
+        ret = run.latency[w].failed ? ALGO_ERR_GENERIC : ret;
+    }
+    all = malloc((num > 0 ? num : 1) * sizeof(uint64_t));
+    if (!all || ret != ALGO_NORMAL || stats.dropped > 0) {
+        printf("Fail to run %u workers\n", worker_num);
+        ret = ALGO_ERR_GENERIC;
+    } else {
+        num = 0;
+        for (w = 0; w < worker_num; w++) {
+            memcpy(all + num, run.latency[w].ns,
+                   run.latency[w].num * sizeof(uint64_t));
+            num += run.latency[w].num;
+        }
+        qsort(all, num, sizeof(uint64_t), compare_u64);
+        printf("%7u %12.0f %10.0f %9.1f %9.1f %9.1f %9.1f %9llu\n",
+               worker_num, stats.frames * BENCH_AXES / (wall * 1e-9),
+               stats.chunks / (wall * 1e-9), all[(num - 1) / 2] * 1e-3,
+               all[(num - 1) * 99 / 100] * 1e-3,
+               all[(num - 1) * 999 / 1000] * 1e-3, all[num - 1] * 1e-3,
+               (unsigned long long)retries);
+    }
+    for (w = 0; w < worker_num; w++) {
+        free(run.latency[w].ns);
+    }
+    free(run.latency);
+    free(all);
+    free(pos);
+    return ret;
+}
+
+// step total of device d replayed alone on one context, in the same chunks
+static uint32_t serial_steps(uint32_t d, uint32_t seconds, int16_t *stream)
+{
+    static StepCounterCtx ctx;
+    StepCounterOutput output;
+    AccInput acc_input = { 0, NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+    uint32_t pos       = device_start(d), s = 0, i = 0, total = 0;
+    uint32_t frames    = seconds * ACC_FS;
+    uint16_t len       = BENCH_HEAD;
+
+    for (s = 0; s < seconds; s++) {
+        memcpy(stream + (size_t)s * ACC_FS * BENCH_AXES,
+               device_second(d, &pos),
+               ACC_FS * BENCH_AXES * sizeof(int16_t));
+    }
+    step_counter_ctx_init(&ctx);
+    for (i = 0; i + len <= frames; i += len, len = ACC_FS) {
+        acc_input_from_frames(&acc_input, stream + (size_t)i * BENCH_AXES,
+                              len, BENCH_AXES * sizeof(int16_t));
+        if (step_counter_ctx_process(&ctx, &acc_input, &output) ==
+            ALGO_NORMAL) {
+            total += output.step_num;
+        }
+    }
+    return total;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-d devices] [-s seconds] [-j workers] [-c check] "
+           "[RECORDING...]\n"
+           "  RECORDING  IMU_Dataset directory or recording, or imu_archive "
+           "archive, IMU_Dataset by default\n"
+           "  -d         concurrent devices, %d by default\n"
+           "  -s         seconds of frames per device, %d by default\n"
+           "  -j         most workers, the online CPUs by default\n"
+           "  -c         devices checked against a serial replay, %d by "
+           "default\n",
+           name, BENCH_DEVICES, BENCH_SECONDS, BENCH_CHECK);
+}
+
+int main(int argc, char **argv)
+{
+    ImuDataset set;
+    uint32_t *steps = NULL, *first = NULL;
+    int16_t *stream = NULL;
+    int opt = 0, devices = BENCH_DEVICES, seconds = BENCH_SECONDS;
+    int workers = task_pool_cpu_num(), check = BENCH_CHECK, w = 0;
+    int d = 0, differ = 0;
+    AlgoError ret = ALGO_NORMAL;
+
+    while ((opt = getopt(argc, argv, "d:s:j:c:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            devices = atoi(optarg);
+            break;
+        case 's':
+            seconds = atoi(optarg);
+            break;
+        case 'j':
+            workers = atoi(optarg);
+            break;
+        case 'c':
+            check = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (devices < 1 || seconds < 1 || workers < 1 || workers > UINT16_MAX ||
+        check < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    check = check < devices ? check : devices;
+
+    imu_dataset_init(&set);
+    ret = imu_dataset_add(&set, optind == argc ? "IMU_Dataset" : argv[optind]);
+    for (optind++; optind < argc && ret == ALGO_NORMAL; optind++) {
+        ret = imu_dataset_add(&set, argv[optind]);
+    }
+    if (ret != ALGO_NORMAL || load_recordings(&set) != ALGO_NORMAL) {
+        printf("Fail to add the recordings\n");
+        return 1;
+    }
+    steps  = calloc(devices, sizeof(uint32_t));
+    first  = calloc(devices, sizeof(uint32_t));
+    stream = malloc((size_t)seconds * ACC_FS * BENCH_AXES * sizeof(int16_t));
+    if (!steps || !first || !stream || networks_init() != ALGO_NORMAL) {
+        printf("Fail to set up\n");
+        return 1;
+    }
+
+    printf("%u recordings as %d devices, %d s each (%llu samples)\n",
+           bench_rec_num, devices, seconds,
+           (unsigned long long)devices * seconds * ACC_FS * BENCH_AXES);
+    printf("%7s %12s %10s %9s %9s %9s %9s %9s\n", "workers", "samples/s",
+           "results/s", "p50 us", "p99 us", "p999 us", "max us", "full");
+    // 1, 2, 4, ... and workers itself
+    for (w = 1; ret == ALGO_NORMAL; w = 2 * w < workers ? 2 * w : workers) {
+        ret = run_engine((uint16_t)w, devices, seconds, w > 1 ? steps : first);
+        for (d = 0; ret == ALGO_NORMAL && w > 1 && d < devices; d++) {
+            differ += steps[d] != first[d];
+        }
+        if (w == workers) {
+            break;
+        }
+    }
+    for (d = 0; d < check && ret == ALGO_NORMAL; d++) {
+        differ += serial_steps(d, seconds, stream) != first[d];
+    }
+
+    if (ret != ALGO_NORMAL) {
+        differ = 1;
+    } else if (differ > 0) {
+        printf("FAIL: %d step totals differ between runs or from the "
+               "serial replay\n",
+               differ);
+    } else {
+        printf("PASS: step totals of %d devices agree over every run, %d "
+               "match a serial replay\n",
+               devices, check);
+    }
+    for (d = 0; d < (int)bench_rec_num; d++) {
+        free(bench_rec[d].frame);
+    }
+    free(bench_rec);
+    free(steps);
+    free(first);
+    free(stream);
+    imu_dataset_free(&set);
+    return differ > 0 ? 1 : 0;
+}